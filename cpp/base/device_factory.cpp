@@ -75,7 +75,7 @@ shared_ptr<PrimaryDevice> DeviceFactory::CreateDevice(PbDeviceType type, int lun
 
 #if defined BUILD_SCHD || defined BUILD_SCRM
     case SCHD: {
-        const string &ext = GetExtensionLowerCase(filename);
+        const string &ext = GetImageExtension(filename);
         return make_shared<ScsiHd>(lun, false, ext == "hda", ext == "hd1");
     }
 
@@ -90,7 +90,7 @@ shared_ptr<PrimaryDevice> DeviceFactory::CreateDevice(PbDeviceType type, int lun
 
 #ifdef BUILD_SCCD
     case SCCD:
-        return make_shared<ScsiCd>(lun, GetExtensionLowerCase(filename) == "is1");
+        return make_shared<ScsiCd>(lun, GetImageExtension(filename) == "is1");
 #endif
 
 #ifdef BUILD_SCTP
@@ -132,7 +132,7 @@ shared_ptr<PrimaryDevice> DeviceFactory::CreateDevice(PbDeviceType type, int lun
 
 PbDeviceType DeviceFactory::GetTypeForFile(const string &filename) const
 {
-    if (const auto &it = mapping.find(GetExtensionLowerCase(filename)); it != mapping.end()) {
+    if (const auto &it = mapping.find(GetImageExtension(filename)); it != mapping.end()) {
         return it->second;
     }
 
@@ -143,6 +143,13 @@ PbDeviceType DeviceFactory::GetTypeForFile(const string &filename) const
     return filename.starts_with("/dev/sg") ? SCSG : UNDEFINED;
 }
 
+string DeviceFactory::GetImageExtension(const string &filename)
+{
+    // For compressed and deduplicated images the extension preceding the ".dz" or ".dedup" extension is relevant
+    const string &ext = GetExtensionLowerCase(filename);
+    return ext == "dz" || ext == "dedup" ? GetExtensionLowerCase(filesystem::path(filename).stem().string()) : ext;
+}
+
 bool DeviceFactory::AddExtensionMapping(const string &extension, PbDeviceType type)
 {
     if (mapping.contains(extension)) {
@@ -43,6 +43,8 @@ private:
 
     DeviceFactory();
 
+    static string GetImageExtension(const string&);
+
     inline static const unordered_map<string_view, PbDeviceType> DEVICE_MAPPING = {
         { "daynaport", SCDP },
         { "printer", SCLP },
@@ -92,6 +92,31 @@ public:
         return 0;
     }
 
+    // Devices supporting this can read the next DATA IN chunk on another thread, while the controller sends the
+    // current chunk. The controller does not access the device while the chunk is being read.
+    virtual bool IsReadAheadSupported() const
+    {
+        return false;
+    }
+    // Reads the next DATA IN chunk into the buffer without involving the controller. The data returned may have
+    // been borrowed from a cache, in this case they are pinned.
+    virtual pair<data_out_t, shared_ptr<const void>> ReadAhead(data_in_t)
+    {
+        return { };
+    }
+
+    // Devices supporting this for the command can write DATA OUT chunks on another thread, while the controller
+    // receives the next chunk. The controller does not access the device before all chunks have been written.
+    virtual bool IsWriteBehindSupported(cdb_t) const
+    {
+        return false;
+    }
+    // Writes a DATA OUT chunk without involving the controller, the flag signals the last chunk of the command
+    virtual void WriteBehind(cdb_t, data_out_t, bool)
+    {
+        // Devices supporting write-behind have to override this method
+    }
+
     // For DATA OUT phase, except for MODE SELECT
     virtual int WriteData(cdb_t, data_out_t, int, int) = 0;
 
@@ -24,11 +24,14 @@ public:
     static constexpr const char *CONFIGURATION = "/etc/s2p.conf";
 
     // Global property keys
+    static constexpr const char *CACHE_MEMORY = "cache_memory";
     static constexpr const char *IMAGE_FOLDER = "image_folder";
     static constexpr const char *LOCALE = "locale";
     static constexpr const char *LOG_LEVEL = "log_level";
     static constexpr const char *LOG_LIMIT = "log_limit";
     static constexpr const char *LOG_PATTERN = "log_pattern";
+    static constexpr const char *MAX_TRANSFER_SIZE = "max_transfer_size";
+    static constexpr const char *METRICS = "metrics";
     static constexpr const char *MODE_PAGE = "mode_page";
     static constexpr const char *PORT = "port";
     static constexpr const char *PROPERTY_FILES = "property_files";
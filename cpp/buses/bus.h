@@ -86,6 +86,7 @@ using namespace std;
 
 class Bus // NOSONAR The number of convenience methods is justified
 {
+    template<typename T> friend class BusHandShake;
 
 public:
 
@@ -116,10 +117,11 @@ public:
 
     virtual bool WaitSignal(int, bool);
 
-    int CommandHandShake(span<uint8_t>);
+    // Concrete buses override these with the handshake loops instantiated for them
+    virtual int CommandHandShake(span<uint8_t>);
+    virtual int ReceiveHandShake(uint8_t*, int);
+    virtual int SendHandShake(const uint8_t*, int, int = SEND_NO_DELAY);
     int MsgInHandShake();
-    int ReceiveHandShake(uint8_t*, int);
-    int SendHandShake(const uint8_t*, int, int = SEND_NO_DELAY);
 
     bool GetBSY() const
     {
@@ -214,7 +216,28 @@ protected:
 
 private:
 
-    static const array<BusPhase, 8> phases;
+    // Phase Table with the phases based upon the MSG, C/D and I/O signals
+    //
+    // |MSG|C/D|I/O| Phase
+    // | 0 | 0 | 0 | DATA OUT
+    // | 0 | 0 | 1 | DATA IN
+    // | 0 | 1 | 0 | COMMAND
+    // | 0 | 1 | 1 | STATUS
+    // | 1 | 0 | 0 | RESERVED
+    // | 1 | 0 | 1 | RESERVED
+    // | 1 | 1 | 0 | MESSAGE OUT
+    // | 1 | 1 | 1 | MESSAGE IN
+    //
+    static constexpr array<BusPhase, 8> phases = {
+        BusPhase::DATA_OUT,
+        BusPhase::DATA_IN,
+        BusPhase::COMMAND,
+        BusPhase::STATUS,
+        BusPhase::RESERVED,
+        BusPhase::RESERVED,
+        BusPhase::MSG_OUT,
+        BusPhase::MSG_IN
+    };
 
     static const array<string, 11> phase_names;
 
@@ -0,0 +1,289 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2001-2006 ＰＩ．(ytanaka@ipc-tokai.or.jp)
+// Copyright (C) 2014-2020 GIMONS
+// Copyright (C) 2022-2025 Uwe Seimet
+//
+// The handshake loops are instantiated for each concrete bus. With a final bus class or final signal methods
+// the compiler can inline the signal access, e.g. the GPIO register access of RpiBus, and keep the signal
+// state in registers. Instantiating them for Bus results in the generic version with virtual calls.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <spdlog/spdlog.h>
+#include "shared/command_meta_data.h"
+#include "bus.h"
+
+template<typename T>
+class BusHandShake
+{
+
+public:
+
+    static int Command(T &bus, span<uint8_t> buf)
+    {
+        bus.DisableIRQ();
+
+        bus.SetSignal(PIN_REQ, true);
+
+        bool ack = bus.WaitSignal(PIN_ACK, true);
+
+        bus.WaitBusSettle();
+
+        buf[0] = bus.GetDAT();
+
+        bus.SetSignal(PIN_REQ, false);
+
+        // Timeout waiting for ACK to change
+        if (!ack || !bus.WaitSignal(PIN_ACK, false)) {
+            bus.EnableIRQ();
+            return -1;
+        }
+
+        // The ICD AdSCSI ST, AdSCSI Plus ST and AdSCSI Micro ST host adapters allow SCSI devices to be connected
+        // to the ACSI bus of Atari ST/TT computers and some clones. ICD-awarerrore drivers prepend a $1F byte in front
+        // of the CDB (effectively resulting in a custom SCSI command) in order to get access to the full SCSI
+        // command set. Native ACSI is limited to the low SCSI command classes with command bytes < $20.
+        // Most other host adapters (e.g. LINK96/97 and the one by Inventronik) and also several devices (e.g.
+        // UltraSatan or GigaFile) that can directly be connected to the Atari's ACSI port also support ICD
+        // semantics. In fact, these semantics have become a standard in the Atari world.
+        if (buf[0] == 0x1f) {
+            bus.SetSignal(PIN_REQ, true);
+
+            ack = bus.WaitSignal(PIN_ACK, true);
+
+            bus.WaitBusSettle();
+
+            // Get the actual SCSI command
+            buf[0] = bus.GetDAT();
+
+            bus.SetSignal(PIN_REQ, false);
+
+            // Timeout waiting for ACK to change
+            if (!ack || !bus.WaitSignal(PIN_ACK, false)) {
+                bus.EnableIRQ();
+                return -1;
+            }
+        }
+
+        const int command_byte_count = CommandMetaData::Instance().GetByteCount(static_cast<ScsiCommand>(buf[0]));
+        if (!command_byte_count) {
+            bus.EnableIRQ();
+
+            // Unknown command
+            return 0;
+        }
+
+        int bytes_received;
+        for (bytes_received = 1; bytes_received < command_byte_count; ++bytes_received) {
+            bus.SetSignal(PIN_REQ, true);
+
+            ack = bus.WaitSignal(PIN_ACK, true);
+
+            bus.WaitBusSettle();
+
+            buf[bytes_received] = bus.GetDAT();
+
+            bus.SetSignal(PIN_REQ, false);
+
+            // Timeout waiting for ACK to change
+            if (!ack || !bus.WaitSignal(PIN_ACK, false)) {
+                bus.EnableIRQ();
+                return -1;
+            }
+        }
+
+        bus.EnableIRQ();
+
+        return bytes_received;
+    }
+
+    // Handshake for DATA OUT and target MESSAGE OUT
+    static int Receive(T &bus, bool target_mode, uint8_t *buf, int count)
+    {
+        int bytes_received;
+
+        bus.DisableIRQ();
+
+        if (target_mode) {
+            for (bytes_received = 0; bytes_received < count; ++bytes_received) {
+                bus.SetSignal(PIN_REQ, true);
+
+                const bool ack = bus.WaitSignal(PIN_ACK, true);
+
+                bus.WaitBusSettle();
+
+                *buf = bus.GetDAT();
+
+                bus.SetSignal(PIN_REQ, false);
+
+                // Timeout waiting for ACK to change
+                if (!ack || !bus.WaitSignal(PIN_ACK, false)) {
+                    break;
+                }
+
+                ++buf;
+            }
+        } else {
+            const BusPhase phase = GetPhase(bus);
+
+            for (bytes_received = 0; bytes_received < count; ++bytes_received) {
+                if (!bus.WaitSignal(PIN_REQ, true)) {
+                    break;
+                }
+
+                // Phase error
+                if (GetPhase(bus) != phase) {
+                    break;
+                }
+
+                bus.WaitBusSettle();
+
+                *buf = bus.GetDAT();
+
+                bus.SetSignal(PIN_ACK, true);
+
+                const bool req = bus.WaitSignal(PIN_REQ, false);
+
+                bus.SetSignal(PIN_ACK, false);
+
+                if (!req || GetPhase(bus) != phase) {
+                    break;
+                }
+
+                ++buf;
+            }
+        }
+
+        bus.EnableIRQ();
+
+        return bytes_received;
+    }
+
+    // Handshake for DATA IN and MESSAGE IN
+#ifdef BUILD_SCDP
+    static int Send(T &bus, bool target_mode, const uint8_t *buf, int count, int daynaport_delay_after_bytes)
+#else
+    static int Send(T &bus, bool target_mode, const uint8_t *buf, int count, int)
+#endif
+    {
+        int bytes_sent;
+
+        bus.DisableIRQ();
+
+        if (target_mode) {
+            for (bytes_sent = 0; bytes_sent < count; ++bytes_sent) {
+#ifdef BUILD_SCDP
+                if (bytes_sent == daynaport_delay_after_bytes) {
+                    const timespec ts = { .tv_sec = 0, .tv_nsec = Bus::DAYNAPORT_SEND_DELAY_NS };
+                    bus.EnableIRQ();
+                    nanosleep(&ts, nullptr);
+                    bus.DisableIRQ();
+                }
+#endif
+
+                bus.SetDAT(*buf);
+
+                if (!bus.WaitSignal(PIN_ACK, false)) {
+                    break;
+                }
+
+                bus.SetSignal(PIN_REQ, true);
+
+                const bool ack = bus.WaitSignal(PIN_ACK, true);
+
+                bus.SetSignal(PIN_REQ, false);
+
+                if (!ack) {
+                    break;
+                }
+
+                ++buf;
+            }
+
+            bus.WaitSignal(PIN_ACK, false);
+        } else {
+            const BusPhase phase = GetPhase(bus);
+
+            for (bytes_sent = 0; bytes_sent < count; ++bytes_sent) {
+                bus.SetDAT(*buf);
+
+                if (!bus.WaitSignal(PIN_REQ, true)) {
+                    break;
+                }
+
+                // Signal the last MESSAGE OUT byte
+                if (phase == BusPhase::MSG_OUT && bytes_sent == count - 1) {
+                    bus.SetSignal(PIN_ATN, false);
+                }
+
+                // Phase error
+                if (GetPhase(bus) != phase) {
+                    break;
+                }
+
+                bus.SetSignal(PIN_ACK, true);
+
+                const bool req = bus.WaitSignal(PIN_REQ, false);
+
+                bus.SetSignal(PIN_ACK, false);
+
+                if (!req || GetPhase(bus) != phase) {
+                    break;
+                }
+
+                ++buf;
+            }
+        }
+
+        bus.EnableIRQ();
+
+        return bytes_sent;
+    }
+
+    static bool WaitSignal(T &bus, int pin, bool state)
+    {
+        const auto now = chrono::steady_clock::now();
+
+        // Wait for up to 3 s
+        do {
+            bus.Acquire();
+
+            if (bus.GetSignal(pin) == state) {
+                return true;
+            }
+
+            if (bus.GetSignal(PIN_RST)) {
+                spdlog::warn("{0} received RST signal during {1} phase, aborting",
+                    bus.IsTarget() ? "Target" : "Initiator", Bus::GetPhaseName(GetPhase(bus)));
+                return false;
+            }
+        } while ((chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - now).count()) < 3);
+
+        spdlog::trace("Timeout while waiting for ACK/REQ to change to {}", state ? "true" : "false");
+
+        return false;
+    }
+
+    static BusPhase GetPhase(T &bus)
+    {
+        bus.Acquire();
+
+        if (bus.GetSignal(PIN_SEL)) {
+            return BusPhase::SELECTION;
+        }
+
+        if (!bus.GetSignal(PIN_BSY)) {
+            return BusPhase::BUS_FREE;
+        }
+
+        // Get phase from bus signal lines
+        return Bus::phases[(bus.GetSignal(PIN_MSG) ? 0b100 : 0b000) | (bus.GetSignal(PIN_CD) ? 0b010 : 0b000)
+            | (bus.GetIO() ? 0b001 : 0b000)];
+    }
+};
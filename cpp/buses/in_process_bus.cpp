@@ -7,6 +7,14 @@
 //---------------------------------------------------------------------------
 
 #include "in_process_bus.h"
+#include <climits>
+#include <thread>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "bus_handshake.h"
 #include "shared/s2p_util.h"
 
 using namespace spdlog;
@@ -14,57 +22,147 @@ using namespace s2p_util;
 
 bool InProcessBus::Init(bool target)
 {
-    if (!Bus::Init(target)) {
-        return false;
-    }
-
-    if (target) {
-        return true;
-    }
-
-    const auto now = chrono::steady_clock::now();
+    return Bus::Init(target) && (target || WaitForTarget());
+}
 
+bool InProcessBus::WaitForTarget()
+{
     // Wait for the target up to 1 s
-    do {
-        if (target_enabled) {
-            return true;
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(1);
+
+    for (uint32_t enabled = target_enabled; !enabled; enabled = target_enabled) {
+        if (!WaitForChange(target_enabled, enabled, target_waiters, deadline)) {
+            return false;
         }
-    } while ((chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - now).count()) < 1);
+    }
 
-    return false;
+    return true;
 }
 
 void InProcessBus::CleanUp()
 {
     // Signal the client that s2p is ready
     if (IsTarget()) {
-        target_enabled = true;
+        target_enabled = 1;
+        WakeUp(target_enabled, target_waiters);
     }
 }
 
 void InProcessBus::Reset()
 {
-    signals = { };
+    signals = 0;
 
     dat = 0;
+
+    WakeUp(signals, waiters);
 }
 
-bool InProcessBus::GetSignal(int pin) const
+void InProcessBus::SetSignal(int pin, bool state)
 {
-    return signals[pin];
+    if (state) {
+        signals.fetch_or(1U << pin);
+    }
+    else {
+        signals.fetch_and(~(1U << pin));
+    }
+
+    WakeUp(signals, waiters);
 }
 
-void InProcessBus::SetSignal(int pin, bool state)
+bool InProcessBus::WaitSignal(int pin, bool state)
+{
+    // Wait for up to 3 s
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(3);
+
+    for (uint32_t s = signals; static_cast<bool>(s & (1U << pin)) != state; s = signals) {
+        if (s & (1U << PIN_RST)) {
+            spdlog::warn("{0} received RST signal during {1} phase, aborting", IsTarget() ? "Target" : "Initiator",
+                GetPhaseName(BusHandShake<InProcessBus>::GetPhase(*this)));
+            return false;
+        }
+
+        if (!WaitForChange(signals, s, waiters, deadline)) {
+            spdlog::trace("Timeout while waiting for ACK/REQ to change to {}", state ? "true" : "false");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool InProcessBus::WaitForChange(atomic<uint32_t> &value, uint32_t expected, atomic_int &waiting,
+    const chrono::steady_clock::time_point &deadline)
+{
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+        if (value != expected) {
+            return true;
+        }
+    }
+
+    const auto now = chrono::steady_clock::now();
+    if (now >= deadline) {
+        return false;
+    }
+
+    // The waiter has to be registered before the value is compared again, so that a change is not missed
+    ++waiting;
+#ifdef __linux__
+    const auto remaining = chrono::duration_cast<chrono::nanoseconds>(deadline - now).count();
+    const timespec ts = { .tv_sec = remaining / 1'000'000'000, .tv_nsec = remaining % 1'000'000'000 };
+    // The futex syscall returns immediately if the value has already changed
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0); // NOSONAR bit_cast is not supported by the bullseye compiler
+#else
+    this_thread::yield();
+#endif
+    --waiting;
+
+    return true;
+}
+
+void InProcessBus::WakeUp([[maybe_unused]] atomic<uint32_t> &value, [[maybe_unused]] const atomic_int &waiting)
+{
+    // Without futexes the waiting threads do not park
+#ifdef __linux__
+    if (waiting) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0); // NOSONAR bit_cast is not supported by the bullseye compiler
+    }
+#endif
+}
+
+int InProcessBus::CommandHandShake(span<uint8_t> buf)
+{
+    return BusHandShake<InProcessBus>::Command(*this, buf);
+}
+
+int InProcessBus::ReceiveHandShake(uint8_t *buf, int count)
 {
-    scoped_lock lock(write_locker);
-    signals[pin] = state;
+    return ReceiveHandShake(IsTarget(), buf, count);
+}
+
+int InProcessBus::ReceiveHandShake(bool target_mode, uint8_t *buf, int count)
+{
+    return BusHandShake<InProcessBus>::Receive(*this, target_mode, buf, count);
+}
+
+int InProcessBus::SendHandShake(const uint8_t *buf, int count, int daynaport_delay_after_bytes)
+{
+    return SendHandShake(IsTarget(), buf, count, daynaport_delay_after_bytes);
+}
+
+int InProcessBus::SendHandShake(bool target_mode, const uint8_t *buf, int count, int daynaport_delay_after_bytes)
+{
+    return BusHandShake<InProcessBus>::Send(*this, target_mode, buf, count, daynaport_delay_after_bytes);
 }
 
 bool InProcessBus::WaitForSelection()
 {
-    // Busy waiting cannot be avoided
-    const timespec ts = { .tv_sec = 0, .tv_nsec = 10'000'000 };
-    nanosleep(&ts, nullptr);
+    const auto deadline = chrono::steady_clock::now() + SELECTION_TIMEOUT;
+
+    for (uint32_t s = signals; !(s & (1U << PIN_SEL)); s = signals) {
+        if (!WaitForChange(signals, s, waiters, deadline)) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -76,6 +174,11 @@ DelegatingInProcessBus::DelegatingInProcessBus(InProcessBus &bus, const string &
     in_process_logger->set_pattern("[%^%l%$] [%n] %v");
 }
 
+bool DelegatingInProcessBus::Init(bool target)
+{
+    return Bus::Init(target) && (target || InProcessBus::WaitForTarget());
+}
+
 void DelegatingInProcessBus::Reset()
 {
     in_process_logger->trace("Resetting bus");
@@ -9,13 +9,14 @@
 #pragma once
 
 #include <atomic>
-#include <mutex>
+#include <chrono>
 #include <unordered_map>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include "bus.h"
 
 class InProcessBus : public Bus
 {
+    template<typename T> friend class BusHandShake;
 
 public:
 
@@ -31,45 +32,60 @@ public:
     void CleanUp() override;
     void Reset() override;
 
-    uint32_t Acquire() override
+    // The signal methods are final, so that the handshake loops instantiated for this bus can inline them
+
+    uint32_t Acquire() final
     {
         return dat;
     }
 
-    void SetBSY(bool state) override
+    void SetBSY(bool state) final
     {
         SetSignal(PIN_BSY, state);
     }
 
-    void SetSEL(bool state) override
+    void SetSEL(bool state) final
     {
         SetSignal(PIN_SEL, state);
     }
 
-    bool GetIO() override
+    bool GetIO() final
     {
         return GetSignal(PIN_IO);
     }
-    void SetIO(bool state) override
+    void SetIO(bool state) final
     {
         SetSignal(PIN_IO, state);
     }
 
-    uint8_t GetDAT() override
+    uint8_t GetDAT() final
     {
         return dat;
     }
-    void SetDAT(uint8_t d) override
+    void SetDAT(uint8_t d) final
     {
         dat = d;
     }
 
-    bool GetSignal(int) const override;
-    void SetSignal(int, bool) override;
+    bool GetSignal(int pin) const final
+    {
+        return signals & (1U << pin);
+    }
+    void SetSignal(int, bool) final;
+
+    bool WaitSignal(int, bool) final;
+
+    int CommandHandShake(span<uint8_t>) final;
+    int ReceiveHandShake(uint8_t*, int) final;
+    int SendHandShake(const uint8_t*, int, int = SEND_NO_DELAY) final;
+
+    // The handshake loops with an explicit target mode, for buses delegating to this bus
+    int ReceiveHandShake(bool, uint8_t*, int);
+    int SendHandShake(bool, const uint8_t*, int, int);
 
     bool WaitForSelection() override;
 
-    void WaitBusSettle() const override
+    void WaitBusSettle() const final
     {
         // Nothing to do
     }
@@ -79,31 +95,48 @@ public:
         return false;
     }
 
+    // The initiator has to wait for the target to be ready
+    static bool WaitForTarget();
+
 protected:
 
     InProcessBus() = default;
 
 private:
 
-    void DisableIRQ() override
+    void DisableIRQ() final
     {
         // Nothing to do
     }
-    void EnableIRQ() override
+    void EnableIRQ() final
     {
         // Nothing to do }
     }
 
-    static inline atomic_bool target_enabled;
+    // Parks the calling thread until the value differs from the expected value, returns false after the deadline
+    static bool WaitForChange(atomic<uint32_t>&, uint32_t, atomic_int&, const chrono::steady_clock::time_point&);
+    static void WakeUp(atomic<uint32_t>&, const atomic_int&);
 
-    mutex write_locker;
+    static inline atomic<uint32_t> target_enabled;
+    static inline atomic_int target_waiters;
 
     atomic<uint8_t> dat = 0;
 
-    array<bool, 28> signals = { };
+    // The signal states as a bitmask indexed by the pin numbers
+    atomic<uint32_t> signals = 0;
+
+    // The number of threads waiting for a signal change, the waiters are only woken up if there are any
+    atomic_int waiters = 0;
+
+    // The number of checks before a waiting thread is parked, the other side usually responds very quickly
+    static constexpr int SPIN_COUNT = 1000;
+
+    // WaitForSelection() returns regularly, so that the caller can check whether to terminate
+    static constexpr chrono::milliseconds SELECTION_TIMEOUT = chrono::milliseconds(100);
 };
 
-class DelegatingInProcessBus : public InProcessBus
+// Logs the signals and delegates to the bus shared by the in-process target and initiator
+class DelegatingInProcessBus : public Bus
 {
 
 public:
@@ -111,6 +144,7 @@ public:
     DelegatingInProcessBus(InProcessBus&, const string&, bool);
     ~DelegatingInProcessBus() override = default;
 
+    bool Init(bool) override;
     void Reset() override;
 
     void CleanUp() override
@@ -123,11 +157,49 @@ public:
         return bus.Acquire();
     }
 
+    bool WaitForSelection() override
+    {
+        return bus.WaitForSelection();
+    }
+
+    void SetBSY(bool state) override
+    {
+        SetSignal(PIN_BSY, state);
+    }
+
+    void SetSEL(bool state) override
+    {
+        SetSignal(PIN_SEL, state);
+    }
+
+    bool GetIO() override
+    {
+        return GetSignal(PIN_IO);
+    }
+    void SetIO(bool state) override
+    {
+        SetSignal(PIN_IO, state);
+    }
+
     bool WaitSignal(int pin, bool state) override
     {
         return bus.WaitSignal(pin, state);
     }
 
+    // The data transfers are not logged, they are delegated to the handshake loops of the shared bus
+    int CommandHandShake(span<uint8_t> buf) override
+    {
+        return bus.CommandHandShake(buf);
+    }
+    int ReceiveHandShake(uint8_t *buf, int count) override
+    {
+        return bus.ReceiveHandShake(IsTarget(), buf, count);
+    }
+    int SendHandShake(const uint8_t *buf, int count, int daynaport_delay_after_bytes = SEND_NO_DELAY) override
+    {
+        return bus.SendHandShake(IsTarget(), buf, count, daynaport_delay_after_bytes);
+    }
+
     uint8_t GetDAT() override
     {
         return bus.GetDAT();
@@ -140,8 +212,27 @@ public:
     bool GetSignal(int) const override;
     void SetSignal(int, bool) override;
 
+    void WaitBusSettle() const override
+    {
+        // Nothing to do
+    }
+
+    bool IsRaspberryPi() const override
+    {
+        return false;
+    }
+
 private:
 
+    void DisableIRQ() override
+    {
+        // Nothing to do
+    }
+    void EnableIRQ() override
+    {
+        // Nothing to do
+    }
+
     static string GetSignalName(int);
 
     InProcessBus &bus;
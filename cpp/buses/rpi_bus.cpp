@@ -8,6 +8,7 @@
 //---------------------------------------------------------------------------
 
 #include "rpi_bus.h"
+#include "bus_handshake.h"
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/time.h>
@@ -608,3 +609,23 @@ void RpiBus::WaitBusSettle() const
         }
     }
 }
+
+bool RpiBus::WaitSignal(int pin, bool state)
+{
+    return BusHandShake<RpiBus>::WaitSignal(*this, pin, state);
+}
+
+int RpiBus::CommandHandShake(span<uint8_t> buf)
+{
+    return BusHandShake<RpiBus>::Command(*this, buf);
+}
+
+int RpiBus::ReceiveHandShake(uint8_t *buf, int count)
+{
+    return BusHandShake<RpiBus>::Receive(*this, IsTarget(), buf, count);
+}
+
+int RpiBus::SendHandShake(const uint8_t *buf, int count, int daynaport_delay_after_bytes)
+{
+    return BusHandShake<RpiBus>::Send(*this, IsTarget(), buf, count, daynaport_delay_after_bytes);
+}
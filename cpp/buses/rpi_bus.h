@@ -17,6 +17,7 @@
 
 class RpiBus final : public Bus
 {
+    template<typename T> friend class BusHandShake;
 
 public:
 
@@ -57,6 +58,12 @@ public:
 
     void WaitBusSettle() const override;
 
+    bool WaitSignal(int, bool) override;
+
+    int CommandHandShake(span<uint8_t>) override;
+    int ReceiveHandShake(uint8_t*, int) override;
+    int SendHandShake(const uint8_t*, int, int = SEND_NO_DELAY) override;
+
     bool IsRaspberryPi() const override
     {
         return true;
@@ -12,6 +12,9 @@
 #ifdef BUILD_STORAGE_DEVICE
 #include "devices/storage_device.h"
 #endif
+#ifdef BUILD_DISK
+#include "devices/dedup_cache.h"
+#endif
 #include "protobuf/protobuf_util.h"
 
 using namespace s2p_util;
@@ -138,7 +141,17 @@ bool CommandImageSupport::CreateImage(const CommandContext &context) const
             return false;
         }
 
-        resize_file(file, len);
+        // A deduplicated image is a manifest referencing the image data in the shared block store
+        if (IsManifest(full_filename)) {
+            if (const string &e = CreateManifest(full_filename, len); !e.empty()) {
+                filesystem::remove(file, error);
+
+                return context.ReturnErrorStatus("Can't create image file '" + full_filename + "': " + e);
+            }
+        }
+        else {
+            resize_file(file, len);
+        }
     }
     catch (const filesystem_error &e) {
         filesystem::remove(file, error);
@@ -244,7 +257,9 @@ bool CommandImageSupport::CopyImage(const CommandContext &context) const
     }
 
     try {
-        copy_file(f, t);
+        if (const string &e = CopyImageFile(from, to); !e.empty()) {
+            return context.ReturnErrorStatus("Can't copy image file '" + from + "': " + e);
+        }
 
         permissions(t,
             GetParam(context.GetCommand(), "read_only") == "true" ?
@@ -317,6 +332,54 @@ bool CommandImageSupport::IsReservedFile(const CommandContext &context, const st
 }
 #pragma GCC diagnostic pop
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+bool CommandImageSupport::IsManifest(const string &filename)
+{
+#ifdef BUILD_DISK
+    return DedupCache::IsManifest(filename);
+#else
+    return false;
+#endif
+}
+
+string CommandImageSupport::CreateManifest(const string &filename, off_t size) const
+{
+#ifdef BUILD_DISK
+    return DedupCache::Create(filename, GetBlockStoreFolder(), size);
+#else
+    return "Deduplicated images are not supported";
+#endif
+}
+#pragma GCC diagnostic pop
+
+string CommandImageSupport::CopyImageFile(const string &from, const string &to) const
+{
+#ifdef BUILD_DISK
+    // Copying a deduplicated image only copies its manifest, copying from or to a plain image file converts the image
+    if (IsManifest(to) && !IsManifest(from)) {
+        return DedupCache::Import(from, to, GetBlockStoreFolder());
+    }
+
+    if (IsManifest(from) && !IsManifest(to)) {
+        return DedupCache::Export(from, to);
+    }
+#endif
+
+    copy_file(path(from), path(to));
+
+    return "";
+}
+
+string CommandImageSupport::GetBlockStoreFolder() const
+{
+#ifdef BUILD_DISK
+    return default_folder + "/" + BlockStore::DEFAULT_FOLDER;
+#else
+    return "";
+#endif
+}
+
 bool CommandImageSupport::ValidateParams(const CommandContext &context, const string &op, string &from, string &to) const
 {
     from = GetParam(context.GetCommand(), "from");
@@ -56,10 +56,14 @@ private:
     string GetFullName(const string&) const;
     bool CreateImageFolder(const CommandContext&, string_view) const;
     bool ValidateParams(const CommandContext&, const string&, string&, string&) const;
+    string CreateManifest(const string&, off_t) const;
+    string CopyImageFile(const string&, const string&) const;
+    string GetBlockStoreFolder() const;
 
     static bool IsReservedFile(const CommandContext&, const string&, const string&);
     static bool IsValidSrcFilename(string_view);
     static bool IsValidDstFilename(string_view);
+    static bool IsManifest(const string&);
     static bool ChangeOwner(const CommandContext&, const path&, bool);
 
     int depth = 1;
@@ -8,12 +8,20 @@
 
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include "base/primary_device.h"
+#include "buffer_pool.h"
 
 using namespace s2p_util;
 
 AbstractController::AbstractController(Bus &b, int id, const S2pFormatter &f) : bus(b), target_id(id), formatter(f)
 {
     controller_logger = CreateLogger(fmt::format("[s2p] (ID {})", id));
+
+    buffer = BufferPool::Instance().Acquire();
+}
+
+AbstractController::~AbstractController()
+{
+    BufferPool::Instance().Release(move(buffer));
 }
 
 void AbstractController::CleanUp() const
@@ -34,6 +42,8 @@ void AbstractController::Reset()
 
     status = StatusCode::GOOD;
 
+    ReleaseBorrowedData();
+
     initiator_id = UNKNOWN_INITIATOR_ID;
 
     for (const auto& [_, lun] : luns) {
@@ -64,7 +74,9 @@ void AbstractController::AddDataToScript(span<const uint8_t> data) const
 
 void AbstractController::SetCurrentLength(int length)
 {
-    if (length > static_cast<int>(buffer.size())) {
+    // Borrowed data are sent without the buffer. Only transfers exceeding the maximum transfer size, which
+    // cannot be split into chunks, require a larger buffer.
+    if (borrowed_data.empty() && length > static_cast<int>(buffer.size())) {
         buffer.resize(length);
     }
 
@@ -100,6 +112,18 @@ void AbstractController::UpdateOffsetAndLength()
     current_length = 0;
 }
 
+void AbstractController::SetBorrowedData(data_out_t data, shared_ptr<const void> pin)
+{
+    borrowed_data = data;
+    borrowed_pin = pin;
+}
+
+void AbstractController::ReleaseBorrowedData()
+{
+    borrowed_data = { };
+    borrowed_pin.reset();
+}
+
 void AbstractController::CopyToBuffer(const void *src, size_t size) // NOSONAR Any kind of source data is permitted
 {
     SetCurrentLength(static_cast<int>(size));
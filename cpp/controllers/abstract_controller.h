@@ -14,6 +14,7 @@
 #include "phase_handler.h"
 #include "script_generator.h"
 #include "buses/bus.h"
+#include "shared/memory_util.h"
 #include "shared/s2p_formatter.h"
 
 using namespace spdlog;
@@ -26,7 +27,7 @@ class AbstractController : public PhaseHandler
 public:
 
     AbstractController(Bus&, int, const S2pFormatter&);
-    ~AbstractController() override = default;
+    ~AbstractController() override;
 
     virtual void Error(SenseKey, Asc, StatusCode) = 0;
 
@@ -65,10 +66,21 @@ public:
     ShutdownMode ProcessOnController(int);
 
     void CopyToBuffer(const void*, size_t);
-    auto& GetBuffer() const
+    auto& GetBuffer()
     {
         return buffer;
     }
+    const auto& GetBuffer() const
+    {
+        return buffer;
+    }
+    void SetBorrowedData(data_out_t, shared_ptr<const void>);
+    void ReleaseBorrowedData();
+    // The data to send, either borrowed from a cache or the buffer contents
+    const uint8_t* GetSendData() const
+    {
+        return borrowed_data.empty() ? buffer.data() : borrowed_data.data();
+    }
     auto GetStatus() const
     {
         return status;
@@ -143,8 +155,12 @@ private:
 
     array<int, 16> cdb = { };
 
-    // Shared transfer data buffer, dynamically resized
-    inline static auto buffer = vector<uint8_t>(512);
+    // Transfer data buffer of this controller from the buffer pool, aligned for direct I/O
+    memory_util::aligned_buffer buffer;
+
+    // Cached data sent instead of the buffer contents, valid as long as the pin exists
+    data_out_t borrowed_data;
+    shared_ptr<const void> borrowed_pin;
     // Transfer offset
     int offset = 0;
     // Total remaining bytes to be transferred, updated during the transfer
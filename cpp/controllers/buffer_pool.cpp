@@ -0,0 +1,44 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "buffer_pool.h"
+
+using namespace memory_util;
+
+aligned_buffer BufferPool::Acquire()
+{
+    scoped_lock<mutex> lock(pool_mutex);
+
+    if (buffers.empty()) {
+        return aligned_buffer(max_transfer_size);
+    }
+
+    aligned_buffer buffer = move(buffers.back());
+    buffers.pop_back();
+
+    return buffer;
+}
+
+void BufferPool::Release(aligned_buffer &&buffer)
+{
+    scoped_lock<mutex> lock(pool_mutex);
+
+    // A buffer that has grown beyond the maximum transfer size is not kept
+    if (static_cast<int>(buffer.size()) == max_transfer_size) {
+        buffers.push_back(move(buffer));
+    }
+}
+
+void BufferPool::SetMaxTransferSize(int size)
+{
+    scoped_lock<mutex> lock(pool_mutex);
+
+    max_transfer_size = size;
+
+    buffers.clear();
+}
@@ -0,0 +1,59 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// Provides the page-aligned transfer buffers of the controllers. The buffers are preallocated with the
+// maximum transfer size and are re-used when controllers are deleted and created again. The rare transfers
+// that cannot be split into chunks and exceed this size, e.g. large tape blocks, grow the controller's buffer.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "shared/memory_util.h"
+
+using namespace std;
+
+class BufferPool
+{
+
+public:
+
+    static BufferPool& Instance()
+    {
+        static BufferPool instance; // NOSONAR instance cannot be inlined
+        return instance;
+    }
+
+    BufferPool(BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    memory_util::aligned_buffer Acquire();
+    void Release(memory_util::aligned_buffer&&);
+
+    // Only affects the buffers acquired afterwards
+    void SetMaxTransferSize(int);
+    int GetMaxTransferSize() const
+    {
+        return max_transfer_size;
+    }
+
+    static constexpr int DEFAULT_MAX_TRANSFER_SIZE = 65536;
+    static constexpr int MAX_TRANSFER_SIZE_LIMIT = 16777216;
+
+private:
+
+    BufferPool() = default;
+
+    // The buffers not owned by any controller, guarded by the mutex
+    vector<memory_util::aligned_buffer> buffers;
+
+    atomic_int max_transfer_size = DEFAULT_MAX_TRANSFER_SIZE;
+
+    mutex pool_mutex;
+};
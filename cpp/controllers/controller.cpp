@@ -18,6 +18,8 @@ using namespace s2p_util;
 
 void Controller::Reset()
 {
+    CancelPipelines();
+
     AbstractController::Reset();
 
     identified_lun = -1;
@@ -65,6 +67,10 @@ void Controller::BusFree()
 
         SetStatus(StatusCode::GOOD);
 
+        CancelPipelines();
+
+        ReleaseBorrowedData();
+
         identified_lun = -1;
 
         atn_msg = false;
@@ -217,6 +223,9 @@ void Controller::Status()
     GetBus().SetCD(true);
     GetBus().SetIO(true);
 
+    // The DATA IN phase has ended, the status is sent from the buffer
+    ReleaseBorrowedData();
+
     ResetOffset();
     SetCurrentLength(1);
     SetTransferSize(1, 1);
@@ -311,6 +320,9 @@ void Controller::DataOut()
     LogTrace("DATA OUT phase");
     SetPhase(BusPhase::DATA_OUT);
 
+    const auto device = GetDeviceForLun(GetEffectiveLun());
+    write_behind = device && device->IsWriteBehindSupported(GetCdb());
+
     GetBus().SetMSG(false);
     GetBus().SetCD(false);
     GetBus().SetIO(false);
@@ -320,6 +332,9 @@ void Controller::DataOut()
 
 void Controller::Error(SenseKey sense_key, Asc asc, StatusCode status)
 {
+    // The device must not be accessed while a chunk is still being read or written
+    CancelPipelines();
+
     GetBus().Acquire();
     if (GetBus().GetRST() || IsStatus() || IsMsgIn()) {
         BusFree();
@@ -350,15 +365,22 @@ void Controller::Send()
 
     if (const auto length = GetCurrentLength(); length) {
         if (GetLogger().level() == level::trace && IsDataIn()) {
-            const string &bytes = FormatBytes(GetBuffer(), length);
+            const string &bytes = FormatBytes(span(GetSendData(), length), length);
             LogTrace(fmt::format("Sending {0} byte(s) at offset {1} in DATA IN phase{2}{3}", length, GetOffset(),
                 bytes.empty() ? "" : ":\n", bytes));
         }
 
+        // While this chunk is sent the next chunk can already be read
+        if (IsDataIn() && !GetOffset() && GetRemainingLength() > length) {
+            if (const auto device = GetDeviceForLun(GetEffectiveLun()); device && device->IsReadAheadSupported()) {
+                data_in_pipeline.Start(*device, min(GetRemainingLength() - length, GetChunkSize()));
+            }
+        }
+
         // The DaynaPort delay work-around for the Mac should be taken from the respective LUN, but as there are
         // no Mac Daynaport drivers for LUNs other than 0 the current work-around is fine. The work-around is
         // required for cases where the actually requested LUN does not exist but is tested for with INQUIRY.
-        if (const int l = GetBus().SendHandShake(GetBuffer().data() + GetOffset(), length,
+        if (const int l = GetBus().SendHandShake(GetSendData() + GetOffset(), length,
             GetDeviceForLun(0)->GetDelayAfterBytes()); l != length) {
             LogWarn(fmt::format("Sent {0} byte(s), {1} required", l, length));
             GetBus().SetRST(true);
@@ -421,7 +443,13 @@ void Controller::Receive()
             LogTrace(fmt::format("Receiving {0} byte(s) at offset {1}", length, GetOffset()));
         }
 
-        if (const int l = GetBus().ReceiveHandShake(GetBuffer().data() + GetOffset(), length); l != length) {
+        // With write-behind each chunk is received into a buffer of the pipeline
+        uint8_t *buf = GetBuffer().data() + GetOffset();
+        if (write_behind && IsDataOut()) {
+            buf = data_out_pipeline.GetBuffer(length).data();
+        }
+
+        if (const int l = GetBus().ReceiveHandShake(buf, length); l != length) {
             LogWarn(fmt::format("Received {0} byte(s), {1} required", l, length));
             GetBus().SetRST(true);
             Error(SenseKey::ABORTED_COMMAND, Asc::DATA_PHASE_ERROR);
@@ -429,13 +457,13 @@ void Controller::Receive()
         }
 
         if (GetLogger().level() == level::trace && IsDataOut()) {
-            const string &bytes = FormatBytes(GetBuffer(), length);
+            const string &bytes = FormatBytes(span(buf, length), length);
             LogTrace(
                 fmt::format("Received {0} byte(s) in DATA OUT phase{1}{2}", length, bytes.empty() ? "" : ":\n", bytes));
         }
 
         if (IsDataOut()) {
-            AddDataToScript(span(GetBuffer().data() + GetOffset(), length));
+            AddDataToScript(span(buf, length));
         }
 
         UpdateOffsetAndLength();
@@ -470,8 +498,10 @@ void Controller::Receive()
 
     switch (GetPhase()) {
     case BusPhase::DATA_OUT:
-        // All data have been transferred
-        Status();
+        // All data have been transferred, with write-behind they also have to be written before the status
+        if (DrainWriteBehind()) {
+            Status();
+        }
         break;
 
     case BusPhase::MSG_OUT:
@@ -489,7 +519,13 @@ void Controller::TransferToHost()
     assert(!CommandMetaData::Instance().GetCdbMetaData(static_cast<ScsiCommand>(GetCdb()[0])).has_data_out);
 
     try {
-        GetDeviceForLun(GetEffectiveLun())->ReadData(GetBuffer());
+        if (data_in_pipeline.IsPending()) {
+            const auto& [data, pin] = data_in_pipeline.Get();
+            SetBorrowedData(data, pin);
+        }
+        else {
+            GetDeviceForLun(GetEffectiveLun())->ReadData(GetBuffer());
+        }
         if (GetRemainingLength()) {
             SetCurrentLength(GetRemainingLength() < GetChunkSize() ? GetRemainingLength() : GetChunkSize());
             ResetOffset();
@@ -513,6 +549,9 @@ bool Controller::TransferFromHost(int length)
             // The offset is the number of bytes transferred, i.e. the length of the parameter list
             device->ModeSelect(GetCdb(), GetBuffer(), GetOffset(), 0);
         }
+        else if (write_behind) {
+            data_out_pipeline.Write(*device, GetCdb(), length, GetRemainingLength() <= length);
+        }
         else {
             transferred_length = device->WriteData(GetCdb(), GetBuffer(), GetOffset(), length);
         }
@@ -529,6 +568,36 @@ bool Controller::TransferFromHost(int length)
     return true;
 }
 
+bool Controller::DrainWriteBehind()
+{
+    if (!write_behind) {
+        return true;
+    }
+
+    write_behind = false;
+
+    // An error while writing is reported with the status of the command
+    try {
+        data_out_pipeline.Drain();
+    }
+    catch (const ScsiException &e) {
+        Error(e.get_sense_key(), e.get_asc());
+        return false;
+    }
+
+    return true;
+}
+
+void Controller::CancelPipelines()
+{
+    data_in_pipeline.Cancel();
+
+    if (write_behind) {
+        write_behind = false;
+        data_out_pipeline.Cancel();
+    }
+}
+
 void Controller::XferMsg()
 {
     assert(IsMsgOut());
@@ -9,6 +9,8 @@
 #pragma once
 
 #include "abstract_controller.h"
+#include "data_in_pipeline.h"
+#include "data_out_pipeline.h"
 
 class Controller : public AbstractController
 {
@@ -43,6 +45,8 @@ private:
     void XferMsg();
     void TransferToHost();
     bool TransferFromHost(int);
+    bool DrainWriteBehind();
+    void CancelPipelines();
 
     void ParseMessage();
     void ProcessMessage();
@@ -66,5 +70,12 @@ private:
     Asc deferred_asc = Asc::NO_ADDITIONAL_SENSE_INFORMATION;
 
     vector<uint8_t> msg_bytes;
+
+    // Reads the next DATA IN chunk while the current chunk is being sent
+    DataInPipeline data_in_pipeline;
+
+    // Writes the DATA OUT chunks while the next chunk is being received, only for commands the device supports this for
+    DataOutPipeline data_out_pipeline;
+    bool write_behind = false;
 };
 
@@ -0,0 +1,127 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "data_in_pipeline.h"
+#include <cassert>
+#include "base/primary_device.h"
+
+DataInPipeline::~DataInPipeline()
+{
+    {
+        scoped_lock<mutex> lock(pipeline_mutex);
+        stop = true;
+    }
+    pipeline_condition.notify_all();
+
+    if (pipeline_thread.joinable()) {
+        pipeline_thread.join();
+    }
+}
+
+void DataInPipeline::Start(PrimaryDevice &d, int length)
+{
+    assert(!pending);
+
+    // The buffer not used for the chunk currently being sent
+    buffer_index ^= 1;
+    auto &buffer = buffers[buffer_index];
+    if (!buffer) {
+        buffer = make_shared<memory_util::aligned_buffer>(length);
+    }
+    else if (static_cast<int>(buffer->size()) < length) {
+        buffer->resize(length);
+    }
+
+    {
+        scoped_lock<mutex> lock(pipeline_mutex);
+        device = &d;
+        request = span(buffer->data(), length);
+        done = false;
+        result = { };
+        error = nullptr;
+    }
+
+    if (!pipeline_thread.joinable()) {
+#ifndef __APPLE__
+        pipeline_thread = jthread([this]() {Execute();});
+#else
+        pipeline_thread = thread([this] () { Execute(); } );
+#endif
+    }
+
+    pending = true;
+
+    pipeline_condition.notify_all();
+}
+
+pair<data_out_t, shared_ptr<const void>> DataInPipeline::Get()
+{
+    assert(pending);
+
+    pending = false;
+
+    unique_lock<mutex> lock(pipeline_mutex);
+    pipeline_condition.wait(lock, [this] {return done;});
+
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    // Data read into the pipeline buffer are pinned by this buffer
+    if (!result.second) {
+        result.second = buffers[buffer_index];
+    }
+
+    return result;
+}
+
+void DataInPipeline::Cancel()
+{
+    if (pending) {
+        pending = false;
+
+        unique_lock<mutex> lock(pipeline_mutex);
+        pipeline_condition.wait(lock, [this] {return done;});
+        result = { };
+        error = nullptr;
+    }
+}
+
+void DataInPipeline::Execute()
+{
+    unique_lock<mutex> lock(pipeline_mutex);
+
+    while (true) {
+        pipeline_condition.wait(lock, [this] {return stop || device;});
+        if (stop) {
+            return;
+        }
+
+        PrimaryDevice *d = device;
+        device = nullptr;
+        const data_in_t buf = request;
+
+        // The controller must be able to send the previous chunk while the next chunk is read
+        lock.unlock();
+        pair<data_out_t, shared_ptr<const void>> r;
+        exception_ptr e;
+        try {
+            r = d->ReadAhead(buf);
+        }
+        catch (...) {
+            e = current_exception();
+        }
+        lock.lock();
+
+        result = r;
+        error = e;
+        done = true;
+
+        pipeline_condition.notify_all();
+    }
+}
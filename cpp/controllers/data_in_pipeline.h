@@ -0,0 +1,79 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// Reads the next DATA IN chunk on a background thread while the controller sends the current chunk.
+// The chunks are read into two buffers owned by the pipeline, which are used alternately. A buffer is
+// not re-used before the chunk read into it has been sent.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "shared/memory_util.h"
+#include "shared/s2p_defs.h"
+
+using namespace std;
+
+class PrimaryDevice;
+
+class DataInPipeline
+{
+
+public:
+
+    DataInPipeline() = default;
+    ~DataInPipeline();
+    DataInPipeline(DataInPipeline&) = delete;
+    DataInPipeline& operator=(const DataInPipeline&) = delete;
+
+    // Starts reading a chunk with the specified length
+    void Start(PrimaryDevice&, int);
+
+    // Waits for the chunk, rethrows the exception raised while reading it
+    pair<data_out_t, shared_ptr<const void>> Get();
+
+    // Waits for a pending read and discards the chunk
+    void Cancel();
+
+    bool IsPending() const
+    {
+        return pending;
+    }
+
+private:
+
+    void Execute();
+
+    // Only accessed by the controller thread
+    bool pending = false;
+    int buffer_index = 0;
+    array<shared_ptr<memory_util::aligned_buffer>, 2> buffers;
+
+    // The current request and its result, guarded by the mutex
+    PrimaryDevice *device = nullptr;
+    data_in_t request;
+    bool done = false;
+    pair<data_out_t, shared_ptr<const void>> result;
+    exception_ptr error;
+
+    bool stop = false;
+
+    mutex pipeline_mutex;
+
+    condition_variable pipeline_condition;
+
+#ifndef __APPLE__
+    jthread pipeline_thread;
+#else
+    thread pipeline_thread;
+#endif
+};
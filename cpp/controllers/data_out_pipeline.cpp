@@ -0,0 +1,121 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "data_out_pipeline.h"
+#include "base/primary_device.h"
+
+DataOutPipeline::~DataOutPipeline()
+{
+    {
+        scoped_lock<mutex> lock(pipeline_mutex);
+        stop = true;
+    }
+    pipeline_condition.notify_all();
+
+    if (pipeline_thread.joinable()) {
+        pipeline_thread.join();
+    }
+}
+
+data_in_t DataOutPipeline::GetBuffer(int length)
+{
+    // The buffers are written in the order they were received in, i.e. the next buffer is free as soon as
+    // fewer chunks than buffers are pending
+    {
+        unique_lock<mutex> lock(pipeline_mutex);
+        pipeline_condition.wait(lock, [this] {return chunks.size() < RING_SIZE;});
+    }
+
+    auto &buffer = buffers[buffer_index];
+    if (static_cast<int>(buffer.size()) < length) {
+        buffer.resize(length);
+    }
+
+    return span(buffer.data(), length);
+}
+
+void DataOutPipeline::Write(PrimaryDevice &device, cdb_t cdb, int length, bool last)
+{
+    {
+        scoped_lock<mutex> lock(pipeline_mutex);
+        chunks.push_back( { &device, cdb, span(buffers[buffer_index].data(), length), last });
+    }
+
+    buffer_index = (buffer_index + 1) % RING_SIZE;
+
+    if (!pipeline_thread.joinable()) {
+#ifndef __APPLE__
+        pipeline_thread = jthread([this]() {Execute();});
+#else
+        pipeline_thread = thread([this] () { Execute(); } );
+#endif
+    }
+
+    pipeline_condition.notify_all();
+}
+
+void DataOutPipeline::Drain()
+{
+    unique_lock<mutex> lock(pipeline_mutex);
+    Wait(lock);
+
+    if (error) {
+        const exception_ptr e = error;
+        error = nullptr;
+        rethrow_exception(e);
+    }
+}
+
+void DataOutPipeline::Cancel()
+{
+    unique_lock<mutex> lock(pipeline_mutex);
+    Wait(lock);
+
+    error = nullptr;
+}
+
+void DataOutPipeline::Wait(unique_lock<mutex> &lock)
+{
+    pipeline_condition.wait(lock, [this] {return chunks.empty();});
+}
+
+void DataOutPipeline::Execute()
+{
+    unique_lock<mutex> lock(pipeline_mutex);
+
+    while (true) {
+        pipeline_condition.wait(lock, [this] {return stop || !chunks.empty();});
+        if (stop) {
+            return;
+        }
+
+        // After an error the remaining chunks of the command are discarded
+        const Chunk chunk = chunks.front();
+        const bool discard = error != nullptr;
+
+        // The controller must be able to receive the next chunk while this chunk is written
+        lock.unlock();
+        exception_ptr e;
+        if (!discard) {
+            try {
+                chunk.device->WriteBehind(chunk.cdb, chunk.data, chunk.last);
+            }
+            catch (...) {
+                e = current_exception();
+            }
+        }
+        lock.lock();
+
+        if (e) {
+            error = e;
+        }
+        chunks.pop_front();
+
+        pipeline_condition.notify_all();
+    }
+}
@@ -0,0 +1,87 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// Writes the received DATA OUT chunks on a background thread while the controller receives the next chunk.
+// The chunks are received into a ring of buffers owned by the pipeline. The controller only has to wait
+// when all buffers are waiting to be written. An error is reported when the pipeline is drained.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "shared/memory_util.h"
+#include "shared/s2p_defs.h"
+
+using namespace std;
+
+class PrimaryDevice;
+
+class DataOutPipeline
+{
+
+public:
+
+    DataOutPipeline() = default;
+    ~DataOutPipeline();
+    DataOutPipeline(DataOutPipeline&) = delete;
+    DataOutPipeline& operator=(const DataOutPipeline&) = delete;
+
+    // Returns the buffer for receiving the next chunk with the specified length
+    data_in_t GetBuffer(int);
+
+    // Writes the chunk received into the buffer, the flag signals the last chunk of the command
+    void Write(PrimaryDevice&, cdb_t, int, bool);
+
+    // Waits until all chunks have been written, rethrows the first exception raised while writing
+    void Drain();
+
+    // Waits until all chunks have been written and discards any error
+    void Cancel();
+
+    static constexpr int RING_SIZE = 4;
+
+private:
+
+    void Wait(unique_lock<mutex>&);
+
+    void Execute();
+
+    // Only accessed by the controller thread
+    int buffer_index = 0;
+    array<memory_util::aligned_buffer, RING_SIZE> buffers;
+
+    struct Chunk
+    {
+        PrimaryDevice *device;
+        cdb_t cdb;
+        data_out_t data;
+        bool last;
+    };
+
+    // The chunks not yet written, including the chunk currently being written, guarded by the mutex
+    deque<Chunk> chunks;
+
+    // The first error, subsequent chunks are discarded, guarded by the mutex
+    exception_ptr error;
+
+    bool stop = false;
+
+    mutex pipeline_mutex;
+
+    condition_variable pipeline_condition;
+
+#ifndef __APPLE__
+    jthread pipeline_thread;
+#else
+    thread pipeline_thread;
+#endif
+};
@@ -0,0 +1,249 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "block_store.h"
+#include <bit>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace filesystem;
+
+BlockStore::~BlockStore()
+{
+    if (data_fd != -1) {
+        close(data_fd);
+    }
+
+    if (index_fd != -1) {
+        close(index_fd);
+    }
+}
+
+bool BlockStore::Init()
+{
+    if (folder.empty() || data_fd != -1) {
+        return false;
+    }
+
+    if (error_code error; !exists(path(folder), error) && !create_directories(path(folder), error)) {
+        return false;
+    }
+
+    data_fd = open((folder + "/blocks").c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    index_fd = open((folder + "/index").c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    if (data_fd == -1 || index_fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(index_fd, &st)) {
+        return false;
+    }
+
+    // An incomplete index entry, e.g. after a power failure, is ignored
+    vector<uint8_t> index(st.st_size / sizeof(block_hash) * sizeof(block_hash));
+    if (pread(index_fd, index.data(), index.size(), 0) != static_cast<ssize_t>(index.size())) {
+        return false;
+    }
+
+    for (size_t offset = 0; offset < index.size(); offset += sizeof(block_hash)) {
+        block_hash hash;
+        memcpy(hash.data(), index.data() + offset, hash.size());
+        blocks.try_emplace(hash, offset / sizeof(block_hash));
+    }
+
+    return true;
+}
+
+shared_ptr<BlockStore> BlockStore::GetStore(const string &folder)
+{
+    scoped_lock<mutex> lock(stores_mutex);
+
+    if (auto store = stores[folder].lock(); store) {
+        return store;
+    }
+
+    auto store = make_shared<BlockStore>(folder);
+    if (!store->Init()) {
+        return nullptr;
+    }
+
+    stores[folder] = store;
+
+    return store;
+}
+
+bool BlockStore::ReadBlock(const block_hash &hash, span<uint8_t> buf)
+{
+    scoped_lock<mutex> lock(store_mutex);
+
+    if (const auto &it = cache_index.find(hash); it != cache_index.end()) {
+        cache.splice(cache.begin(), cache, it->second);
+        memcpy(buf.data(), cache.front().second.data(), BLOCK_SIZE);
+        return true;
+    }
+
+    ++cache_miss_count;
+
+    const auto &it = blocks.find(hash);
+    if (it == blocks.end()
+        || pread(data_fd, buf.data(), BLOCK_SIZE, static_cast<off_t>(it->second) * BLOCK_SIZE) != BLOCK_SIZE) {
+        return false;
+    }
+
+    CacheBlock(hash, buf);
+
+    return true;
+}
+
+bool BlockStore::WriteBlock(span<const uint8_t> buf, block_hash &hash)
+{
+    hash = Hash(buf.first(BLOCK_SIZE));
+
+    scoped_lock<mutex> lock(store_mutex);
+
+    // A block with the same contents only has to be referenced
+    if (!blocks.contains(hash)) {
+        const uint64_t block = blocks.size();
+
+        // The data are written before the index entry, so that the index never references a block without data
+        if (pwrite(data_fd, buf.data(), BLOCK_SIZE, static_cast<off_t>(block) * BLOCK_SIZE) != BLOCK_SIZE
+            || pwrite(index_fd, hash.data(), hash.size(), static_cast<off_t>(block * hash.size()))
+                != static_cast<ssize_t>(hash.size())) {
+            return false;
+        }
+
+        blocks[hash] = block;
+    }
+
+    CacheBlock(hash, buf);
+
+    return true;
+}
+
+void BlockStore::CacheBlock(const block_hash &hash, span<const uint8_t> buf)
+{
+    if (const auto &it = cache_index.find(hash); it != cache_index.end()) {
+        cache.splice(cache.begin(), cache, it->second);
+        return;
+    }
+
+    // Reuse the memory of the least recently used block
+    vector<uint8_t> data;
+    if (static_cast<int>(cache.size()) >= DEFAULT_CACHED_BLOCKS) {
+        data = std::move(cache.back().second);
+        cache_index.erase(cache.back().first);
+        cache.pop_back();
+    }
+
+    data.assign(buf.begin(), buf.begin() + BLOCK_SIZE);
+    cache.emplace_front(hash, std::move(data));
+    cache_index[hash] = cache.begin();
+}
+
+bool BlockStore::Flush()
+{
+    return fsync(data_fd) != -1 && fsync(index_fd) != -1;
+}
+
+uint64_t BlockStore::GetBlockCount()
+{
+    scoped_lock<mutex> lock(store_mutex);
+
+    return blocks.size();
+}
+
+// SHA-256 as specified by FIPS 180-4
+BlockStore::block_hash BlockStore::Hash(span<const uint8_t> data)
+{
+    static constexpr array<uint32_t, 64> K = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+    array<uint32_t, 8> h = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab,
+        0x5be0cd19 };
+
+    // The message is padded with 0x80, zeros and the message length in bits to a multiple of 64 bytes
+    const uint64_t length = data.size();
+    const uint64_t padded_length = (length + 8) / 64 * 64 + 64;
+
+    const auto get_byte = [&data, length, padded_length](uint64_t i) -> uint8_t {
+        if (i < length) {
+            return data[i];
+        }
+        if (i == length) {
+            return 0x80;
+        }
+        if (i >= padded_length - 8) {
+            return static_cast<uint8_t>((length * 8) >> ((padded_length - 1 - i) * 8));
+        }
+        return 0;
+    };
+
+    array<uint32_t, 64> w;
+    for (uint64_t chunk = 0; chunk < padded_length; chunk += 64) {
+        for (int i = 0; i < 16; ++i) {
+            // Complete chunks can be read directly
+            if (chunk + 64 <= length) {
+                w[i] = data[chunk + i * 4] << 24 | data[chunk + i * 4 + 1] << 16 | data[chunk + i * 4 + 2] << 8
+                    | data[chunk + i * 4 + 3];
+            }
+            else {
+                w[i] = get_byte(chunk + i * 4) << 24 | get_byte(chunk + i * 4 + 1) << 16
+                    | get_byte(chunk + i * 4 + 2) << 8 | get_byte(chunk + i * 4 + 3);
+            }
+        }
+
+        for (int i = 16; i < 64; ++i) {
+            const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        auto [a, b, c, d, e, f, g, hh] = h;
+        for (int i = 0; i < 64; ++i) {
+            const uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+
+    block_hash hash;
+    for (size_t i = 0; i < h.size(); ++i) {
+        hash[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+        hash[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+        hash[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+        hash[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+    }
+
+    return hash;
+}
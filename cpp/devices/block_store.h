@@ -0,0 +1,106 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// A content-addressed store for blocks of 4 KiB, which is shared by all deduplicated images referencing it.
+// Each distinct block is only stored once. The store folder contains a data file with the blocks and an index
+// file with the SHA-256 hashes of these blocks, in the same order. Recently used blocks are cached in memory
+// by their hash, i.e. a block read by one device is a cache hit for all other devices using the store.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+class BlockStore
+{
+
+public:
+
+    using block_hash = array<uint8_t, 32>;
+
+    explicit BlockStore(const string &f) : folder(f)
+    {
+    }
+    ~BlockStore();
+    BlockStore(BlockStore&) = delete;
+    BlockStore& operator=(const BlockStore&) = delete;
+
+    bool Init();
+
+    bool ReadBlock(const block_hash&, span<uint8_t>);
+    bool WriteBlock(span<const uint8_t>, block_hash&);
+
+    bool Flush();
+
+    // The number of distinct blocks in the store
+    uint64_t GetBlockCount();
+
+    uint64_t GetCacheMissCount() const
+    {
+        return cache_miss_count;
+    }
+
+    // Returns the initialized store for the specified folder, the same store instance is shared by all devices
+    static shared_ptr<BlockStore> GetStore(const string&);
+
+    static block_hash Hash(span<const uint8_t>);
+
+    static constexpr int BLOCK_SIZE = 4096;
+
+    // The number of blocks cached in memory
+    static constexpr int DEFAULT_CACHED_BLOCKS = 1024;
+
+    // The name of the store folder in the default image folder
+    static constexpr const char *DEFAULT_FOLDER = ".s2p_blocks";
+
+private:
+
+    struct HashHasher
+    {
+        // The hash already is evenly distributed
+        size_t operator()(const block_hash &h) const
+        {
+            size_t value;
+            memcpy(&value, h.data(), sizeof(value));
+            return value;
+        }
+    };
+
+    void CacheBlock(const block_hash&, span<const uint8_t>);
+
+    string folder;
+
+    int data_fd = -1;
+    int index_fd = -1;
+
+    // The block numbers in the data file by hash
+    unordered_map<block_hash, uint64_t, HashHasher> blocks;
+
+    // The cached blocks, the most recently used block first
+    list<pair<block_hash, vector<uint8_t>>> cache;
+    unordered_map<block_hash, list<pair<block_hash, vector<uint8_t>>>::iterator, HashHasher> cache_index;
+
+    // Guards the store against concurrent access by different devices
+    mutex store_mutex;
+
+    uint64_t cache_miss_count = 0;
+
+    inline static unordered_map<string, weak_ptr<BlockStore>> stores;
+
+    inline static mutex stores_mutex;
+};
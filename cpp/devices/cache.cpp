@@ -0,0 +1,76 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "cache.h"
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+bool Cache::ZeroRange([[maybe_unused]] int fd, [[maybe_unused]] off_t offset, [[maybe_unused]] off_t length,
+    [[maybe_unused]] bool deallocate)
+{
+#ifdef __linux__
+    // The file size does not change, not all filesystems and no block devices support this
+    return !fallocate(fd, (deallocate ? FALLOC_FL_PUNCH_HOLE : FALLOC_FL_ZERO_RANGE) | FALLOC_FL_KEEP_SIZE, offset,
+        length);
+#else
+    return false;
+#endif
+}
+
+bool Cache::WriteRange(int fd, span<const uint8_t> data, off_t offset)
+{
+    if (data.size() >= MIN_HOLE_SIZE && IsZero(data) && ZeroRange(fd, offset, data.size(), true)) {
+        return true;
+    }
+
+    return pwrite(fd, data.data(), data.size(), offset) == static_cast<ssize_t>(data.size());
+}
+
+uint64_t Cache::GetResidentBytes([[maybe_unused]] const void *address, [[maybe_unused]] size_t length)
+{
+#ifdef __linux__
+    const auto page_size = static_cast<size_t>(getpagesize());
+    vector<unsigned char> pages((length + page_size - 1) / page_size);
+    if (!length || mincore(const_cast<void*>(address), length, pages.data())) {
+        return 0;
+    }
+
+    return ranges::count_if(pages, [](unsigned char p) {return p & 1;}) * page_size;
+#else
+    return 0;
+#endif
+}
+
+uint64_t Cache::GetResidentBytes(int fd, size_t length)
+{
+    if (fd == -1 || !length) {
+        return 0;
+    }
+
+    // Mapping the file without accessing it does not change what is cached
+    void *address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        return 0;
+    }
+
+    const uint64_t resident_bytes = GetResidentBytes(address, length);
+
+    munmap(address, length);
+
+    return resident_bytes;
+}
+
+bool Cache::IsZero(span<const uint8_t> data)
+{
+    // Comparing the data with themselves shifted by one byte is much faster than a loop
+    return data.empty() || (!data[0] && !memcmp(data.data(), data.data() + 1, data.size() - 1));
+}
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <memory>
+#include <sys/types.h>
 #include "shared/s2p_defs.h"
 #include "generated/s2p_interface.pb.h"
 
@@ -24,12 +26,46 @@ public:
     virtual int ReadSectors(data_in_t, uint64_t, uint32_t) = 0;
     virtual int WriteSectors(data_out_t, uint64_t, uint32_t) = 0;
 
+    // Provides the data of the specified sectors without copying them, if they are available in a single buffer.
+    // The data remain valid as long as the returned pin exists.
+    virtual pair<data_out_t, shared_ptr<const void>> BorrowSectors(uint64_t, uint32_t)
+    {
+        return { };
+    }
+
+    // Sets the sectors to zero without transferring any data, optionally deallocating them in the image file.
+    // If this is not supported the caller has to write zeros.
+    virtual bool ZeroSectors(uint64_t, uint64_t, bool)
+    {
+        return false;
+    }
+
+    // Writes the cached data to the image file
     virtual bool Flush() = 0;
 
+    // Makes the data written so far durable. Caches that do not sync with Flush() have to override this.
+    virtual bool Sync()
+    {
+        return Flush();
+    }
+
     virtual bool Init() = 0;
 
     virtual vector<PbStatistics> GetStatistics(bool) const = 0;
 
+    // Zeroes a range of the image file, when deallocating the range becomes a hole in the sparse file
+    static bool ZeroRange(int, off_t, off_t, bool);
+
+    // Writes to the image file, zeros of at least a filesystem block are deallocated instead of being written
+    static bool WriteRange(int, span<const uint8_t>, off_t);
+
+    static bool IsZero(span<const uint8_t>);
+
+    // The number of bytes of a memory range that are resident in memory, for a file mapping in the page cache
+    static uint64_t GetResidentBytes(const void*, size_t);
+    // The number of bytes of the start of a file that are resident in the kernel page cache
+    static uint64_t GetResidentBytes(int, size_t);
+
 protected:
 
     Cache() = default;
@@ -38,4 +74,18 @@ protected:
     static constexpr const char *WRITE_ERROR_COUNT = "write_error_count";
     static constexpr const char *CACHE_MISS_READ_COUNT = "cache_miss_read_count";
     static constexpr const char *CACHE_MISS_WRITE_COUNT = "cache_miss_write_count";
+    static constexpr const char *PREFETCH_HIT_COUNT = "prefetch_hit_count";
+    static constexpr const char *CACHE_HIT_READ_COUNT = "cache_hit_read_count";
+    static constexpr const char *CACHE_HIT_WRITE_COUNT = "cache_hit_write_count";
+    static constexpr const char *CACHE_EVICTION_COUNT = "cache_eviction_count";
+    static constexpr const char *CACHE_DIRTY_BYTES = "cache_dirty_bytes";
+    static constexpr const char *CACHE_RESIDENT_BYTES = "cache_resident_bytes";
+    static constexpr const char *WRITE_BACK_BYTE_COUNT = "write_back_byte_count";
+    static constexpr const char *SERVED_READ_BYTE_COUNT = "served_read_byte_count";
+    static constexpr const char *SERVED_WRITE_BYTE_COUNT = "served_write_byte_count";
+
+private:
+
+    // Smaller holes do not save any space
+    static constexpr size_t MIN_HOLE_SIZE = 4096;
 };
@@ -0,0 +1,61 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "caching_mode_selector.h"
+
+PbCachingMode CachingModeSelector::Update(uint64_t start, uint32_t count, uint32_t sector_size)
+{
+    if (!count) {
+        return mode;
+    }
+
+    const bool is_sequential = start == next_sector;
+    next_sector = start + count;
+
+    const auto bytes = static_cast<int64_t>(count) * sector_size;
+
+    // The oldest command leaves the window
+    if (const int64_t oldest = window[position]; oldest) {
+        total_bytes -= oldest < 0 ? -oldest : oldest;
+        if (oldest < 0) {
+            --sequential_commands;
+        }
+    }
+
+    window[position] = is_sequential ? -bytes : bytes;
+    position = (position + 1) % WINDOW_SIZE;
+    total_bytes += bytes;
+    if (is_sequential) {
+        ++sequential_commands;
+    }
+
+    // After a switch the window has to be filled with commands processed by the new mode
+    if (commands < WINDOW_SIZE && ++commands < WINDOW_SIZE) {
+        return mode;
+    }
+
+    const uint64_t average_bytes = total_bytes / WINDOW_SIZE;
+    const int sequential_percentage = sequential_commands * 100 / WINDOW_SIZE;
+
+    PbCachingMode recommended_mode = mode;
+    if (mode == PbCachingMode::PISCSI && average_bytes >= LARGE_REQUEST_BYTES
+        && sequential_percentage >= SEQUENTIAL_PERCENTAGE_HIGH) {
+        recommended_mode = PbCachingMode::LINUX_OPTIMIZED;
+    }
+    else if (mode == PbCachingMode::LINUX_OPTIMIZED && average_bytes <= SMALL_REQUEST_BYTES
+        && sequential_percentage <= SEQUENTIAL_PERCENTAGE_LOW) {
+        recommended_mode = PbCachingMode::PISCSI;
+    }
+
+    if (recommended_mode != mode) {
+        mode = recommended_mode;
+        commands = 0;
+    }
+
+    return mode;
+}
@@ -0,0 +1,63 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// Watches the size and the locality of the read and write commands over a sliding window and recommends
+// a caching mode. Small random requests favor the PiSCSI track cache, large sequential requests favor
+// transferring all sectors of a command with a single access to the page cache.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include "generated/s2p_interface.pb.h"
+
+using namespace std;
+using namespace s2p_interface;
+
+class CachingModeSelector
+{
+
+public:
+
+    explicit CachingModeSelector(PbCachingMode m) : mode(m)
+    {
+    }
+
+    // Returns the recommended caching mode, which only changes when the window is completely filled
+    PbCachingMode Update(uint64_t, uint32_t, uint32_t);
+
+    PbCachingMode GetMode() const
+    {
+        return mode;
+    }
+
+    // The number of commands in the window
+    static constexpr int WINDOW_SIZE = 64;
+
+    // Different thresholds for switching in each direction prevent frequent switching
+    static constexpr uint64_t LARGE_REQUEST_BYTES = 64 * 1024;
+    static constexpr uint64_t SMALL_REQUEST_BYTES = 16 * 1024;
+    static constexpr int SEQUENTIAL_PERCENTAGE_HIGH = 75;
+    static constexpr int SEQUENTIAL_PERCENTAGE_LOW = 50;
+
+private:
+
+    PbCachingMode mode;
+
+    // The byte counts of the commands in the window, negative for sequential commands
+    array<int64_t, WINDOW_SIZE> window = { };
+
+    int position = 0;
+
+    // The commands since the last switch, at most the window size
+    int commands = 0;
+
+    uint64_t total_bytes = 0;
+    int sequential_commands = 0;
+
+    uint64_t next_sector = UINT64_MAX;
+};
@@ -0,0 +1,329 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "compressed_cache.h"
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <sys/stat.h>
+#include "shared/s2p_util.h"
+
+using namespace s2p_util;
+
+CompressedCache::~CompressedCache()
+{
+    // The prefetcher thread must not access the image file anymore
+    prefetcher.reset();
+
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+bool CompressedCache::Init()
+{
+    if (!sector_size || !sectors || fd != -1 || !Open()) {
+        return false;
+    }
+
+    if (image_size < sectors * sector_size) {
+        return false;
+    }
+
+    prefetcher = make_unique<Prefetcher>([this](uint64_t start, uint64_t count) {Prefetch(start, count);},
+        static_cast<uint64_t>(PREFETCH_CHUNKS) * chunk_length / sector_size);
+
+    return true;
+}
+
+bool CompressedCache::Open()
+{
+    fd = open(filename.c_str(), O_RDONLY);
+
+    return fd != -1 && ReadIndex();
+}
+
+bool CompressedCache::ReadIndex()
+{
+    vector<uint8_t> header(MAX_HEADER_SIZE);
+    const ssize_t length = pread(fd, header.data(), header.size(), 0);
+
+    // gzip header with deflate compression, dictzip requires the extra field
+    if (length < GZIP_HEADER_SIZE + 2 || header[0] != 0x1f || header[1] != 0x8b || header[2] != Z_DEFLATED
+        || !(header[3] & FEXTRA)) {
+        return false;
+    }
+
+    const auto get_int16 = [&header](int offset) {return header[offset] | header[offset + 1] << 8;};
+
+    int offset = GZIP_HEADER_SIZE + 2;
+    const int extra_end = offset + get_int16(GZIP_HEADER_SIZE);
+    if (extra_end > length) {
+        return false;
+    }
+
+    // Find the random access subfield with the chunk size and the compressed chunk sizes
+    vector<uint32_t> chunk_sizes;
+    while (offset + 4 <= extra_end) {
+        const int subfield_length = get_int16(offset + 2);
+        if (offset + 4 + subfield_length > extra_end) {
+            return false;
+        }
+
+        if (header[offset] == 'R' && header[offset + 1] == 'A' && subfield_length >= 6 && get_int16(offset + 4) == 1) {
+            chunk_length = get_int16(offset + 6);
+            const int count = get_int16(offset + 8);
+            if (subfield_length < 6 + count * 2) {
+                return false;
+            }
+
+            for (int i = 0; i < count; ++i) {
+                chunk_sizes.push_back(get_int16(offset + 10 + i * 2));
+            }
+        }
+
+        offset += 4 + subfield_length;
+    }
+
+    if (!chunk_length || chunk_sizes.empty()) {
+        return false;
+    }
+
+    offset = extra_end;
+
+    // The compressed data follow the optional zero-terminated name and comment and the header CRC
+    for (const uint8_t flag : { FNAME, FCOMMENT }) {
+        if (header[3] & flag) {
+            const auto *end = static_cast<const uint8_t*>(memchr(header.data() + offset, 0, length - offset));
+            if (!end) {
+                return false;
+            }
+            offset = static_cast<int>(end - header.data()) + 1;
+        }
+    }
+
+    if (header[3] & FHCRC) {
+        offset += 2;
+    }
+
+    chunk_offsets.clear();
+    chunk_offsets.push_back(offset);
+    for (const uint32_t size : chunk_sizes) {
+        chunk_offsets.push_back(chunk_offsets.back() + size);
+    }
+
+    // The gzip trailer contains the uncompressed size modulo 2^32, which determines the size of the last chunk
+    struct stat st;
+    array<uint8_t, 4> trailer;
+    if (fstat(fd, &st) || st.st_size < chunk_offsets.back() + 8
+        || pread(fd, trailer.data(), trailer.size(), st.st_size - 4) != static_cast<ssize_t>(trailer.size())) {
+        return false;
+    }
+
+    const uint64_t full_chunks_size = static_cast<uint64_t>(chunk_sizes.size() - 1) * chunk_length;
+    const uint32_t last_chunk_length = (trailer[0] | trailer[1] << 8 | trailer[2] << 16
+        | static_cast<uint32_t>(trailer[3]) << 24) - static_cast<uint32_t>(full_chunks_size);
+    if (!last_chunk_length || last_chunk_length > chunk_length) {
+        return false;
+    }
+
+    image_size = full_chunks_size + last_chunk_length;
+
+    return true;
+}
+
+int CompressedCache::ReadSectors(data_in_t buf, uint64_t start, uint32_t count)
+{
+    if (fd == -1 || sectors < start + count) {
+        return 0;
+    }
+
+    const uint64_t length = static_cast<uint64_t>(count) * sector_size;
+    uint64_t position = start * sector_size;
+
+    for (uint64_t offset = 0; offset < length;) {
+        const auto &chunk = GetChunk(static_cast<uint32_t>(position / chunk_length), false);
+        if (!chunk) {
+            ++read_error_count;
+            return 0;
+        }
+
+        const uint64_t chunk_offset = position % chunk_length;
+        const uint64_t n = min(length - offset, chunk->data.size() - chunk_offset);
+        memcpy(buf.data() + offset, chunk->data.data() + chunk_offset, n);
+
+        offset += n;
+        position += n;
+    }
+
+    prefetcher->Update(start, count);
+
+    served_read_byte_count += length;
+
+    return static_cast<int>(length);
+}
+
+shared_ptr<CompressedCache::Chunk> CompressedCache::GetChunk(uint32_t chunk, bool prefetch)
+{
+    {
+        scoped_lock<mutex> lock(cache_mutex);
+
+        if (const auto &it = chunk_index.find(chunk); it != chunk_index.end()) {
+            chunks.splice(chunks.begin(), chunks, it->second);
+
+            auto &c = chunks.front().second;
+            if (!prefetch) {
+                ++cache_hit_read_count;
+                if (c->is_prefetched) {
+                    c->is_prefetched = false;
+                    ++prefetch_hit_count;
+                }
+            }
+
+            return c;
+        }
+
+        if (!prefetch) {
+            ++cache_miss_read_count;
+        }
+    }
+
+    // Decompressing does not require the lock
+    auto c = make_shared<Chunk>();
+    c->is_prefetched = prefetch;
+    if (!Decompress(chunk, c->data)) {
+        return nullptr;
+    }
+
+    scoped_lock<mutex> lock(cache_mutex);
+
+    // The chunk may have been decompressed by the other thread in the meantime
+    if (const auto &it = chunk_index.find(chunk); it != chunk_index.end()) {
+        return it->second->second;
+    }
+
+    if (static_cast<int>(chunks.size()) >= DEFAULT_CHUNKS) {
+        chunk_index.erase(chunks.back().first);
+        chunks.pop_back();
+        ++eviction_count;
+    }
+
+    chunks.emplace_front(chunk, c);
+    chunk_index[chunk] = chunks.begin();
+
+    return c;
+}
+
+bool CompressedCache::Decompress(uint32_t chunk, vector<uint8_t> &data)
+{
+    if (chunk + 1 >= chunk_offsets.size()) {
+        return false;
+    }
+
+    vector<uint8_t> compressed(chunk_offsets[chunk + 1] - chunk_offsets[chunk]);
+    if (pread(fd, compressed.data(), compressed.size(), chunk_offsets[chunk])
+        != static_cast<ssize_t>(compressed.size())) {
+        return false;
+    }
+
+    data.resize(min(static_cast<uint64_t>(chunk_length), image_size - static_cast<uint64_t>(chunk) * chunk_length));
+
+    // Each chunk is a raw deflate stream flushed at the chunk boundary
+    z_stream stream = { };
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+
+    stream.next_in = compressed.data();
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = data.data();
+    stream.avail_out = static_cast<uInt>(data.size());
+
+    const int status = inflate(&stream, Z_SYNC_FLUSH);
+
+    inflateEnd(&stream);
+
+    return (status == Z_OK || status == Z_STREAM_END) && !stream.avail_out;
+}
+
+// Called by the prefetcher thread
+void CompressedCache::Prefetch(uint64_t start, uint64_t count)
+{
+    const uint64_t end = min(start + count, sectors);
+    if (start >= end) {
+        return;
+    }
+
+    for (uint64_t chunk = start * sector_size / chunk_length; chunk <= (end * sector_size - 1) / chunk_length;
+        ++chunk) {
+        GetChunk(static_cast<uint32_t>(chunk), true);
+    }
+}
+
+off_t CompressedCache::GetImageSize(const string &filename)
+{
+    CompressedCache cache(filename, 0, 0);
+
+    return cache.Open() ? static_cast<off_t>(cache.image_size) : -1;
+}
+
+bool CompressedCache::IsCompressed(const string &filename)
+{
+    return GetExtensionLowerCase(filename) == "dz";
+}
+
+vector<PbStatistics> CompressedCache::GetStatistics(bool) const
+{
+    vector<PbStatistics> statistics;
+
+    PbStatistics s;
+
+    s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+    s.set_key(CACHE_MISS_READ_COUNT);
+    s.set_value(cache_miss_read_count);
+    statistics.push_back(s);
+
+    s.set_key(PREFETCH_HIT_COUNT);
+    s.set_value(prefetch_hit_count);
+    statistics.push_back(s);
+
+    s.set_key(CACHE_HIT_READ_COUNT);
+    s.set_value(cache_hit_read_count);
+    statistics.push_back(s);
+
+    s.set_key(CACHE_EVICTION_COUNT);
+    s.set_value(eviction_count);
+    statistics.push_back(s);
+
+    {
+        scoped_lock<mutex> lock(cache_mutex);
+
+        uint64_t resident_bytes = 0;
+        for (const auto& [_, chunk] : chunks) {
+            resident_bytes += chunk->data.size();
+        }
+        s.set_key(CACHE_RESIDENT_BYTES);
+        s.set_value(resident_bytes);
+        statistics.push_back(s);
+    }
+
+    s.set_key(SERVED_READ_BYTE_COUNT);
+    s.set_value(served_read_byte_count);
+    statistics.push_back(s);
+
+    s.set_category(PbStatisticsCategory::CATEGORY_ERROR);
+
+    s.set_key(READ_ERROR_COUNT);
+    s.set_value(read_error_count);
+    statistics.push_back(s);
+
+    return statistics;
+}
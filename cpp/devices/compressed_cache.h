@@ -0,0 +1,117 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// A read-only cache for images compressed with dictzip. The gzip compatible dictzip format consists of
+// fixed-size chunks, which are compressed independently, and an index with the compressed chunk sizes.
+// Recently decompressed chunks are kept in memory, during sequential reads the following chunks are
+// decompressed on a background thread.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "cache.h"
+#include "prefetcher.h"
+
+class CompressedCache : public Cache
+{
+
+public:
+
+    CompressedCache(const string &f, int size, uint64_t s) : filename(f), sector_size(size), sectors(s)
+    {
+    }
+    ~CompressedCache() override;
+
+    int ReadSectors(data_in_t, uint64_t, uint32_t) override;
+    int WriteSectors(data_out_t, uint64_t, uint32_t) override
+    {
+        // Compressed images are always read-only
+        return 0;
+    }
+
+    bool Init() override;
+
+    bool Flush() override
+    {
+        return true;
+    }
+
+    vector<PbStatistics> GetStatistics(bool) const override;
+
+    // The uncompressed image size, -1 if the file is not a valid compressed image
+    static off_t GetImageSize(const string&);
+
+    static bool IsCompressed(const string&);
+
+    // The number of decompressed chunks kept in memory
+    static constexpr int DEFAULT_CHUNKS = 32;
+
+private:
+
+    struct Chunk
+    {
+        vector<uint8_t> data;
+        bool is_prefetched;
+    };
+
+    bool Open();
+    bool ReadIndex();
+
+    shared_ptr<Chunk> GetChunk(uint32_t, bool);
+    bool Decompress(uint32_t, vector<uint8_t>&);
+
+    void Prefetch(uint64_t, uint64_t);
+
+    string filename;
+
+    int fd = -1;
+
+    int sector_size;
+
+    uint64_t sectors;
+
+    // The uncompressed chunk size
+    uint32_t chunk_length = 0;
+
+    // The file offsets of the compressed chunks, the last entry is the end of the compressed data
+    vector<off_t> chunk_offsets;
+
+    uint64_t image_size = 0;
+
+    // The decompressed chunks, the most recently used chunk first
+    list<pair<uint32_t, shared_ptr<Chunk>>> chunks;
+    unordered_map<uint32_t, list<pair<uint32_t, shared_ptr<Chunk>>>::iterator> chunk_index;
+
+    // Guards the decompressed chunks against concurrent access by the prefetcher
+    mutable mutex cache_mutex;
+
+    unique_ptr<Prefetcher> prefetcher;
+
+    uint64_t cache_miss_read_count = 0;
+    uint64_t cache_hit_read_count = 0;
+    uint64_t eviction_count = 0;
+    uint64_t served_read_byte_count = 0;
+    uint64_t prefetch_hit_count = 0;
+    uint64_t read_error_count = 0;
+
+    // The number of chunks to decompress ahead of sequential reads
+    static constexpr int PREFETCH_CHUNKS = 4;
+
+    static constexpr int GZIP_HEADER_SIZE = 10;
+
+    // gzip header flags
+    static constexpr uint8_t FHCRC = 0x02;
+    static constexpr uint8_t FEXTRA = 0x04;
+    static constexpr uint8_t FNAME = 0x08;
+    static constexpr uint8_t FCOMMENT = 0x10;
+
+    // The header including the index, a file name and a comment must fit into this buffer
+    static constexpr int MAX_HEADER_SIZE = 128 * 1024;
+};
@@ -0,0 +1,370 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "dedup_cache.h"
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "shared/memory_util.h"
+#include "shared/s2p_util.h"
+
+using namespace filesystem;
+using namespace memory_util;
+using namespace s2p_util;
+
+DedupCache::~DedupCache()
+{
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+bool DedupCache::Init()
+{
+    if (!sector_size || !sectors || BlockStore::BLOCK_SIZE % sector_size || fd != -1 || !Open(true)) {
+        return false;
+    }
+
+    return static_cast<uint64_t>(image_size) >= sectors * sector_size;
+}
+
+bool DedupCache::Open(bool open_store)
+{
+    is_writable = true;
+    fd = open(manifest.c_str(), O_RDWR);
+    if (fd == -1) {
+        // Read-only manifests can still be read
+        is_writable = false;
+        fd = open(manifest.c_str(), O_RDONLY);
+    }
+
+    vector<uint8_t> header(HEADER_SIZE);
+    if (fd == -1 || pread(fd, header.data(), header.size(), 0) != HEADER_SIZE
+        || memcmp(header.data(), MAGIC, sizeof(MAGIC)) || GetInt32(header, 8) != VERSION
+        || GetInt32(header, 12) != BlockStore::BLOCK_SIZE) {
+        return false;
+    }
+
+    image_size = static_cast<off_t>(GetInt64(header, 16));
+    store_folder = reinterpret_cast<const char*>(header.data() + STORE_FOLDER_OFFSET);
+    if (image_size <= 0 || store_folder.empty()) {
+        return false;
+    }
+
+    hashes.resize((image_size + BlockStore::BLOCK_SIZE - 1) / BlockStore::BLOCK_SIZE);
+    const auto length = static_cast<ssize_t>(hashes.size() * sizeof(BlockStore::block_hash));
+    if (pread(fd, hashes.data(), length, HEADER_SIZE) != length) {
+        return false;
+    }
+
+    if (open_store) {
+        store = BlockStore::GetStore(store_folder);
+    }
+
+    return !open_store || store;
+}
+
+int DedupCache::ReadSectors(data_in_t buf, uint64_t start, uint32_t count)
+{
+    if (fd == -1 || sectors < start + count) {
+        return 0;
+    }
+
+    const uint64_t length = static_cast<uint64_t>(count) * sector_size;
+    uint64_t position = start * sector_size;
+
+    vector<uint8_t> block;
+
+    for (uint64_t offset = 0; offset < length;) {
+        const uint64_t block_offset = position % BlockStore::BLOCK_SIZE;
+        const uint64_t n = min(length - offset, BlockStore::BLOCK_SIZE - block_offset);
+
+        // Complete blocks do not require an intermediate buffer
+        if (n == BlockStore::BLOCK_SIZE) {
+            if (!ReadBlock(position / BlockStore::BLOCK_SIZE, buf.subspan(offset, n))) {
+                return 0;
+            }
+        }
+        else {
+            block.resize(BlockStore::BLOCK_SIZE);
+            if (!ReadBlock(position / BlockStore::BLOCK_SIZE, block)) {
+                return 0;
+            }
+            memcpy(buf.data() + offset, block.data() + block_offset, n);
+        }
+
+        offset += n;
+        position += n;
+    }
+
+    return static_cast<int>(length);
+}
+
+int DedupCache::WriteSectors(data_out_t buf, uint64_t start, uint32_t count)
+{
+    if (!is_writable || sectors < start + count) {
+        return 0;
+    }
+
+    const uint64_t length = static_cast<uint64_t>(count) * sector_size;
+    uint64_t position = start * sector_size;
+
+    vector<uint8_t> block;
+
+    for (uint64_t offset = 0; offset < length;) {
+        const uint64_t block_offset = position % BlockStore::BLOCK_SIZE;
+        const uint64_t n = min(length - offset, BlockStore::BLOCK_SIZE - block_offset);
+
+        if (n == BlockStore::BLOCK_SIZE) {
+            if (!WriteBlock(position / BlockStore::BLOCK_SIZE, buf.subspan(offset, n))) {
+                return 0;
+            }
+        }
+        else {
+            // The sectors of the block not written by this command have to be preserved
+            block.resize(BlockStore::BLOCK_SIZE);
+            if (!ReadBlock(position / BlockStore::BLOCK_SIZE, block)) {
+                return 0;
+            }
+            memcpy(block.data() + block_offset, buf.data() + offset, n);
+            if (!WriteBlock(position / BlockStore::BLOCK_SIZE, block)) {
+                return 0;
+            }
+        }
+
+        offset += n;
+        position += n;
+    }
+
+    return static_cast<int>(length);
+}
+
+bool DedupCache::ReadBlock(uint64_t block, span<uint8_t> buf)
+{
+    if (!store->ReadBlock(hashes[block], buf)) {
+        ++read_error_count;
+        return false;
+    }
+
+    return true;
+}
+
+bool DedupCache::WriteBlock(uint64_t block, span<const uint8_t> buf)
+{
+    BlockStore::block_hash hash;
+    if (!store->WriteBlock(buf, hash)) {
+        ++write_error_count;
+        return false;
+    }
+
+    // Only the manifest entry changes, the previous block remains in the store for other images
+    if (hash != hashes[block]) {
+        if (pwrite(fd, hash.data(), hash.size(), HEADER_SIZE + static_cast<off_t>(block * hash.size()))
+            != static_cast<ssize_t>(hash.size())) {
+            ++write_error_count;
+            return false;
+        }
+
+        hashes[block] = hash;
+    }
+
+    return true;
+}
+
+bool DedupCache::Flush()
+{
+    if (!is_writable || (store->Flush() && fsync(fd) != -1)) {
+        return true;
+    }
+
+    ++write_error_count;
+
+    return false;
+}
+
+off_t DedupCache::GetImageSize(const string &manifest)
+{
+    DedupCache cache(manifest, 0, 0);
+
+    return cache.Open(false) ? cache.image_size : -1;
+}
+
+bool DedupCache::IsManifest(const string &filename)
+{
+    return GetExtensionLowerCase(filename) == "dedup";
+}
+
+string DedupCache::Create(const string &manifest, const string &store_folder, off_t size)
+{
+    return WriteManifest(manifest, store_folder, size, [](uint64_t, span<uint8_t> buf) {
+        ranges::fill(buf, 0);
+        return true;
+    });
+}
+
+string DedupCache::Import(const string &image, const string &manifest, const string &store_folder)
+{
+    const int image_fd = open(image.c_str(), O_RDONLY);
+    struct stat st;
+    if (image_fd == -1 || fstat(image_fd, &st) || !st.st_size) {
+        if (image_fd != -1) {
+            close(image_fd);
+        }
+        return "Can't read image file '" + image + "'";
+    }
+
+    const string &error = WriteManifest(manifest, store_folder, st.st_size,
+        [image_fd, &st](uint64_t block, span<uint8_t> buf) {
+            const off_t offset = static_cast<off_t>(block) * BlockStore::BLOCK_SIZE;
+            const auto length = static_cast<ssize_t>(min(static_cast<off_t>(buf.size()), st.st_size - offset));
+
+            // The last block is padded with zeros
+            ranges::fill(buf.subspan(length), 0);
+
+            return pread(image_fd, buf.data(), length, offset) == length;
+        });
+
+    close(image_fd);
+
+    return error;
+}
+
+string DedupCache::Export(const string &manifest, const string &image)
+{
+    DedupCache cache(manifest, 0, 0);
+    if (!cache.Open(true)) {
+        return "Can't read manifest '" + manifest + "'";
+    }
+
+    const int image_fd = open(image.c_str(), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    if (image_fd == -1) {
+        return "Can't create image file '" + image + "'";
+    }
+
+    vector<uint8_t> buf(BlockStore::BLOCK_SIZE);
+    for (uint64_t block = 0; block < cache.hashes.size(); ++block) {
+        const off_t offset = static_cast<off_t>(block) * BlockStore::BLOCK_SIZE;
+        const auto length = static_cast<ssize_t>(min(static_cast<off_t>(buf.size()), cache.image_size - offset));
+        if (!cache.ReadBlock(block, buf) || pwrite(image_fd, buf.data(), length, offset) != length) {
+            close(image_fd);
+            unlink(image.c_str());
+            return "Can't write image file '" + image + "'";
+        }
+    }
+
+    close(image_fd);
+
+    return "";
+}
+
+string DedupCache::WriteManifest(const string &manifest, const string &store_folder, off_t size,
+    const function<bool(uint64_t, span<uint8_t>)> &read_block)
+{
+    if (store_folder.empty() || store_folder.size() >= HEADER_SIZE - STORE_FOLDER_OFFSET) {
+        return "Invalid block store folder '" + store_folder + "'";
+    }
+
+    const auto &store = BlockStore::GetStore(store_folder);
+    if (!store) {
+        return "Can't access block store '" + store_folder + "'";
+    }
+
+    vector<uint8_t> header(HEADER_SIZE);
+    memcpy(header.data(), MAGIC, sizeof(MAGIC));
+    SetInt32(header, 8, VERSION);
+    SetInt32(header, 12, BlockStore::BLOCK_SIZE);
+    SetInt64(header, 16, size);
+    memcpy(header.data() + STORE_FOLDER_OFFSET, store_folder.data(), store_folder.size());
+
+    const int manifest_fd = open(manifest.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+        S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    if (manifest_fd == -1) {
+        return "Can't create manifest '" + manifest + "'";
+    }
+
+    bool success = pwrite(manifest_fd, header.data(), header.size(), 0) == HEADER_SIZE;
+
+    vector<uint8_t> buf(BlockStore::BLOCK_SIZE);
+    vector<BlockStore::block_hash> hashes;
+    BlockStore::block_hash zero_hash = { };
+    bool has_zero_hash = false;
+    const auto blocks = static_cast<uint64_t>((size + BlockStore::BLOCK_SIZE - 1) / BlockStore::BLOCK_SIZE);
+    for (uint64_t block = 0; success && block < blocks; ++block) {
+        if (!read_block(block, buf)) {
+            success = false;
+            break;
+        }
+
+        // Hashing the frequent blocks with zeros only once saves time
+        BlockStore::block_hash hash;
+        if (has_zero_hash && IsZero(buf)) {
+            hash = zero_hash;
+        }
+        else {
+            success = store->WriteBlock(buf, hash);
+            if (!has_zero_hash && IsZero(buf)) {
+                zero_hash = hash;
+                has_zero_hash = true;
+            }
+        }
+        hashes.push_back(hash);
+
+        // Write the hashes in batches of one block
+        if (hashes.size() == BlockStore::BLOCK_SIZE / sizeof(BlockStore::block_hash) || block == blocks - 1) {
+            const auto length = static_cast<ssize_t>(hashes.size() * sizeof(BlockStore::block_hash));
+            success &= pwrite(manifest_fd, hashes.data(), length,
+                HEADER_SIZE + static_cast<off_t>((block + 1 - hashes.size()) * sizeof(BlockStore::block_hash)))
+                == length;
+            hashes.clear();
+        }
+    }
+
+    success &= store->Flush() && fsync(manifest_fd) != -1;
+
+    close(manifest_fd);
+
+    if (!success) {
+        unlink(manifest.c_str());
+        return "Can't write manifest '" + manifest + "'";
+    }
+
+    return "";
+}
+
+vector<PbStatistics> DedupCache::GetStatistics(bool is_read_only) const
+{
+    vector<PbStatistics> statistics;
+
+    PbStatistics s;
+
+    s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+    // The block store and its cache are shared by all devices using the store
+    s.set_key(STORE_BLOCK_COUNT);
+    s.set_value(store->GetBlockCount());
+    statistics.push_back(s);
+
+    s.set_key(CACHE_MISS_READ_COUNT);
+    s.set_value(store->GetCacheMissCount());
+    statistics.push_back(s);
+
+    s.set_category(PbStatisticsCategory::CATEGORY_ERROR);
+
+    s.set_key(READ_ERROR_COUNT);
+    s.set_value(read_error_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(WRITE_ERROR_COUNT);
+        s.set_value(write_error_count);
+        statistics.push_back(s);
+    }
+
+    return statistics;
+}
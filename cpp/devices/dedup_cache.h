@@ -0,0 +1,89 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// A cache for deduplicated images. The image file is a manifest with a header, which contains the path of the
+// block store, followed by the hashes of the image blocks. The block contents are stored in a block store,
+// which can be shared by any number of images. Copying an image only requires copying the manifest.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <functional>
+#include "cache.h"
+#include "block_store.h"
+
+class DedupCache : public Cache
+{
+
+public:
+
+    DedupCache(const string &m, int size, uint64_t s) : manifest(m), sector_size(size), sectors(s)
+    {
+    }
+    ~DedupCache() override;
+
+    int ReadSectors(data_in_t, uint64_t, uint32_t) override;
+    int WriteSectors(data_out_t, uint64_t, uint32_t) override;
+
+    bool Init() override;
+
+    bool Flush() override;
+
+    vector<PbStatistics> GetStatistics(bool) const override;
+
+    // The image size, -1 if the file is not a valid manifest
+    static off_t GetImageSize(const string&);
+
+    static bool IsManifest(const string&);
+
+    // Creates a manifest for an image with zeros only
+    static string Create(const string&, const string&, off_t);
+    // Creates a manifest for the contents of an image file
+    static string Import(const string&, const string&, const string&);
+    // Creates an image file with the contents of a deduplicated image
+    static string Export(const string&, const string&);
+
+private:
+
+    bool Open(bool);
+
+    bool ReadBlock(uint64_t, span<uint8_t>);
+    bool WriteBlock(uint64_t, span<const uint8_t>);
+
+    static string WriteManifest(const string&, const string&, off_t, const function<bool(uint64_t, span<uint8_t>)>&);
+
+    string manifest;
+
+    int fd = -1;
+
+    int sector_size;
+
+    uint64_t sectors;
+
+    off_t image_size = 0;
+
+    string store_folder;
+
+    shared_ptr<BlockStore> store;
+
+    // The hashes of the image blocks
+    vector<BlockStore::block_hash> hashes;
+
+    bool is_writable = false;
+
+    uint64_t read_error_count = 0;
+    uint64_t write_error_count = 0;
+
+    static constexpr const char *STORE_BLOCK_COUNT = "store_block_count";
+
+    static constexpr char MAGIC[] = "S2PDDP1";
+    static constexpr uint32_t VERSION = 1;
+
+    // The block store path is part of the header, the hashes start at the end of the header
+    static constexpr int HEADER_SIZE = 4096;
+    static constexpr int STORE_FOLDER_OFFSET = 32;
+};
@@ -13,10 +13,17 @@
 //---------------------------------------------------------------------------
 
 #include "disk.h"
+#include "compressed_cache.h"
+#include "dedup_cache.h"
 #include "disk_cache.h"
 #include "linux_cache.h"
+#include "mmap_cache.h"
+#include "overlay_cache.h"
+#include "uring_cache.h"
+#include "controllers/buffer_pool.h"
 #include "shared/s2p_exceptions.h"
 
+using namespace filesystem;
 using namespace spdlog;
 using namespace memory_util;
 using namespace s2p_util;
@@ -26,6 +33,12 @@ Disk::Disk(PbDeviceType type, int lun, bool supports_mode_select, bool supports_
 : StorageDevice(type, lun, supports_mode_select, supports_save_parameters, s)
 {
     SetStoppable(true);
+    SupportsParams(true);
+}
+
+Disk::~Disk()
+{
+    ReleaseCache();
 }
 
 string Disk::SetUp()
@@ -92,12 +105,12 @@ string Disk::SetUp()
         });
     AddCommand(ScsiCommand::SYNCHRONIZE_CACHE_10, [this]
         {
-            FlushCache();
+            SynchronizeCache();
             StatusPhase();
         });
     AddCommand(ScsiCommand::SYNCHRONIZE_CACHE_SPACE_16, [this]
         {
-            FlushCache();
+            SynchronizeCache();
             StatusPhase();
         });
     AddCommand(ScsiCommand::READ_DEFECT_DATA_10, [this]
@@ -125,6 +138,22 @@ string Disk::SetUp()
             ReadFormatCapacities();
         });
 
+    // Devices with read-only media (SCCD) do not support the logical block provisioning commands
+    if (!IsReadOnly()) {
+        AddCommand(ScsiCommand::WRITE_SAME_10, [this]
+            {
+                WriteSame(false);
+            });
+        AddCommand(ScsiCommand::ERASE_WRITE_SAME_16, [this]
+            {
+                WriteSame(true);
+            });
+        AddCommand(ScsiCommand::READ_SUB_CHANNEL_UNMAP, [this]
+            {
+                Unmap();
+            });
+    }
+
     return StorageDevice::SetUp();
 }
 
@@ -152,35 +181,286 @@ bool Disk::SetUpCache()
 {
     assert(caching_mode != PbCachingMode::DEFAULT);
 
+    ParseCacheParams();
+
+    // With AUTO the caching mode is selected at runtime, starting with the PiSCSI compatible cache
+    if (caching_mode == PbCachingMode::AUTO) {
+        caching_mode = PbCachingMode::PISCSI;
+        caching_mode_selector = make_unique<CachingModeSelector>(caching_mode);
+    }
+
     if (!GetSupportedBlockSizes().contains(GetBlockSize())) {
         warn("Using non-standard sector size of {} bytes", GetBlockSize());
-        if (caching_mode == PbCachingMode::PISCSI) {
+        // The PiSCSI compatible cache must not be selected at runtime
+        caching_mode_selector.reset();
+        if (caching_mode == PbCachingMode::PISCSI || caching_mode == PbCachingMode::DIRECT_IO) {
             caching_mode = PbCachingMode::LINUX;
             // LogInfo() does not work here because at initialization time the device ID is not yet set
             info("Switched caching mode to '{}'", PbCachingMode_Name(caching_mode));
         }
     }
 
+    if (caching_mode == PbCachingMode::IO_URING && !UringCache::IsAvailable()) {
+        warn("The kernel does not support io_uring");
+        caching_mode = PbCachingMode::LINUX_OPTIMIZED;
+        info("Switched caching mode to '{}'", PbCachingMode_Name(caching_mode));
+    }
+
+    if (const string &base = GetBaseImage(); !base.empty()) {
+        if (error_code error; equivalent(base, GetFilename(), error)) {
+            throw IoException(fmt::format("Base image '{}' can't be used as delta file", base));
+        }
+    }
+
     return InitCache(GetFilename());
 }
 
+void Disk::UpdateCachingMode(uint64_t start, uint32_t count)
+{
+    // The caching mode does not matter for image containers
+    if (!caching_mode_selector || IsImageContainer()) {
+        return;
+    }
+
+    const PbCachingMode mode = caching_mode_selector->Update(start, count, GetBlockSize());
+    if (mode == caching_mode) {
+        return;
+    }
+
+    // The modified data must have been written before the cache is replaced, otherwise there is a new attempt
+    // with the next command
+    if (!cache->Flush()) {
+        return;
+    }
+
+    const PbCachingMode previous_mode = caching_mode;
+    caching_mode = mode;
+    if (!InitCache(GetFilename())) {
+        LogWarn(fmt::format("Can't switch caching mode to '{}'", PbCachingMode_Name(caching_mode)));
+        caching_mode = previous_mode;
+        caching_mode_selector.reset();
+        if (!InitCache(GetFilename())) {
+            throw ScsiException(SenseKey::HARDWARE_ERROR, Asc::INTERNAL_TARGET_FAILURE);
+        }
+        return;
+    }
+
+    ++caching_mode_switch_count;
+
+    LogDebug(fmt::format("Switched caching mode to '{}'", PbCachingMode_Name(caching_mode)));
+}
+
+void Disk::ParseCacheParams()
+{
+    const string &tracks = GetParam(CACHE_TRACKS);
+    cache_tracks = tracks.empty() ? DiskCache::DEFAULT_TRACKS : ParseAsUnsignedInt(tracks);
+    if (cache_tracks <= 0) {
+        throw IoException(fmt::format("Invalid number of cache tracks: '{}'", tracks));
+    }
+
+    const string &sectors = GetParam(TRACK_SECTORS);
+    track_sectors = sectors.empty() ? DiskCache::DEFAULT_TRACK_SECTORS : ParseAsUnsignedInt(sectors);
+    if (track_sectors <= 0 || track_sectors > 65536 || (track_sectors & (track_sectors - 1))) {
+        throw IoException(fmt::format("Invalid number of sectors per track: '{}', must be a power of 2", sectors));
+    }
+
+    const string &age = GetParam(FLUSH_AGE);
+    flush_age = age.empty() ? DiskCache::DEFAULT_FLUSH_AGE : ParseAsUnsignedInt(age);
+    if (flush_age < 0) {
+        throw IoException(fmt::format("Invalid write-back age: '{}'", age));
+    }
+
+    // The threshold is configured in KiB
+    const string &threshold = GetParam(FLUSH_THRESHOLD);
+    const int kib = threshold.empty() ?
+        static_cast<int>(DiskCache::DEFAULT_FLUSH_THRESHOLD / 1024) : ParseAsUnsignedInt(threshold);
+    if (kib < 0) {
+        throw IoException(fmt::format("Invalid write-back threshold: '{}'", threshold));
+    }
+    flush_threshold = static_cast<uint64_t>(kib) * 1024;
+}
+
 bool Disk::InitCache(const string &path)
 {
-    if (caching_mode == PbCachingMode::PISCSI) {
-        cache = make_shared<DiskCache>(path, GetBlockSize(), GetBlockCount());
+    ReleaseCache();
+
+    // An overlay does not depend on the caching mode, the kernel caches the data of the shared base image
+    if (const string &base = GetBaseImage(); !base.empty()) {
+        cache = make_shared<OverlayCache>(path, base, GetBlockSize(), GetBlockCount());
+        return cache->Init();
+    }
+
+    // Compressed images are always read-only and do not depend on the caching mode
+    if (CompressedCache::IsCompressed(path)) {
+        cache = make_shared<CompressedCache>(path, GetBlockSize(), GetBlockCount());
+        return cache->Init();
+    }
+
+    // The blocks of a deduplicated image are cached by the block store shared by all devices
+    if (DedupCache::IsManifest(path)) {
+        cache = make_shared<DedupCache>(path, GetBlockSize(), GetBlockCount());
+        return cache->Init();
+    }
+
+    // With direct I/O the PiSCSI compatible cache is the only cache
+    if (caching_mode == PbCachingMode::PISCSI || caching_mode == PbCachingMode::DIRECT_IO) {
+        if (!cache_tracks) {
+            ParseCacheParams();
+        }
+
+        auto disk_cache = make_shared<DiskCache>(path, GetBlockSize(), GetBlockCount(), cache_tracks, track_sectors);
+        disk_cache->SetWriteBack(flush_age, flush_threshold);
+        disk_cache->SetDirectIo(caching_mode == PbCachingMode::DIRECT_IO);
+        cache = disk_cache;
+
+        track_caching_disks.insert(this);
+        DistributeCacheMemory();
+    }
+    else if (caching_mode == PbCachingMode::IO_URING) {
+        cache = make_shared<UringCache>(path, GetBlockSize(), GetBlockCount());
+    }
+    else if (caching_mode == PbCachingMode::MMAP) {
+        cache = make_shared<MmapCache>(path, GetBlockSize(), GetBlockCount());
     }
     else {
         cache = make_shared<LinuxCache>(path, GetBlockSize(), GetBlockCount(),
             caching_mode == PbCachingMode::WRITE_THROUGH);
     }
 
-    return cache->Init();
+    if (cache->Init()) {
+        return true;
+    }
+
+    // Large image files may not fit into the address space
+    if (caching_mode == PbCachingMode::MMAP) {
+        warn("Can't map image file '{}'", path);
+        caching_mode = PbCachingMode::LINUX_OPTIMIZED;
+        info("Switched caching mode to '{}'", PbCachingMode_Name(caching_mode));
+        return InitCache(path);
+    }
+
+    return false;
+}
+
+string Disk::GetBaseImage() const
+{
+    const string &base = GetParam(BASE_IMAGE);
+    if (base.empty()) {
+        return "";
+    }
+
+    // A relative path is relative to the folder of the delta file
+    const path p(base);
+    return p.is_relative() ? (path(GetFilename()).parent_path() / p).string() : base;
+}
+
+off_t Disk::GetFileSize(bool ignore_error) const
+{
+    // With an overlay the base image defines the capacity
+    if (const string &base = GetBaseImage(); !base.empty()) {
+        try {
+            return file_size(base);
+        }
+        catch (const filesystem_error &e) {
+            if (ignore_error) {
+                return 0;
+            }
+
+            throw IoException("Can't get size of base image '" + base + "': " + e.what());
+        }
+    }
+
+    // With a compressed image the uncompressed data define the capacity
+    if (CompressedCache::IsCompressed(GetFilename())) {
+        if (const off_t size = CompressedCache::GetImageSize(GetFilename()); size != -1 || ignore_error) {
+            return max(size, static_cast<off_t>(0));
+        }
+
+        throw IoException("Can't get size of compressed image file '" + GetFilename() + "'");
+    }
+
+    // With a deduplicated image the manifest defines the capacity
+    if (DedupCache::IsManifest(GetFilename())) {
+        if (const off_t size = DedupCache::GetImageSize(GetFilename()); size != -1 || ignore_error) {
+            return max(size, static_cast<off_t>(0));
+        }
+
+        throw IoException("Can't get size of deduplicated image file '" + GetFilename() + "'");
+    }
+
+    return StorageDevice::GetFileSize(ignore_error);
+}
+
+bool Disk::IsImageContainer() const
+{
+    return !GetParam(BASE_IMAGE).empty() || CompressedCache::IsCompressed(GetFilename())
+        || DedupCache::IsManifest(GetFilename());
+}
+
+bool Disk::IsReadOnlyFile() const
+{
+    return CompressedCache::IsCompressed(GetFilename()) || StorageDevice::IsReadOnlyFile();
+}
+
+void Disk::ReleaseCache()
+{
+    cache.reset();
+
+    // The memory of this cache is now available for the other caches
+    if (track_caching_disks.erase(this)) {
+        DistributeCacheMemory();
+    }
+}
+
+void Disk::SetCacheMemory(uint64_t memory)
+{
+    cache_memory = memory;
+
+    DistributeCacheMemory();
+}
+
+void Disk::DistributeCacheMemory()
+{
+    // Without a memory budget each cache uses the configured number of tracks
+    if (!cache_memory || track_caching_disks.empty()) {
+        return;
+    }
+
+    // The budget is distributed in proportion to the configured number of tracks
+    uint64_t total_tracks = 0;
+    for (const Disk *disk : track_caching_disks) {
+        total_tracks += disk->cache_tracks;
+    }
+
+    for (const Disk *disk : track_caching_disks) {
+        const auto disk_cache = static_pointer_cast<DiskCache>(disk->cache);
+        const uint64_t track_size = disk_cache->GetTrackSize();
+        // There is no need for caching more tracks than the image file has
+        const uint64_t image_tracks = (disk->GetBlockCount() * disk->GetBlockSize() + track_size - 1) / track_size;
+        const uint64_t tracks = cache_memory / total_tracks * disk->cache_tracks / track_size;
+        disk_cache->SetMaxTracks(
+            static_cast<int>(clamp(tracks, static_cast<uint64_t>(1), max(image_tracks, static_cast<uint64_t>(1)))));
+    }
 }
 
 void Disk::FlushCache()
 {
     if (cache && IsReady()) {
+        const auto start = chrono::steady_clock::now();
         cache->Flush();
+        flush_latency.Record(start);
+    }
+}
+
+// In contrast to FlushCache() the data are durable afterwards, i.e. the image file is synced
+void Disk::SynchronizeCache()
+{
+    if (cache && IsReady()) {
+        const auto start = chrono::steady_clock::now();
+        if (!cache->Sync()) {
+            throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::WRITE_FAULT);
+        }
+        flush_latency.Record(start);
     }
 }
 
@@ -200,13 +480,16 @@ void Disk::Read(AccessMode mode)
 {
     const auto& [valid, start, count] = CheckAndGetStartAndCount(mode);
     if (valid) {
+        UpdateCachingMode(start, count);
+
         next_sector = start;
+        end_sector = start + count;
 
-        sector_transfer_count = caching_mode == PbCachingMode::LINUX_OPTIMIZED ? count : 1;
+        sector_transfer_count = GetSectorTransferCount(count);
 
         GetController()->SetTransferSize(count * GetBlockSize(), sector_transfer_count * GetBlockSize());
 
-        GetController()->SetCurrentLength(count * GetBlockSize());
+        GetController()->SetCurrentLength(sector_transfer_count * GetBlockSize());
         DataInPhase(ReadData(GetController()->GetBuffer()));
     }
     else {
@@ -219,6 +502,10 @@ void Disk::Write(AccessMode mode)
     CheckWritePreconditions();
 
     const auto& [valid, start, count] = CheckAndGetStartAndCount(mode);
+    if (valid) {
+        UpdateCachingMode(start, count);
+    }
+
     WriteVerify(start, count, valid);
 }
 
@@ -237,8 +524,9 @@ void Disk::WriteVerify(uint64_t start, uint32_t count, bool data_out)
 {
     if (data_out) {
         next_sector = start;
+        end_sector = start + count;
 
-        sector_transfer_count = caching_mode == PbCachingMode::LINUX_OPTIMIZED ? count : 1;
+        sector_transfer_count = GetSectorTransferCount(count);
 
         GetController()->SetTransferSize(count * GetBlockSize(), sector_transfer_count * GetBlockSize());
 
@@ -249,6 +537,154 @@ void Disk::WriteVerify(uint64_t start, uint32_t count, bool data_out)
     }
 }
 
+void Disk::WriteSame(bool is_16)
+{
+    CheckReady();
+    CheckWritePreconditions();
+
+    // PBDATA and LBDATA are not supported, ANCHOR is not relevant
+    if (GetCdbByte(1) & 0x06) {
+        throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::INVALID_FIELD_IN_CDB);
+    }
+
+    const auto& [start, count] = GetWriteSameRange(is_16);
+
+    // With NDOB there is no data, the sectors are zeroed
+    if (is_16 && (GetCdbByte(1) & 0x01)) {
+        ZeroSectors(start, count, GetCdbByte(1) & 0x08);
+        StatusPhase();
+        return;
+    }
+
+    // The sector data are processed by WriteData()
+    GetController()->SetTransferSize(GetBlockSize(), GetBlockSize());
+    DataOutPhase(GetBlockSize());
+}
+
+void Disk::WriteSame(data_out_t data, bool is_16)
+{
+    const auto& [start, count] = GetWriteSameRange(is_16);
+
+    // Zeros do not have to be written, which is what initiators typically use WRITE SAME for
+    if (Cache::IsZero(data)) {
+        ZeroSectors(start, count, GetCdbByte(1) & 0x08);
+        return;
+    }
+
+    vector<uint8_t> buf(min(count, static_cast<uint64_t>(MAX_WRITE_SAME_SECTORS)) * GetBlockSize());
+    for (size_t offset = 0; offset < buf.size(); offset += GetBlockSize()) {
+        ranges::copy(data, buf.begin() + offset);
+    }
+
+    WriteSectors(buf, start, count);
+}
+
+void Disk::Unmap()
+{
+    CheckReady();
+    CheckWritePreconditions();
+
+    // ANCHOR is not supported
+    if (GetCdbByte(1) & 0x01) {
+        throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::INVALID_FIELD_IN_CDB);
+    }
+
+    // The parameter list is processed by WriteData()
+    if (const int length = GetCdbInt16(7); length) {
+        GetController()->SetTransferSize(length, length);
+        DataOutPhase(length);
+    }
+    else {
+        StatusPhase();
+    }
+}
+
+void Disk::Unmap(data_out_t buf)
+{
+    if (buf.size() < 8) {
+        throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::PARAMETER_LIST_LENGTH_ERROR);
+    }
+
+    // Each block descriptor has 16 bytes, a truncated descriptor is ignored
+    const int descriptors_end = 8 + min(GetInt16(buf, 2), static_cast<int>(buf.size()) - 8) / 16 * 16;
+
+    // No sector is unmapped if any of the descriptors is invalid
+    for (int offset = 8; offset < descriptors_end; offset += 16) {
+        if (const uint64_t start = GetInt64(buf, offset); start + GetInt32(buf, offset + 8) > GetBlockCount()) {
+            throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::LBA_OUT_OF_RANGE);
+        }
+    }
+
+    for (int offset = 8; offset < descriptors_end; offset += 16) {
+        if (const uint32_t count = GetInt32(buf, offset + 8); count) {
+            ZeroSectors(GetInt64(buf, offset), count, true);
+        }
+    }
+}
+
+pair<uint64_t, uint64_t> Disk::GetWriteSameRange(bool is_16) const
+{
+    const uint64_t start = is_16 ? GetCdbInt64(2) : GetCdbInt32(2);
+    uint64_t count = is_16 ? GetCdbInt32(10) : GetCdbInt16(7);
+
+    if (start >= GetBlockCount() || start + count > GetBlockCount()) {
+        throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::LBA_OUT_OF_RANGE);
+    }
+
+    // 0 means all sectors up to the last one
+    if (!count) {
+        count = GetBlockCount() - start;
+    }
+
+    return {start, count};
+}
+
+void Disk::ZeroSectors(uint64_t start, uint64_t count, bool deallocate)
+{
+    CheckReady();
+
+    if (!cache->ZeroSectors(start, count, deallocate)) {
+        // Without cache support the zeros have to be written
+        WriteSectors(vector<uint8_t>(min(count, static_cast<uint64_t>(MAX_WRITE_SAME_SECTORS)) * GetBlockSize()),
+            start, count);
+    }
+    else {
+        UpdateWriteCount(count);
+    }
+}
+
+// Writes the same data to consecutive sectors, the buffer contains the data for one or more sectors
+void Disk::WriteSectors(data_out_t buf, uint64_t start, uint64_t count)
+{
+    CheckReady();
+
+    const auto sectors = static_cast<uint32_t>(buf.size() / GetBlockSize());
+    for (uint64_t sector = start; sector < start + count; sector += sectors) {
+        const auto n = static_cast<uint32_t>(min(static_cast<uint64_t>(sectors), start + count - sector));
+        const auto start_time = chrono::steady_clock::now();
+        if (!cache->WriteSectors(buf.first(n * GetBlockSize()), sector, n)) {
+            throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::WRITE_FAULT);
+        }
+        write_latency.Record(start_time);
+    }
+
+    UpdateWriteCount(count);
+}
+
+uint32_t Disk::GetSectorTransferCount(uint32_t count) const
+{
+    // Only these caching modes and image containers support transferring many sectors with a single cache access
+    if (!IsImageContainer() && caching_mode != PbCachingMode::PISCSI && caching_mode != PbCachingMode::LINUX_OPTIMIZED
+        && caching_mode != PbCachingMode::IO_URING && caching_mode != PbCachingMode::MMAP
+        && caching_mode != PbCachingMode::DIRECT_IO) {
+        return 1;
+    }
+
+    // Larger transfers are split into chunks of the maximum transfer size, so that reading or writing a chunk
+    // overlaps with transferring the previous or next one
+    return min(count, max(static_cast<uint32_t>(BufferPool::Instance().GetMaxTransferSize()) / GetBlockSize(), 1U));
+}
+
 void Disk::ReadWriteLong(uint64_t sector, uint32_t length, bool write)
 {
     if (write) {
@@ -267,11 +703,17 @@ void Disk::ReadWriteLong(uint64_t sector, uint32_t length, bool write)
         throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::INVALID_FIELD_IN_CDB);
     }
 
+    // An image container can't be accessed like an image file
+    if (IsImageContainer()) {
+        throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::INVALID_COMMAND_OPERATION_CODE);
+    }
+
     auto linux_cache = dynamic_pointer_cast<LinuxCache>(cache);
     if (!linux_cache) {
         // FUll READ/WRITE LONG support requires an appropriate caching mode
         FlushCache();
         caching_mode = PbCachingMode::LINUX;
+        caching_mode_selector.reset();
         InitCache(GetFilename());
         linux_cache = static_pointer_cast<LinuxCache>(cache);
         LogDebug(fmt::format("Switched caching mode to '{}'", PbCachingMode_Name(caching_mode)));
@@ -310,7 +752,7 @@ bool Disk::Eject(bool force)
 {
     const bool status = StorageDevice::Eject(force);
     if (status) {
-        cache.reset();
+        ReleaseCache();
     }
 
     return status;
@@ -383,25 +825,62 @@ void Disk::AddAppleVendorPage(map<int, vector<byte>> &pages, bool changeable) co
 
 int Disk::ReadData(data_in_t buf)
 {
-    assert(next_sector + sector_transfer_count <= GetBlockCount());
+    CheckReady();
+
+    GetController()->ReleaseBorrowedData();
+
+    // Cached sectors are sent without copying them to the buffer
+    const auto& [data, pin] = ReadChunk(buf);
+    if (pin) {
+        GetController()->SetBorrowedData(data, pin);
+    }
 
+    return static_cast<int>(data.size());
+}
+
+pair<data_out_t, shared_ptr<const void>> Disk::ReadAhead(data_in_t buf)
+{
     CheckReady();
 
-    if (!cache->ReadSectors(buf, static_cast<uint32_t>(next_sector), sector_transfer_count)) {
-        throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::READ_ERROR);
+    return ReadChunk(buf);
+}
+
+uint32_t Disk::GetChunkSectorCount() const
+{
+    // The last chunk of a command may be shorter
+    const auto count = static_cast<uint32_t>(min(static_cast<uint64_t>(sector_transfer_count), end_sector - next_sector));
+
+    assert(count && next_sector + count <= GetBlockCount());
+
+    return count;
+}
+
+pair<data_out_t, shared_ptr<const void>> Disk::ReadChunk(data_in_t buf)
+{
+    const uint32_t count = GetChunkSectorCount();
+
+    const auto start = chrono::steady_clock::now();
+
+    auto&& [data, pin] = cache->BorrowSectors(next_sector, count);
+    if (!pin) {
+        if (!cache->ReadSectors(buf, static_cast<uint32_t>(next_sector), count)) {
+            throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::READ_ERROR);
+        }
+
+        data = buf.first(GetBlockSize() * count);
     }
 
-    next_sector += sector_transfer_count;
+    read_latency.Record(start);
 
-    UpdateReadCount(sector_transfer_count);
+    next_sector += count;
 
-    return GetBlockSize() * sector_transfer_count;
+    UpdateReadCount(count);
+
+    return { data, pin };
 }
 
 int Disk::WriteData(cdb_t cdb, data_out_t buf, int, int l)
 {
-    assert(next_sector + sector_transfer_count <= GetBlockCount());
-
     CheckReady();
 
     const auto command = static_cast<ScsiCommand>(cdb[0]);
@@ -419,9 +898,22 @@ int Disk::WriteData(cdb_t cdb, data_out_t buf, int, int l)
         return l;
     }
 
-    if ((command != ScsiCommand::VERIFY_10 && command != ScsiCommand::VERIFY_16)
-        && !cache->WriteSectors(buf, static_cast<uint32_t>(next_sector), sector_transfer_count)) {
-        throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::WRITE_FAULT);
+    if (command == ScsiCommand::WRITE_SAME_10 || command == ScsiCommand::ERASE_WRITE_SAME_16) {
+        WriteSame(buf.first(GetBlockSize()), command == ScsiCommand::ERASE_WRITE_SAME_16);
+
+        return l;
+    }
+
+    if (command == ScsiCommand::READ_SUB_CHANNEL_UNMAP) {
+        Unmap(buf.first(l));
+
+        return l;
+    }
+
+    if (command != ScsiCommand::VERIFY_10 && command != ScsiCommand::VERIFY_16) {
+        WriteChunk(cdb, buf, GetController()->GetRemainingLength() <= l);
+
+        return l;
     }
 
     next_sector += sector_transfer_count;
@@ -431,6 +923,42 @@ int Disk::WriteData(cdb_t cdb, data_out_t buf, int, int l)
     return l;
 }
 
+bool Disk::IsWriteBehindSupported(cdb_t cdb) const
+{
+    // Only plain writes do not depend on the controller state
+    const auto command = static_cast<ScsiCommand>(cdb[0]);
+    return cache && (command == ScsiCommand::WRITE_6 || command == ScsiCommand::WRITE_10
+        || command == ScsiCommand::WRITE_16);
+}
+
+void Disk::WriteBehind(cdb_t cdb, data_out_t buf, bool last)
+{
+    CheckReady();
+
+    WriteChunk(cdb, buf, last);
+}
+
+void Disk::WriteChunk(cdb_t cdb, data_out_t buf, bool last)
+{
+    const uint32_t count = GetChunkSectorCount();
+
+    const auto start = chrono::steady_clock::now();
+    if (!cache->WriteSectors(buf, static_cast<uint32_t>(next_sector), count)) {
+        throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::WRITE_FAULT);
+    }
+    write_latency.Record(start);
+
+    // With FUA the data must be durable before the status is returned, which is after the last chunk
+    const auto command = static_cast<ScsiCommand>(cdb[0]);
+    if (last && (command == ScsiCommand::WRITE_10 || command == ScsiCommand::WRITE_16) && (cdb[1] & 0x08)) {
+        SynchronizeCache();
+    }
+
+    next_sector += count;
+
+    UpdateWriteCount(count);
+}
+
 void Disk::ReadCapacity10()
 {
     CheckReady();
@@ -462,6 +990,11 @@ void Disk::ReadCapacity16()
     SetInt64(buf, 0, GetBlockCount() - 1);
     SetInt32(buf, 8, GetBlockSize());
 
+    // LBPME and LBPRZ, unmapped sectors read as zeros
+    if (!IsReadOnly()) {
+        buf[14] = 0xc0;
+    }
+
     DataInPhase(min(32U, GetCdbInt32(10)));
 }
 
@@ -580,13 +1113,44 @@ tuple<bool, uint64_t, uint32_t> Disk::CheckAndGetStartAndCount(AccessMode mode)
     return tuple(count || mode == SEEK6 || mode == SEEK10, start, count);
 }
 
+param_map Disk::GetDefaultParams() const
+{
+    return {
+        {   CACHE_TRACKS, to_string(DiskCache::DEFAULT_TRACKS)},
+        {   TRACK_SECTORS, to_string(DiskCache::DEFAULT_TRACK_SECTORS)},
+        {   FLUSH_AGE, to_string(DiskCache::DEFAULT_FLUSH_AGE)},
+        {   FLUSH_THRESHOLD, to_string(DiskCache::DEFAULT_FLUSH_THRESHOLD / 1024)},
+        {   BASE_IMAGE, ""}
+    };
+}
+
 vector<PbStatistics> Disk::GetStatistics() const
 {
     vector<PbStatistics> statistics = StorageDevice::GetStatistics();
 
+    if (caching_mode_selector) {
+        PbStatistics s;
+        s.set_id(GetId());
+        s.set_unit(GetLun());
+
+        s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+        s.set_key(AUTO_CACHING_MODE);
+        s.set_value(caching_mode);
+        statistics.push_back(s);
+
+        s.set_key(CACHING_MODE_SWITCH_COUNT);
+        s.set_value(caching_mode_switch_count);
+        statistics.push_back(s);
+    }
+
     // Enrich cache statistics with device information before adding them to device statistics
     if (cache) {
-        for (auto &s : cache->GetStatistics(IsReadOnly())) {
+        vector<PbStatistics> cache_statistics = cache->GetStatistics(IsReadOnly());
+        read_latency.AddStatistics(cache_statistics, "read");
+        write_latency.AddStatistics(cache_statistics, "write");
+        flush_latency.AddStatistics(cache_statistics, "flush");
+        for (auto &s : cache_statistics) {
             s.set_id(GetId());
             s.set_unit(GetLun());
             statistics.push_back(s);
@@ -14,6 +14,9 @@
 #pragma once
 
 #include <tuple>
+#include <unordered_set>
+#include "caching_mode_selector.h"
+#include "latency_histogram.h"
 #include "storage_device.h"
 
 using namespace std;
@@ -25,7 +28,7 @@ class Disk : public StorageDevice
 
 public:
 
-    ~Disk() override = default;
+    ~Disk() override;
 
     string SetUp() override;
     void CleanUp() override;
@@ -36,18 +39,32 @@ public:
 
     int ReadData(data_in_t) override;
 
+    bool IsReadAheadSupported() const override
+    {
+        return cache != nullptr;
+    }
+    pair<data_out_t, shared_ptr<const void>> ReadAhead(data_in_t) override;
+
+    bool IsWriteBehindSupported(cdb_t) const override;
+    void WriteBehind(cdb_t, data_out_t, bool) override;
+
     PbCachingMode GetCachingMode() const
     {
-        return caching_mode;
+        return caching_mode_selector ? PbCachingMode::AUTO : caching_mode;
     }
     void SetCachingMode(PbCachingMode mode)
     {
         caching_mode = mode;
+        caching_mode_selector.reset();
     }
     void FlushCache() override;
 
     vector<PbStatistics> GetStatistics() const override;
 
+    param_map GetDefaultParams() const override;
+
+    static void SetCacheMemory(uint64_t);
+
 protected:
 
     Disk(PbDeviceType, int, bool, bool, const set<uint32_t>&);
@@ -61,11 +78,21 @@ protected:
 
     void ChangeBlockSize(uint32_t) override;
 
+    off_t GetFileSize(bool = false) const override;
+    bool IsReadOnlyFile() const override;
+
+    bool IsFuaSupported() const override
+    {
+        return !IsReadOnly();
+    }
+
     uint64_t GetNextSector() const
     {
         return next_sector;
     }
 
+    void UpdateCachingMode(uint64_t, uint32_t);
+
 private:
 
     enum AccessMode
@@ -83,23 +110,82 @@ private:
     void Read(AccessMode);
     void Write(AccessMode);
     void Verify(AccessMode);
+    void SynchronizeCache();
     void ReadCapacity16_ReadLong16();
 
     void AddVerifyErrorRecoveryPage(map<int, vector<byte>>&, bool) const;
     void AddCachingPage(map<int, vector<byte>>&, bool) const;
 
     bool SetUpCache();
+    void ParseCacheParams();
+    string GetBaseImage() const;
+    // Overlay delta files, compressed images and deduplication manifests are not plain image files
+    bool IsImageContainer() const;
+    void ReleaseCache();
+
+    static void DistributeCacheMemory();
 
     void ReadWriteLong(uint64_t, uint32_t, bool);
+    void WriteSame(bool);
+    void WriteSame(data_out_t, bool);
+    void Unmap();
+    void Unmap(data_out_t);
+    pair<uint64_t, uint64_t> GetWriteSameRange(bool) const;
+    void ZeroSectors(uint64_t, uint64_t, bool);
+    void WriteSectors(data_out_t, uint64_t, uint64_t);
     void WriteVerify(uint64_t, uint32_t, bool);
+    uint32_t GetSectorTransferCount(uint32_t) const;
+    uint32_t GetChunkSectorCount() const;
+    pair<data_out_t, shared_ptr<const void>> ReadChunk(data_in_t);
+    void WriteChunk(cdb_t, data_out_t, bool);
     uint64_t ValidateBlockAddress(AccessMode);
     tuple<bool, uint64_t, uint32_t> CheckAndGetStartAndCount(AccessMode);
 
     shared_ptr<Cache> cache;
 
+    // The latencies of the cache operations, including the time spent waiting for the image file
+    LatencyHistogram read_latency;
+    LatencyHistogram write_latency;
+    LatencyHistogram flush_latency;
+
+    // With the AUTO caching mode this is the caching mode currently selected
     PbCachingMode caching_mode = PbCachingMode::DEFAULT;
 
+    // Only set with the AUTO caching mode
+    unique_ptr<CachingModeSelector> caching_mode_selector;
+
+    uint64_t caching_mode_switch_count = 0;
+
     uint64_t next_sector = 0;
 
     uint32_t sector_transfer_count = 0;
+
+    // The sector following the last sector to read or write with the current command
+    uint64_t end_sector = 0;
+
+    // The number of tracks and sectors per track for the PiSCSI caching mode
+    int cache_tracks = 0;
+    int track_sectors = 0;
+
+    // When to write back modified tracks, the age in milliseconds and the threshold in bytes
+    int flush_age = 0;
+    uint64_t flush_threshold = 0;
+
+    // The global memory budget for the PiSCSI caches in bytes, 0 if there is no budget
+    inline static uint64_t cache_memory = 0;
+
+    // The disks using the PiSCSI caching mode, they share the memory budget
+    inline static unordered_set<Disk*> track_caching_disks;
+
+    static constexpr const char *CACHE_TRACKS = "cache_tracks";
+    static constexpr const char *TRACK_SECTORS = "track_sectors";
+    static constexpr const char *FLUSH_AGE = "flush_age";
+    static constexpr const char *FLUSH_THRESHOLD = "flush_threshold";
+    static constexpr const char *BASE_IMAGE = "base";
+
+    static constexpr const char *AUTO_CACHING_MODE = "auto_caching_mode";
+    static constexpr const char *CACHING_MODE_SWITCH_COUNT = "caching_mode_switch_count";
+
+    // WRITE SAME writes up to this number of sectors with a single cache access
+    static constexpr int MAX_WRITE_SAME_SECTORS = 256;
 };
@@ -13,185 +13,698 @@
 //---------------------------------------------------------------------------
 
 #include "disk_cache.h"
+#include <algorithm>
 #include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
 #include "disk_track.h"
+#include "group_commit.h"
+#include "shared/memory_util.h"
 
-DiskCache::DiskCache(const string &path, int size, uint64_t sectors) : sec_path(path), blocks(
-    static_cast<int>(sectors))
+DiskCache::DiskCache(const string &path, int size, uint64_t sectors, int t, int track_sectors) : max_tracks(t), sec_path(
+    path), blocks(static_cast<int>(sectors))
 {
+    assert(max_tracks > 0);
+    track_index.reserve(max_tracks);
+
     while ((1 << shift_count) != size) {
         ++shift_count;
     }
     assert(shift_count >= 8 && shift_count <= 12);
+
+    // The number of sectors per track must be a power of 2
+    while ((1 << track_shift_count) < track_sectors) {
+        ++track_shift_count;
+    }
+    assert((1 << track_shift_count) == track_sectors);
+}
+
+DiskCache::~DiskCache()
+{
+    // The background threads must not access the image file anymore
+    StopWriteBack();
+    prefetcher.reset();
+
+    if (fd != -1) {
+        close(fd);
+    }
 }
 
 bool DiskCache::Init()
 {
-    return blocks && !sec_path.empty();
+    if (!blocks || sec_path.empty()) {
+        return false;
+    }
+
+    StopWriteBack();
+    prefetcher.reset();
+
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+
+    is_direct_io = false;
+#ifdef O_DIRECT
+    // Direct I/O requires aligned transfers, which sectors with less than 512 bytes do not guarantee.
+    // Not all file systems support direct I/O.
+    if (direct_io && shift_count >= 9) {
+        fd = open(sec_path.c_str(), O_RDWR | O_DIRECT);
+        if (fd == -1) {
+            fd = open(sec_path.c_str(), O_RDONLY | O_DIRECT);
+        }
+        is_direct_io = fd != -1;
+    }
+#endif
+
+    if (fd == -1) {
+        fd = open(sec_path.c_str(), O_RDWR);
+    }
+    if (fd == -1) {
+        // Read-only image files can still be read
+        fd = open(sec_path.c_str(), O_RDONLY);
+    }
+
+    if (fd == -1) {
+        return false;
+    }
+
+    prefetcher = make_unique<Prefetcher>([this](uint64_t start, uint64_t count) {Prefetch(start, count);},
+        GetPrefetchWindow());
+
+    return true;
 }
 
 bool DiskCache::Flush()
 {
+    unique_lock<mutex> lock(cache_mutex);
+
+    // Pending write-backs must have completed before
+    flushed_condition.wait(lock, [this] {return flushing_tracks.empty();});
+
     // Save valid tracks
-    return ranges::none_of(cache, [this](const CacheData &c)
-        {   return c.disktrk && !c.disktrk->Save(sec_path, cache_miss_write_count);});
+    return ranges::none_of(tracks, [this](const auto &disktrk)
+        {   return !SaveTrack(*disktrk);});
 }
 
-shared_ptr<DiskTrack> DiskCache::GetTrack(uint32_t block)
+bool DiskCache::Sync()
 {
-    // Update first
-    UpdateSerial();
+    if (!Flush()) {
+        return false;
+    }
+
+    if (GroupCommit::Instance().Sync(fd)) {
+        return true;
+    }
 
-    // Calculate track (fixed to 256 sectors/track)
-    int track = block >> 8;
+    scoped_lock<mutex> lock(cache_mutex);
+    ++write_error_count;
+
+    return false;
+}
+
+void DiskCache::SetWriteBack(int age, uint64_t threshold)
+{
+    assert(age >= 0);
+
+    scoped_lock<mutex> lock(cache_mutex);
+
+    flush_age = chrono::milliseconds(age);
+    flush_threshold = threshold;
+}
+
+bool DiskCache::SetMaxTracks(int t)
+{
+    assert(t > 0);
+
+    unique_lock<mutex> lock(cache_mutex);
+
+    flushed_condition.wait(lock, [this] {return flushing_tracks.empty();});
+
+    max_tracks = t;
+    track_index.reserve(max_tracks);
+
+    // Release the least recently used tracks if the cache has shrunk
+    while (static_cast<int>(tracks.size()) > max_tracks) {
+        if (!SaveTrack(*tracks.back())) {
+            return false;
+        }
+
+        track_index.erase(tracks.back()->GetTrack());
+        tracks.pop_back();
+        ++eviction_count;
+    }
+
+    if (prefetcher) {
+        prefetcher->SetMaxWindow(GetPrefetchWindow());
+    }
+
+    return true;
+}
+
+bool DiskCache::IsCached(uint64_t sector, uint32_t count) const
+{
+    for (uint64_t track = sector >> track_shift_count; track <= (sector + count - 1) >> track_shift_count; ++track) {
+        if (track_index.contains(static_cast<int>(track))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+shared_ptr<DiskTrack> DiskCache::GetTrack(uint32_t block, unique_lock<mutex> &lock)
+{
+    // Calculate track
+    int track = block >> track_shift_count;
 
     // Get track data
-    return Assign(track);
+    return Assign(track, lock);
 }
 
 int DiskCache::ReadSectors(data_in_t buf, uint64_t sector, uint32_t count)
 {
-    assert(count == 1);
-    if (count != 1) {
+    if (sector + count > static_cast<uint64_t>(blocks)) {
         return 0;
     }
 
-    shared_ptr<DiskTrack> disktrk = GetTrack(static_cast<uint32_t>(sector));
+    const uint64_t start = sector;
+    const uint32_t total = count;
+
+    unique_lock<mutex> lock(cache_mutex);
+
+    // With direct I/O large reads of sectors not cached go straight into the caller's buffer.
+    // This does not replace cached tracks with data that are most likely not accessed again.
+    if (is_direct_io && count >= static_cast<uint32_t>(1 << track_shift_count)
+        && !(reinterpret_cast<uintptr_t>(buf.data()) % memory_util::IO_ALIGNMENT) && !IsCached(sector, count)) {
+        ++cache_miss_read_count;
+
+        const ssize_t length = static_cast<ssize_t>(count) << shift_count;
+        if (pread(fd, buf.data(), length, static_cast<off_t>(sector) << shift_count) != length) {
+            ++read_error_count;
+            return 0;
+        }
+
+        served_read_byte_count += length;
+
+        if (prefetcher) {
+            prefetcher->Update(start, total);
+        }
+
+        return static_cast<int>(length);
+    }
+
+    int offset = 0;
+
+    // Process the sectors track by track, a single command may span several tracks
+    while (count) {
+        if (IsCached(sector, 1)) {
+            ++cache_hit_read_count;
+        }
+
+        shared_ptr<DiskTrack> disktrk = GetTrack(static_cast<uint32_t>(sector), lock);
+        if (!disktrk) {
+            return 0;
+        }
+
+        const int sector_in_track = sector & ((1 << track_shift_count) - 1);
+        const int sectors = min(static_cast<int>(count), (1 << track_shift_count) - sector_in_track);
+
+        // Read the track data to the cache
+        const int length = disktrk->ReadSectors(buf.subspan(offset), sector_in_track, sectors);
+        if (!length) {
+            return 0;
+        }
+
+        offset += length;
+        sector += sectors;
+        count -= sectors;
+    }
+
+    if (prefetcher) {
+        prefetcher->Update(start, total);
+    }
+
+    served_read_byte_count += offset;
+
+    return offset;
+}
+
+pair<data_out_t, shared_ptr<const void>> DiskCache::BorrowSectors(uint64_t sector, uint32_t count)
+{
+    // Only sectors within a single track can be borrowed
+    if (!count || sector + count > static_cast<uint64_t>(blocks)
+        || sector >> track_shift_count != (sector + count - 1) >> track_shift_count) {
+        return {};
+    }
+
+    unique_lock<mutex> lock(cache_mutex);
+
+    // Large reads of sectors not cached are not worth caching with direct I/O, see ReadSectors()
+    if (is_direct_io && count >= static_cast<uint32_t>(1 << track_shift_count) && !IsCached(sector, count)) {
+        return {};
+    }
+
+    const bool is_cached = IsCached(sector, 1);
+
+    shared_ptr<DiskTrack> disktrk = GetTrack(static_cast<uint32_t>(sector), lock);
     if (!disktrk) {
-        return 0;
+        return {};
+    }
+
+    const int sector_in_track = sector & ((1 << track_shift_count) - 1);
+    if (sector_in_track + static_cast<int>(count) > disktrk->sector_count) {
+        return {};
+    }
+
+    if (prefetcher) {
+        prefetcher->Update(sector, count);
+    }
+
+    if (is_cached) {
+        ++cache_hit_read_count;
     }
+    served_read_byte_count += static_cast<uint64_t>(count) << shift_count;
 
-    // Read the track data to the cache
-    return disktrk->ReadSector(buf, sector & 0xff);
+    // The pin shares the ownership of the track, which prevents its buffer from being recycled
+    const uint8_t *data = disktrk->buffer + (sector_in_track << shift_count);
+    return {data_out_t(data, static_cast<size_t>(count) << shift_count),
+        shared_ptr<const void>(disktrk, data)};
 }
 
 int DiskCache::WriteSectors(data_out_t buf, uint64_t sector, uint32_t count)
 {
-    assert(count == 1);
-    if (count != 1) {
+    if (sector + count > static_cast<uint64_t>(blocks)) {
         return 0;
     }
 
-    shared_ptr<DiskTrack> disktrk = GetTrack(static_cast<uint32_t>(sector));
-    if (!disktrk) {
-        return 0;
+    unique_lock<mutex> lock(cache_mutex);
+
+    const uint64_t previously_modified = modified_sectors;
+
+    int offset = 0;
+
+    // Process the sectors track by track, a single command may span several tracks
+    while (count) {
+        if (IsCached(sector, 1)) {
+            ++cache_hit_write_count;
+        }
+
+        shared_ptr<DiskTrack> disktrk = GetTrack(static_cast<uint32_t>(sector), lock);
+        if (!disktrk) {
+            return 0;
+        }
+
+        const int sector_in_track = sector & ((1 << track_shift_count) - 1);
+        const int sectors = min(static_cast<int>(count), (1 << track_shift_count) - sector_in_track);
+
+        // Write the data to the cache
+        const int modified = disktrk->modified_count;
+        const int length = disktrk->WriteSectors(buf.subspan(offset), sector_in_track, sectors);
+        modified_sectors += disktrk->modified_count - modified;
+        if (!length) {
+            return 0;
+        }
+
+        offset += length;
+        sector += sectors;
+        count -= sectors;
+    }
+
+    served_write_byte_count += offset;
+
+    if (modified_sectors && (flush_age.count() || flush_threshold)) {
+        if (!write_back_thread.joinable()) {
+            StartWriteBack();
+        }
+
+        // Only notify when the write-back thread has to check again whether a write-back is due
+        if (!previously_modified) {
+            modified_since = chrono::steady_clock::now();
+            write_back_condition.notify_one();
+        }
+        else if (flush_threshold && (previously_modified << shift_count) < flush_threshold
+            && (modified_sectors << shift_count) >= flush_threshold) {
+            write_back_condition.notify_one();
+        }
+    }
+
+    return offset;
+}
+
+bool DiskCache::ZeroSectors(uint64_t start, uint64_t count, bool deallocate)
+{
+    if (!count || start + count > static_cast<uint64_t>(blocks)) {
+        return false;
+    }
+
+    unique_lock<mutex> lock(cache_mutex);
+
+    const auto first_track = static_cast<int>(start >> track_shift_count);
+    const auto last_track = static_cast<int>((start + count - 1) >> track_shift_count);
+
+    vector<int> affected_tracks;
+    for (const auto& [track, _] : track_index) {
+        if (track >= first_track && track <= last_track) {
+            affected_tracks.push_back(track);
+        }
+    }
+
+    // The cached data of these tracks must neither be read nor be written back anymore.
+    // Modified sectors of partially affected tracks are saved first.
+    for (const int track : affected_tracks) {
+        flushed_condition.wait(lock, [this, track] {return !flushing_tracks.contains(track);});
+
+        const auto &it = track_index.find(track);
+        if (it == track_index.end()) {
+            continue;
+        }
+
+        const auto disktrk = *it->second;
+        const uint64_t track_start = static_cast<uint64_t>(track) << track_shift_count;
+        if ((track_start < start || track_start + disktrk->sector_count > start + count) && !SaveTrack(*disktrk)) {
+            ++write_error_count;
+            return false;
+        }
+
+        modified_sectors -= disktrk->modified_count;
+        tracks.erase(it->second);
+        track_index.erase(it);
     }
 
-    // Write the data to the cache
-    return disktrk->WriteSector(buf, sector & 0xff);
+    // Like any other write bypassing the cache this makes the prefetcher discard data it is currently loading
+    ++cache_miss_write_count;
+
+    return ZeroRange(fd, static_cast<off_t>(start) << shift_count, static_cast<off_t>(count) << shift_count,
+        deallocate);
 }
 
 // Track Assignment
-shared_ptr<DiskTrack> DiskCache::Assign(int track)
+shared_ptr<DiskTrack> DiskCache::Assign(int track, unique_lock<mutex> &lock)
 {
     assert(track >= 0);
 
     // First, check if it is already assigned
-    for (CacheData &c : cache) {
-        if (c.disktrk && c.disktrk->GetTrack() == track) {
-            // Track match
-            c.serial = serial;
-            return c.disktrk;
-        }
-    }
-
-    // Next, check for empty
-    for (size_t i = 0; i < cache.size(); ++i) {
-        if (!cache[i].disktrk) {
-            // Try loading
-            if (Load(static_cast<int>(i), track, nullptr)) {
-                // Success loading
-                cache[i].serial = serial;
-                return cache[i].disktrk;
-            }
+    if (const auto &it = track_index.find(track); it != track_index.end()) {
+        // Make this track the most recently used one
+        tracks.splice(tracks.begin(), tracks, it->second);
 
-            // Load failed
-            return nullptr;
+        if (tracks.front()->is_prefetched) {
+            tracks.front()->is_prefetched = false;
+            ++prefetch_hit_count;
         }
-    }
 
-    // Finally, find the youngest serial number and delete it
+        return tracks.front();
+    }
 
-    // Set index 0 as candidate c
-    uint32_t s = cache[0].serial;
-    size_t c = 0;
+    shared_ptr<DiskTrack> disktrk;
 
-    // Compare candidate with serial and update to smaller one
-    for (size_t i = 0; i < cache.size(); ++i) {
-        assert(cache[i].disktrk);
+    // If the cache is full save the least recently used track and recycle it.
+    // With the write-back thread this track usually does not need to be saved anymore.
+    if (static_cast<int>(tracks.size()) >= max_tracks) {
+        // A track being written back must remain cached until the write has completed
+        flushed_condition.wait(lock, [this] {return !flushing_tracks.contains(tracks.back()->GetTrack());});
 
-        // Compare and update the existing serial
-        if (cache[i].serial < s) {
-            s = cache[i].serial;
-            c = i;
+        disktrk = tracks.back();
+        if (!SaveTrack(*disktrk)) {
+            return nullptr;
         }
-    }
 
-    // Save this track
-    if (!cache[c].disktrk->Save(sec_path, cache_miss_write_count)) {
-        return nullptr;
+        track_index.erase(disktrk->GetTrack());
+        tracks.pop_back();
+        ++eviction_count;
+
+        // The buffer of a track with borrowed data must not be recycled
+        if (disktrk.use_count() > 1) {
+            disktrk.reset();
+        }
     }
 
-    // Delete this track
-    shared_ptr<DiskTrack> disktrk = cache[c].disktrk;
-    cache[c].disktrk.reset();
+    return Load(track, disktrk);
+}
 
-    if (Load(static_cast<int>(c), track, disktrk)) {
-        // Successful loading
-        cache[c].serial = serial;
-        return cache[c].disktrk;
+bool DiskCache::SaveTrack(DiskTrack &disktrk)
+{
+    const int modified = disktrk.modified_count;
+    const auto start = chrono::steady_clock::now();
+    if (!disktrk.Save(fd, cache_miss_write_count, write_back_byte_count)) {
+        return false;
     }
+    save_latency.Record(start);
 
-    // Load failed
-    return nullptr;
+    modified_sectors -= modified;
+
+    return true;
 }
 
-bool DiskCache::Load(int index, int track, shared_ptr<DiskTrack> disktrk)
+shared_ptr<DiskTrack> DiskCache::Load(int track, shared_ptr<DiskTrack> disktrk)
 {
-    assert(index >= 0 && index < static_cast<int>(cache.size()));
     assert(track >= 0);
-    assert(!cache[index].disktrk);
+    assert(!track_index.contains(track));
 
     // Get the number of sectors on this track
-    int sectors = blocks - (track << 8);
+    int sectors = blocks - (track << track_shift_count);
     assert(sectors > 0);
-    if (sectors > 0x100) {
-        sectors = 0x100;
+    if (sectors > (1 << track_shift_count)) {
+        sectors = 1 << track_shift_count;
     }
 
     if (!disktrk) {
         disktrk = make_shared<DiskTrack>();
     }
 
-    disktrk->Init(track, shift_count, sectors);
+    disktrk->Init(track, shift_count, sectors, track_shift_count);
 
     // Try loading
-    if (!disktrk->Load(sec_path, cache_miss_read_count)) {
+    const auto start = chrono::steady_clock::now();
+    if (!disktrk->Load(fd, cache_miss_read_count)) {
         ++read_error_count;
 
-        return false;
+        return nullptr;
     }
+    load_latency.Record(start);
 
     // Allocation successful, work set
-    cache[index].disktrk = disktrk;
+    tracks.push_front(disktrk);
+    track_index[track] = tracks.begin();
 
-    return true;
+    return disktrk;
 }
 
-void DiskCache::UpdateSerial()
+void DiskCache::Prefetch(uint64_t start, uint64_t count)
 {
-    // Update and do nothing except 0
-    ++serial;
-    if (serial != 0) {
+    const uint64_t end = min(start + count, static_cast<uint64_t>(blocks));
+    if (start >= end) {
         return;
     }
 
-    // Clear serial of all caches
-    for (CacheData &c : cache) {
-        c.serial = 0;
+    for (auto track = static_cast<int>(start >> track_shift_count);
+        track <= static_cast<int>((end - 1) >> track_shift_count); ++track) {
+        PrefetchTrack(track);
     }
 }
 
+// Called by the prefetcher thread, only the cache lookup and update require the lock, not the I/O
+void DiskCache::PrefetchTrack(int track)
+{
+    uint64_t write_count;
+
+    {
+        scoped_lock<mutex> lock(cache_mutex);
+
+        if (track_index.contains(track)) {
+            return;
+        }
+
+        // Any write while loading may have modified the data on disk
+        write_count = cache_miss_write_count;
+    }
+
+    auto disktrk = make_shared<DiskTrack>();
+    disktrk->Init(track, shift_count, min(blocks - (track << track_shift_count), 1 << track_shift_count),
+        track_shift_count);
+    // Loading ahead of time is not a cache miss
+    uint64_t read_count = 0;
+    const auto start = chrono::steady_clock::now();
+    if (!disktrk->Load(fd, read_count)) {
+        return;
+    }
+    load_latency.Record(start);
+
+    scoped_lock<mutex> lock(cache_mutex);
+
+    if (track_index.contains(track) || write_count != cache_miss_write_count) {
+        return;
+    }
+
+    // Prefetching never writes, it only replaces an unmodified track
+    if (static_cast<int>(tracks.size()) >= max_tracks) {
+        if (tracks.back()->is_modified || flushing_tracks.contains(tracks.back()->GetTrack())) {
+            return;
+        }
+
+        track_index.erase(tracks.back()->GetTrack());
+        tracks.pop_back();
+        ++eviction_count;
+    }
+
+    disktrk->is_prefetched = true;
+    tracks.push_front(disktrk);
+    track_index[track] = tracks.begin();
+}
+
+void DiskCache::StartWriteBack()
+{
+#ifndef __APPLE__
+    write_back_thread = jthread([this]() {WriteBack();});
+#else
+    write_back_thread = thread([this] () { WriteBack(); } );
+#endif
+}
+
+void DiskCache::StopWriteBack()
+{
+    {
+        scoped_lock<mutex> lock(cache_mutex);
+        stop_write_back = true;
+    }
+    write_back_condition.notify_one();
+
+    if (write_back_thread.joinable()) {
+        write_back_thread.join();
+    }
+
+    stop_write_back = false;
+}
+
+void DiskCache::WriteBack()
+{
+    unique_lock<mutex> lock(cache_mutex);
+
+    const auto &is_woken_up = [this] {
+        return stop_write_back || !modified_sectors
+            || (flush_threshold && (modified_sectors << shift_count) >= flush_threshold);
+    };
+
+    while (!stop_write_back) {
+        if (!modified_sectors) {
+            write_back_condition.wait(lock, [this] {return stop_write_back || modified_sectors;});
+        }
+        else if (IsWriteBackDue()) {
+            if (!WriteBackTracks(lock)) {
+                write_back_condition.wait_for(lock, WRITE_BACK_RETRY_DELAY, [this] {return stop_write_back;});
+            }
+        }
+        else if (flush_age.count()) {
+            write_back_condition.wait_until(lock, modified_since + flush_age, is_woken_up);
+        }
+        else {
+            write_back_condition.wait(lock, is_woken_up);
+        }
+    }
+}
+
+bool DiskCache::IsWriteBackDue() const
+{
+    return (flush_threshold && (modified_sectors << shift_count) >= flush_threshold)
+        || (flush_age.count() && chrono::steady_clock::now() - modified_since >= flush_age);
+}
+
+// Writes all modified tracks in track order, adjacent tracks are combined into a single write.
+// The data are copied while the lock is held, the lock is released while writing.
+bool DiskCache::WriteBackTracks(unique_lock<mutex> &lock)
+{
+    vector<shared_ptr<DiskTrack>> modified_tracks;
+    for (const auto &disktrk : tracks) {
+        if (disktrk->is_modified) {
+            modified_tracks.push_back(disktrk);
+        }
+    }
+    ranges::sort(modified_tracks, { }, &DiskTrack::GetTrack);
+
+    struct Segment
+    {
+        shared_ptr<DiskTrack> disktrk;
+        int start;
+        int end;
+    };
+
+    vector<vector<Segment>> runs;
+    for (const auto &disktrk : modified_tracks) {
+        const auto [start, end] = disktrk->GetModifiedRange();
+        if (!runs.empty() && runs.back().back().disktrk->GetTrack() + 1 == disktrk->GetTrack()) {
+            // Also write the unmodified sectors between the modified ranges of adjacent tracks
+            runs.back().back().end = runs.back().back().disktrk->sector_count;
+            runs.back().push_back( { disktrk, 0, end });
+        }
+        else {
+            runs.push_back( { { disktrk, start, end } });
+        }
+    }
+
+    // With direct I/O the data to write must be aligned
+    vector<pair<off_t, memory_util::aligned_buffer>> writes;
+    for (const auto &run : runs) {
+        const auto &first = run.front();
+        memory_util::aligned_buffer data;
+        for (const auto& [disktrk, start, end] : run) {
+            data.insert(data.end(), disktrk->buffer + (start << shift_count), disktrk->buffer + (end << shift_count));
+
+            modified_sectors -= disktrk->modified_count;
+            disktrk->ClearModified();
+            flushing_tracks.insert(disktrk->GetTrack());
+        }
+        writes.emplace_back(((static_cast<off_t>(first.disktrk->GetTrack()) << track_shift_count) + first.start)
+            << shift_count, std::move(data));
+    }
+
+    lock.unlock();
+
+    vector<uint8_t> results;
+    for (const auto& [offset, data] : writes) {
+        const auto start = chrono::steady_clock::now();
+        results.push_back(WriteRange(fd, data, offset));
+        save_latency.Record(start);
+    }
+
+    lock.lock();
+
+    bool success = true;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        for (const auto& [disktrk, start, end] : runs[i]) {
+            flushing_tracks.erase(disktrk->GetTrack());
+
+            // The data have to be written again
+            if (!results[i]) {
+                if (!modified_sectors) {
+                    modified_since = chrono::steady_clock::now();
+                }
+                const int modified = disktrk->modified_count;
+                disktrk->SetModified(start, end);
+                modified_sectors += disktrk->modified_count - modified;
+            }
+        }
+
+        if (results[i]) {
+            ++cache_miss_write_count;
+            write_back_byte_count += writes[i].second.size();
+        }
+        else {
+            ++write_error_count;
+            success = false;
+        }
+    }
+
+    flushed_condition.notify_all();
+
+    return success;
+}
+
+uint64_t DiskCache::GetPrefetchWindow() const
+{
+    return static_cast<uint64_t>(min(MAX_PREFETCH_TRACKS, max_tracks / 4)) << track_shift_count;
+}
+
 vector<PbStatistics> DiskCache::GetStatistics(bool is_read_only) const
 {
     vector<PbStatistics> statistics;
@@ -210,6 +723,59 @@ vector<PbStatistics> DiskCache::GetStatistics(bool is_read_only) const
         statistics.push_back(s);
     }
 
+    s.set_key(PREFETCH_HIT_COUNT);
+    s.set_value(prefetch_hit_count);
+    statistics.push_back(s);
+
+    s.set_key(CACHE_HIT_READ_COUNT);
+    s.set_value(cache_hit_read_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(CACHE_HIT_WRITE_COUNT);
+        s.set_value(cache_hit_write_count);
+        statistics.push_back(s);
+    }
+
+    s.set_key(CACHE_EVICTION_COUNT);
+    s.set_value(eviction_count);
+    statistics.push_back(s);
+
+    {
+        scoped_lock<mutex> lock(cache_mutex);
+
+        uint64_t resident_bytes = 0;
+        for (const auto &disktrk : tracks) {
+            resident_bytes += disktrk->buffer_size;
+        }
+        s.set_key(CACHE_RESIDENT_BYTES);
+        s.set_value(resident_bytes);
+        statistics.push_back(s);
+
+        if (!is_read_only) {
+            s.set_key(CACHE_DIRTY_BYTES);
+            s.set_value(modified_sectors << shift_count);
+            statistics.push_back(s);
+        }
+    }
+
+    s.set_key(SERVED_READ_BYTE_COUNT);
+    s.set_value(served_read_byte_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(SERVED_WRITE_BYTE_COUNT);
+        s.set_value(served_write_byte_count);
+        statistics.push_back(s);
+
+        s.set_key(WRITE_BACK_BYTE_COUNT);
+        s.set_value(write_back_byte_count);
+        statistics.push_back(s);
+    }
+
+    load_latency.AddStatistics(statistics, "load");
+    save_latency.AddStatistics(statistics, "save");
+
     s.set_category(PbStatisticsCategory::CATEGORY_ERROR);
 
     s.set_key(READ_ERROR_COUNT);
@@ -11,7 +11,16 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "cache.h"
+#include "latency_histogram.h"
+#include "prefetcher.h"
 
 class DiskTrack;
 
@@ -20,46 +29,141 @@ class DiskCache : public Cache
 
 public:
 
-    DiskCache(const string&, int, uint64_t);
-    ~DiskCache() override = default;
+    DiskCache(const string&, int, uint64_t, int = DEFAULT_TRACKS, int = DEFAULT_TRACK_SECTORS);
+    ~DiskCache() override;
 
     bool Init() override;
     bool Flush() override;
+    bool Sync() override;
     int ReadSectors(data_in_t, uint64_t, uint32_t) override;
     int WriteSectors(data_out_t, uint64_t, uint32_t) override;
+    pair<data_out_t, shared_ptr<const void>> BorrowSectors(uint64_t, uint32_t) override;
+    bool ZeroSectors(uint64_t, uint64_t, bool) override;
 
     vector<PbStatistics> GetStatistics(bool) const override;
 
+    void SetWriteBack(int, uint64_t);
+
+    // Must be called before Init()
+    void SetDirectIo(bool d)
+    {
+        direct_io = d;
+    }
+
+    bool SetMaxTracks(int);
+    int GetMaxTracks() const
+    {
+        return max_tracks;
+    }
+
+    // The number of bytes required for caching a single track
+    uint64_t GetTrackSize() const
+    {
+        return static_cast<uint64_t>(1) << (track_shift_count + shift_count);
+    }
+
+    static constexpr int DEFAULT_TRACKS = 16;
+    static constexpr int DEFAULT_TRACK_SECTORS = 256;
+
+    // Modified data are written back after 1 s or when there are 1 MiB of them
+    static constexpr int DEFAULT_FLUSH_AGE = 1000;
+    static constexpr uint64_t DEFAULT_FLUSH_THRESHOLD = 1024 * 1024;
+
 private:
 
-    using CacheData = struct {
-        shared_ptr<DiskTrack> disktrk;
-        uint32_t serial;
-    };
+    shared_ptr<DiskTrack> Assign(int, unique_lock<mutex>&);
+    shared_ptr<DiskTrack> GetTrack(uint32_t, unique_lock<mutex>&);
+    bool IsCached(uint64_t, uint32_t) const;
+    shared_ptr<DiskTrack> Load(int, shared_ptr<DiskTrack>);
+    bool SaveTrack(DiskTrack&);
+
+    void StartWriteBack();
+    void StopWriteBack();
+    void WriteBack();
+    bool WriteBackTracks(unique_lock<mutex>&);
+    bool IsWriteBackDue() const;
+
+    void Prefetch(uint64_t, uint64_t);
+    void PrefetchTrack(int);
+    uint64_t GetPrefetchWindow() const;
+
+    // The cached tracks, ordered from the most recently used to the least recently used one
+    list<shared_ptr<DiskTrack>> tracks;
+
+    // Track numbers mapped to their position in the list of cached tracks
+    unordered_map<int, list<shared_ptr<DiskTrack>>::iterator> track_index;
 
-    shared_ptr<DiskTrack> Assign(int);
-    shared_ptr<DiskTrack> GetTrack(uint32_t);
-    bool Load(int index, int track, shared_ptr<DiskTrack>);
-    void UpdateSerial();
+    int max_tracks;
 
-    // Number of tracks to cache
-    static constexpr int CACHE_MAX = 16;
+    // Guards the cached tracks against concurrent access by the prefetcher
+    mutable mutex cache_mutex;
 
-    array<CacheData, CACHE_MAX> cache = { };
+    unique_ptr<Prefetcher> prefetcher;
 
-    // Last serial number
-    uint32_t serial = 0;
+    // Modified tracks are written back when the oldest modification has reached this age, 0 means no limit
+    chrono::milliseconds flush_age { 0 };
+
+    // Modified tracks are written back when this number of bytes is modified, 0 means no limit
+    uint64_t flush_threshold = 0;
+
+    // The number of modified sectors in all tracks and the time when the first of them was modified
+    uint64_t modified_sectors = 0;
+    chrono::steady_clock::time_point modified_since;
+
+    // The tracks currently being written back, they must not be evicted before the write has completed
+    unordered_set<int> flushing_tracks;
+
+    // Wakes up the write-back thread
+    condition_variable write_back_condition;
+
+    // Signals that a write-back has completed
+    condition_variable flushed_condition;
+
+    bool stop_write_back = false;
+
+#ifndef __APPLE__
+    jthread write_back_thread;
+#else
+    thread write_back_thread;
+#endif
 
     string sec_path;
 
+    // The image file, which remains open as long as the cache exists
+    int fd = -1;
+
+    // With direct I/O the kernel page cache is bypassed, and this cache is the only one
+    bool direct_io = false;
+    bool is_direct_io = false;
+
     // Sector size shift  (8 = 256, 9 = 512, 10 = 1024, 11 = 2048, 12 = 4096)
     int shift_count = 8;
 
+    // Sectors per track shift (8 = 256 sectors)
+    int track_shift_count = 0;
+
     int blocks;
 
     uint64_t read_error_count = 0;
     uint64_t write_error_count = 0;
     uint64_t cache_miss_read_count = 0;
     uint64_t cache_miss_write_count = 0;
+    uint64_t prefetch_hit_count = 0;
+    uint64_t cache_hit_read_count = 0;
+    uint64_t cache_hit_write_count = 0;
+    uint64_t eviction_count = 0;
+    uint64_t served_read_byte_count = 0;
+    uint64_t served_write_byte_count = 0;
+    uint64_t write_back_byte_count = 0;
+
+    // The latencies of loading tracks from and saving tracks to the image file, also by background threads
+    LatencyHistogram load_latency;
+    LatencyHistogram save_latency;
+
+    // Failed write-backs are retried after this delay
+    static constexpr chrono::milliseconds WRITE_BACK_RETRY_DELAY { 1000 };
+
+    // The maximum number of tracks loaded ahead of the current position, at most a quarter of the cached tracks
+    static constexpr int MAX_PREFETCH_TRACKS = 4;
 };
 
@@ -10,28 +10,36 @@
 //---------------------------------------------------------------------------
 
 #include "disk_track.h"
+#include "cache.h"
+#include <algorithm>
 #include <cassert>
-#include <fstream>
-#include <spdlog/spdlog.h>
+#include <cstdlib>
+#include <cstring>
+#include <ranges>
+#include <unistd.h>
+#include "shared/memory_util.h"
 
 DiskTrack::~DiskTrack()
 {
     free(buffer); // NOSONAR free() must be used here because of allocation with posix_memalign
 }
 
-void DiskTrack::Init(int track, int size, int sectors)
+void DiskTrack::Init(int track, int size, int sectors, int track_shift)
 {
     assert(track >= 0);
-    assert(sectors > 0 && sectors <= 256);
+    assert(sectors > 0 && sectors <= (1 << track_shift));
 
     track_number = track;
     shift_count = size;
+    track_shift_count = track_shift;
     sector_count = sectors;
     is_initialized = false;
     is_modified = false;
+    modified_count = 0;
+    is_prefetched = false;
 }
 
-bool DiskTrack::Load(const string &path, uint64_t &cache_miss_read_count)
+bool DiskTrack::Load(int fd, uint64_t &cache_miss_read_count)
 {
     // Not needed if already loaded
     if (is_initialized) {
@@ -41,13 +49,13 @@ bool DiskTrack::Load(const string &path, uint64_t &cache_miss_read_count)
 
     ++cache_miss_read_count;
 
-    // Calculate offset (previous tracks are considered to hold 256 sectors)
-    off_t offset = (off_t)track_number << 8;
+    // Calculate offset (previous tracks are considered to hold the nominal number of sectors)
+    off_t offset = (off_t)track_number << track_shift_count;
     offset <<= shift_count;
 
     const int size = sector_count << shift_count;
 
-    if (!buffer && !posix_memalign((void**)&buffer, 512, ((size + 511) / 512) * 512)) {
+    if (!buffer && !posix_memalign((void**)&buffer, memory_util::IO_ALIGNMENT, ((size + 511) / 512) * 512)) {
         buffer_size = size;
     }
 
@@ -55,7 +63,7 @@ bool DiskTrack::Load(const string &path, uint64_t &cache_miss_read_count)
     if (buffer && buffer_size != static_cast<uint32_t>(size)) {
         free(buffer); // NOSONAR free() must be used here because of allocation with posix_memalign
         buffer = nullptr;
-        if (!posix_memalign((void**)&buffer, 512, ((size + 511) / 512) * 512)) {
+        if (!posix_memalign((void**)&buffer, memory_util::IO_ALIGNMENT, ((size + 511) / 512) * 512)) {
             buffer_size = size;
         }
     }
@@ -68,18 +76,12 @@ bool DiskTrack::Load(const string &path, uint64_t &cache_miss_read_count)
     ranges::fill(modified_flags, 0);
     is_initialized = true;
     is_modified = false;
+    modified_count = 0;
 
-    ifstream in(path, ios::binary);
-    if (in.fail()) {
-        return false;
-    }
-
-    in.seekg(offset);
-    in.read((char*)buffer, size);
-    return in.good();
+    return pread(fd, buffer, size, offset) == size;
 }
 
-bool DiskTrack::Save(const string &path, uint64_t &cache_miss_write_count)
+bool DiskTrack::Save(int fd, uint64_t &cache_miss_write_count, uint64_t &write_back_byte_count)
 {
     if (!is_initialized || !is_modified) {
         return true;
@@ -89,88 +91,115 @@ bool DiskTrack::Save(const string &path, uint64_t &cache_miss_write_count)
 
     ++cache_miss_write_count;
 
-    // Calculate offset (previous tracks are considered to hold 256 sectors)
-    off_t offset = (off_t)track_number << 8;
+    // Calculate offset (previous tracks are considered to hold the nominal number of sectors)
+    off_t offset = (off_t)track_number << track_shift_count;
     offset <<= shift_count;
 
-    const int size = 1 << shift_count;
-
-    // ios:in is required in order not to truncate
-    ofstream out(path, ios::in | ios::out | ios::binary);
-    if (out.fail()) {
-        return false;
-    }
-
-    // Write consecutive sectors
+    // Write consecutive sectors, ranges separated by only a few unmodified sectors are combined
     for (int i = 0; i < sector_count;) {
         if (modified_flags[i]) {
-            int total = 0;
-
-            // Determine consecutive sector range
-            int j;
-            for (j = i; j < sector_count; ++j) {
-                if (!modified_flags[j]) {
-                    break;
+            // Determine the end of the range to write
+            int end = i + 1;
+            for (int j = end; j < sector_count && j - end <= MAX_UNMODIFIED_GAP; ++j) {
+                if (modified_flags[j]) {
+                    end = j + 1;
                 }
-
-                total += size;
             }
 
-            out.seekp(offset + (i << shift_count));
-            out.write((const char*)buffer + (i << shift_count), total);
-            if (out.fail()) {
+            const int length = (end - i) << shift_count;
+            if (!Cache::WriteRange(fd, span(buffer + (i << shift_count), length), offset + (i << shift_count))) {
                 return false;
             }
+            write_back_byte_count += length;
 
             // Next unmodified sector
-            i = j;
+            i = end;
         } else {
             ++i;
         }
     }
 
+    ClearModified();
+
+    return true;
+}
+
+void DiskTrack::ClearModified()
+{
     ranges::fill(modified_flags, 0);
     is_modified = false;
+    modified_count = 0;
+}
 
-    return true;
+void DiskTrack::SetModified(int start, int end)
+{
+    for (int i = start; i < end; ++i) {
+        if (!modified_flags[i]) {
+            modified_flags[i] = 1;
+            ++modified_count;
+        }
+    }
+
+    is_modified = modified_count;
+}
+
+// The range from the first to the last modified sector
+pair<int, int> DiskTrack::GetModifiedRange() const
+{
+    const auto &first = ranges::find(modified_flags, 1);
+    if (first == modified_flags.end()) {
+        return {0, 0};
+    }
+
+    const auto &last = ranges::find(modified_flags | views::reverse, 1);
+
+    return {static_cast<int>(first - modified_flags.begin()), static_cast<int>(modified_flags.rend() - last)};
 }
 
-int DiskTrack::ReadSector(data_in_t buf, int sector) const
+int DiskTrack::ReadSectors(data_in_t buf, int sector, int count) const
 {
-    assert(sector >= 0 && sector < 256);
+    assert(sector >= 0 && sector < (1 << track_shift_count));
+    assert(count > 0);
 
-    if (!is_initialized || sector >= sector_count) {
+    if (!is_initialized || sector + count > sector_count) {
         return 0;
     }
 
     assert(buffer);
 
-    const int size = 1 << shift_count;
+    const int size = count << shift_count;
 
     memcpy(buf.data(), buffer + ((off_t)sector << shift_count), size);
 
     return size;
 }
 
-int DiskTrack::WriteSector(data_out_t buf, int sector)
+int DiskTrack::WriteSectors(data_out_t buf, int sector, int count)
 {
-    assert(sector >= 0 && sector < 256);
+    assert(sector >= 0 && sector < (1 << track_shift_count));
+    assert(count > 0);
 
-    if (!is_initialized || sector >= sector_count) {
+    if (!is_initialized || sector + count > sector_count) {
         return 0;
     }
 
     assert(buffer);
 
-    const int offset = sector << shift_count;
     const int size = 1 << shift_count;
 
-    // Check if any data have changed
-    if (memcmp(buf.data(), buffer + offset, size)) {
-        memcpy(buffer + offset, buf.data(), size);
-        modified_flags[sector] = 1;
-        is_modified = true;
+    for (int i = 0; i < count; ++i) {
+        const int offset = (sector + i) << shift_count;
+
+        // Check if any data have changed
+        if (memcmp(buf.data() + (i << shift_count), buffer + offset, size)) {
+            memcpy(buffer + offset, buf.data() + (i << shift_count), size);
+            if (!modified_flags[sector + i]) {
+                modified_flags[sector + i] = 1;
+                ++modified_count;
+            }
+            is_modified = true;
+        }
     }
 
-    return size;
+    return count << shift_count;
 }
@@ -13,7 +13,6 @@
 
 #pragma once
 
-#include <string>
 #include <vector>
 #include "shared/s2p_defs.h"
 
@@ -33,12 +32,16 @@ private:
 
     friend class DiskCache;
 
-    void Init(int, int, int);
-    bool Load(const string&, uint64_t&);
-    bool Save(const string&, uint64_t&);
+    void Init(int, int, int, int);
+    bool Load(int, uint64_t&);
+    bool Save(int, uint64_t&, uint64_t&);
 
-    int ReadSector(data_in_t, int) const;
-    int WriteSector(data_out_t, int);
+    int ReadSectors(data_in_t, int, int) const;
+    int WriteSectors(data_out_t, int, int);
+
+    void ClearModified();
+    void SetModified(int, int);
+    pair<int, int> GetModifiedRange() const;
 
     int GetTrack() const
     {
@@ -50,7 +53,10 @@ private:
     // 8 = 256, 9 = 512, 10 = 1024, 11 = 2048, 12 = 4096
     int shift_count = 0;
 
-    // < 256
+    // The nominal number of sectors per track as a power of 2 (8 = 256 sectors)
+    int track_shift_count = 8;
+
+    // <= nominal number of sectors per track
     int sector_count = 0;
 
     uint8_t *buffer = nullptr;
@@ -61,6 +67,14 @@ private:
 
     bool is_modified = false;
 
+    int modified_count = 0;
+
+    // Loaded by the prefetcher and not accessed since
+    bool is_prefetched = false;
+
     // Do not use bool here in order to avoid special rules for vector<bool>
     vector<uint8_t> modified_flags;
+
+    // Up to this number of unmodified sectors between modified sectors are written together with them
+    static constexpr int MAX_UNMODIFIED_GAP = 8;
 };
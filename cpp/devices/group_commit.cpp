@@ -0,0 +1,100 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "group_commit.h"
+#include <vector>
+#include <unistd.h>
+
+GroupCommit::~GroupCommit()
+{
+    {
+        scoped_lock<mutex> lock(sync_mutex);
+        stop = true;
+    }
+    sync_condition.notify_one();
+
+    if (sync_thread.joinable()) {
+        sync_thread.join();
+    }
+}
+
+void GroupCommit::Start()
+{
+#ifndef __APPLE__
+    sync_thread = jthread([this]() {Execute();});
+#else
+    sync_thread = thread([this] () { Execute(); } );
+#endif
+}
+
+bool GroupCommit::Sync(int fd)
+{
+    if (fd == -1) {
+        return false;
+    }
+
+    unique_lock<mutex> lock(sync_mutex);
+
+    if (!sync_thread.joinable()) {
+        Start();
+    }
+
+    pending_fds.insert(fd);
+    const uint64_t group = next_group;
+    sync_condition.notify_one();
+
+    completed_condition.wait(lock, [this, group] {return completed_group >= group;});
+
+    const auto &it = failed_groups.find(fd);
+    return it == failed_groups.end() || it->second != group;
+}
+
+uint64_t GroupCommit::GetSyncCount()
+{
+    scoped_lock<mutex> lock(sync_mutex);
+
+    return sync_count;
+}
+
+void GroupCommit::Execute()
+{
+    unique_lock<mutex> lock(sync_mutex);
+
+    while (true) {
+        sync_condition.wait(lock, [this] {return stop || !pending_fds.empty();});
+        if (stop) {
+            return;
+        }
+
+        // New requests go to the next group while this group is being synced
+        unordered_set<int> fds;
+        fds.swap(pending_fds);
+        const uint64_t group = next_group++;
+
+        lock.unlock();
+        vector<int> failed_fds;
+        for (const int fd : fds) {
+#ifdef __linux__
+            if (fdatasync(fd) == -1) {
+#else
+            if (fsync(fd) == -1) {
+#endif
+                failed_fds.push_back(fd);
+            }
+        }
+        lock.lock();
+
+        for (const int fd : failed_fds) {
+            failed_groups[fd] = group;
+        }
+        sync_count += fds.size();
+        completed_group = group;
+
+        completed_condition.notify_all();
+    }
+}
@@ -0,0 +1,77 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// Makes data written to image files durable with fdatasync() on a background thread.
+// Requests arriving while a group of files is being synced are merged into the next group,
+// in which each file is synced only once, no matter how many devices requested it.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+class GroupCommit
+{
+
+public:
+
+    static GroupCommit& Instance()
+    {
+        static GroupCommit instance; // NOSONAR instance cannot be inlined
+        return instance;
+    }
+
+    ~GroupCommit();
+    GroupCommit(GroupCommit&) = delete;
+    GroupCommit& operator=(const GroupCommit&) = delete;
+
+    // Blocks until the data written to the file before the call are durable
+    bool Sync(int);
+
+    uint64_t GetSyncCount();
+
+private:
+
+    GroupCommit() = default;
+
+    void Start();
+    void Execute();
+
+    // The files to be synced with the next group
+    unordered_set<int> pending_fds;
+
+    // The number of the most recent group in which syncing a file failed
+    unordered_map<int, uint64_t> failed_groups;
+
+    // The group collecting the current requests and the most recent completed group
+    uint64_t next_group = 1;
+    uint64_t completed_group = 0;
+
+    uint64_t sync_count = 0;
+
+    bool stop = false;
+
+    mutex sync_mutex;
+
+    // Wakes up the sync thread
+    condition_variable sync_condition;
+
+    // Signals the completion of a group
+    condition_variable completed_condition;
+
+#ifndef __APPLE__
+    jthread sync_thread;
+#else
+    thread sync_thread;
+#endif
+};
@@ -0,0 +1,76 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "latency_histogram.h"
+
+uint64_t LatencyHistogram::GetPercentile(int percentile) const
+{
+    const uint64_t total = GetCount();
+    if (!total) {
+        return 0;
+    }
+
+    // The rank of the requested value, rounded up
+    const uint64_t rank = (total * percentile + 99) / 100;
+
+    uint64_t sum = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        sum += buckets[bucket].load(memory_order_relaxed);
+        if (sum >= rank) {
+            return min(GetBucketLimit(bucket), GetMax());
+        }
+    }
+
+    // The counters may be updated while they are summed up
+    return GetMax();
+}
+
+void LatencyHistogram::AddStatistics(vector<PbStatistics> &statistics, const string &name) const
+{
+    if (!GetCount()) {
+        return;
+    }
+
+    PbStatistics s;
+    s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+    s.set_key(name + "_latency_count");
+    s.set_value(GetCount());
+    statistics.push_back(s);
+
+    s.set_key(name + "_latency_p50_us");
+    s.set_value(GetPercentile(50));
+    statistics.push_back(s);
+
+    s.set_key(name + "_latency_p99_us");
+    s.set_value(GetPercentile(99));
+    statistics.push_back(s);
+
+    s.set_key(name + "_latency_max_us");
+    s.set_value(GetMax());
+    statistics.push_back(s);
+
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        if (const uint64_t n = buckets[bucket].load(memory_order_relaxed); n) {
+            s.set_key(name + "_latency_le_" + to_string(GetBucketLimit(bucket)) + "_us");
+            s.set_value(n);
+            statistics.push_back(s);
+        }
+    }
+}
+
+uint64_t LatencyHistogram::GetBucketLimit(int bucket)
+{
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+
+    const int shift = bucket / SUB_BUCKETS - 1;
+    const uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + (1ULL << shift) - 1;
+}
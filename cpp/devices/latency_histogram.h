@@ -0,0 +1,84 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// A log-linear histogram of latencies in microseconds. Each power of two is divided into 4 buckets, i.e. the
+// resolution is 25% at most. Recording a latency only increments relaxed atomic counters, so that the
+// histogram can be updated on the hot path and concurrently by background threads.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <string>
+#include "generated/s2p_interface.pb.h"
+
+using namespace std;
+using namespace s2p_interface;
+
+class LatencyHistogram
+{
+
+public:
+
+    // Records the time elapsed since the specified start time
+    void Record(chrono::steady_clock::time_point start)
+    {
+        Record(
+            static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count()));
+    }
+
+    void Record(uint64_t latency)
+    {
+        buckets[GetBucket(latency)].fetch_add(1, memory_order_relaxed);
+        count.fetch_add(1, memory_order_relaxed);
+
+        uint64_t m = max_latency.load(memory_order_relaxed);
+        while (latency > m && !max_latency.compare_exchange_weak(m, latency, memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t GetCount() const
+    {
+        return count.load(memory_order_relaxed);
+    }
+    uint64_t GetMax() const
+    {
+        return max_latency.load(memory_order_relaxed);
+    }
+
+    // The upper limit of the bucket containing the specified percentile, 0 if nothing was recorded
+    uint64_t GetPercentile(int) const;
+
+    // Adds the count, p50, p99, the maximum and the non-empty buckets, nothing if nothing was recorded
+    void AddStatistics(vector<PbStatistics>&, const string&) const;
+
+    static int GetBucket(uint64_t latency)
+    {
+        if (latency < SUB_BUCKETS) {
+            return static_cast<int>(latency);
+        }
+
+        const int exponent = bit_width(latency) - 1;
+        return (exponent - 1) * SUB_BUCKETS + static_cast<int>((latency >> (exponent - 2)) & (SUB_BUCKETS - 1));
+    }
+
+    // The largest latency in the specified bucket
+    static uint64_t GetBucketLimit(int);
+
+    static constexpr int SUB_BUCKETS = 4;
+    static constexpr int BUCKET_COUNT = 63 * SUB_BUCKETS;
+
+private:
+
+    array<atomic<uint64_t>, BUCKET_COUNT> buckets = { };
+
+    atomic<uint64_t> count;
+    atomic<uint64_t> max_latency;
+};
@@ -7,6 +7,19 @@
 //---------------------------------------------------------------------------
 
 #include "linux_cache.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include "group_commit.h"
+
+LinuxCache::~LinuxCache()
+{
+    // The prefetcher must not access the image file anymore
+    prefetcher.reset();
+
+    if (fd != -1) {
+        close(fd);
+    }
+}
 
 bool LinuxCache::Init()
 {
@@ -14,13 +27,32 @@ bool LinuxCache::Init()
         return false;
     }
 
-    file.open(filename, ios::in | ios::out | ios::binary);
-    return file.good();
+    fd = open(filename.c_str(), O_RDWR);
+    if (fd == -1) {
+        return false;
+    }
+
+    prefetcher = make_unique<Prefetcher>([this](uint64_t start, uint64_t count) {Prefetch(start, count);},
+        MAX_PREFETCH_BYTES / sector_size);
+
+    return true;
 }
 
 int LinuxCache::ReadSectors(data_in_t buf, uint64_t start, uint32_t count)
 {
-    return sectors < start + count ? 0 : Read(buf, start, sector_size * count);
+    if (sectors < start + count) {
+        return 0;
+    }
+
+    if (prefetcher) {
+        if (prefetcher->IsPrefetched(start, count)) {
+            ++prefetch_hit_count;
+        }
+
+        prefetcher->Update(start, count);
+    }
+
+    return Read(buf, start, sector_size * count);
 }
 
 int LinuxCache::WriteSectors(data_out_t buf, uint64_t start, uint32_t count)
@@ -38,18 +70,28 @@ int LinuxCache::WriteLong(data_out_t buf, uint64_t start, int length)
     return sectors <= start ? 0 : Write(buf, start, length);
 }
 
+// The data are read directly into the caller's buffer, there is no intermediate stream buffer
 int LinuxCache::Read(data_in_t buf, uint64_t start, int length)
 {
     assert(length);
 
-    file.seekg(sector_size * start);
-    file.read((char*)buf.data(), length);
-    if (file.fail()) {
-        file.clear();
-        ++read_error_count;
-        return 0;
+    const off_t offset = sector_size * start;
+    for (int count = 0; count < length;) {
+        // Reading beyond the end of the image file is an error
+        const ssize_t n = pread(fd, buf.data() + count, length - count, offset + count);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+
+            ++read_error_count;
+            return 0;
+        }
+        count += static_cast<int>(n);
     }
 
+    served_read_byte_count += length;
+
     return length;
 }
 
@@ -57,26 +99,35 @@ int LinuxCache::Write(data_out_t buf, uint64_t start, int length)
 {
     assert(length);
 
-    file.seekp(sector_size * start);
-    file.write((const char*)buf.data(), length);
-    if (file.fail()) {
-        file.clear();
-        ++write_error_count;
-        return 0;
+    const off_t offset = sector_size * start;
+    for (int count = 0; count < length;) {
+        const ssize_t n = pwrite(fd, buf.data() + count, length - count, offset + count);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+
+            ++write_error_count;
+            return 0;
+        }
+        count += static_cast<int>(n);
     }
 
-    if (write_through) {
-        return Flush() ? length : 0;
+    served_write_byte_count += length;
+
+    if (write_through && !Flush()) {
+        return 0;
     }
 
+    ReleaseWritten(offset, length);
+
     return length;
 }
 
 bool LinuxCache::Flush()
 {
-    file.flush();
-    if (file.fail()) {
-        file.clear();
+    // The data have already been passed to the kernel, they are not durable before being synced
+    if (fd != -1 && !GroupCommit::Instance().Sync(fd)) {
         ++write_error_count;
         return false;
     }
@@ -84,12 +135,69 @@ bool LinuxCache::Flush()
     return true;
 }
 
+// Large sequential writes, e.g. when an initiator restores a backup, are unlikely to be read again soon and
+// should not displace the data that are. Advising the kernel not to keep them initiates writing back the
+// modified pages, which are dropped from the page cache as soon as they are clean.
+void LinuxCache::ReleaseWritten(off_t offset, int length)
+{
+    if (offset != write_stream_end) {
+        write_stream_start = offset;
+    }
+    write_stream_end = offset + length;
+
+    if (write_stream_end - write_stream_start >= RELEASE_WRITTEN_BYTES) {
+#ifdef __linux__
+        posix_fadvise(fd, write_stream_start, write_stream_end - write_stream_start, POSIX_FADV_DONTNEED);
+#endif
+        write_stream_start = write_stream_end;
+    }
+}
+
+// Called by the prefetcher thread. Prefetching errors are not reported, reading the data on demand will report them.
+void LinuxCache::Prefetch(uint64_t start, uint64_t count)
+{
+    const uint64_t end = min(start + count, sectors);
+    if (start >= end) {
+        return;
+    }
+
+#ifdef __linux__
+    // Let the kernel read ahead, the data do not have to be copied to user space
+    posix_fadvise(fd, start * sector_size, (end - start) * sector_size, POSIX_FADV_WILLNEED);
+#else
+    // Reading the data is sufficient for the kernel to cache them
+    vector<uint8_t> buf((end - start) * sector_size);
+    pread(fd, buf.data(), buf.size(), start * sector_size);
+#endif
+}
+
 vector<PbStatistics> LinuxCache::GetStatistics(bool is_read_only) const
 {
     vector<PbStatistics> statistics;
 
     PbStatistics s;
 
+    s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+    s.set_key(PREFETCH_HIT_COUNT);
+    s.set_value(prefetch_hit_count);
+    statistics.push_back(s);
+
+    // The data are cached by the kernel, only the page cache residency of the image file is known
+    s.set_key(CACHE_RESIDENT_BYTES);
+    s.set_value(GetResidentBytes(fd, sectors * sector_size));
+    statistics.push_back(s);
+
+    s.set_key(SERVED_READ_BYTE_COUNT);
+    s.set_value(served_read_byte_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(SERVED_WRITE_BYTE_COUNT);
+        s.set_value(served_write_byte_count);
+        statistics.push_back(s);
+    }
+
     s.set_category(PbStatisticsCategory::CATEGORY_ERROR);
 
     s.set_key(READ_ERROR_COUNT);
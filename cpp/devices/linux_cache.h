@@ -8,8 +8,8 @@
 
 #pragma once
 
-#include <fstream>
 #include "cache.h"
+#include "prefetcher.h"
 
 class LinuxCache : public Cache
 {
@@ -20,7 +20,7 @@ public:
     : filename(f), sector_size(size), sectors(s), write_through(w)
     {
     }
-    ~LinuxCache() override = default;
+    ~LinuxCache() override;
 
     int ReadSectors(data_in_t, uint64_t, uint32_t) override;
     int WriteSectors(data_out_t, uint64_t, uint32_t) override;
@@ -39,9 +39,15 @@ private:
     int Read(data_in_t, uint64_t, int);
     int Write(data_out_t, uint64_t, int);
 
+    void Prefetch(uint64_t, uint64_t);
+    void ReleaseWritten(off_t, int);
+
     string filename;
 
-    fstream file;
+    // Shared by the prefetcher thread, which only uses positional I/O
+    int fd = -1;
+
+    unique_ptr<Prefetcher> prefetcher;
 
     int sector_size;
 
@@ -51,4 +57,17 @@ private:
 
     uint64_t read_error_count = 0;
     uint64_t write_error_count = 0;
+    uint64_t prefetch_hit_count = 0;
+    uint64_t served_read_byte_count = 0;
+    uint64_t served_write_byte_count = 0;
+
+    // The range of the image file written by the current sequential write stream, in bytes
+    off_t write_stream_start = 0;
+    off_t write_stream_end = 0;
+
+    // Sequential reads make the kernel page cache hold up to this number of bytes ahead of the current position
+    static constexpr int MAX_PREFETCH_BYTES = 1024 * 1024;
+
+    // Sequential writes of at least this number of bytes are not kept in the page cache
+    static constexpr int RELEASE_WRITTEN_BYTES = 4 * 1024 * 1024;
 };
@@ -0,0 +1,218 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "mmap_cache.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+MmapCache::~MmapCache()
+{
+    Release();
+}
+
+bool MmapCache::Init()
+{
+    if (!sector_size || !sectors || filename.empty()) {
+        return false;
+    }
+
+    Release();
+
+    // The image size may not fit into the address space, in particular on 32-bit platforms
+    if (sectors > SIZE_MAX / sector_size) {
+        return false;
+    }
+
+    is_writable = true;
+    int fd = open(filename.c_str(), O_RDWR);
+    if (fd == -1) {
+        // Read-only image files can still be read
+        is_writable = false;
+        fd = open(filename.c_str(), O_RDONLY);
+    }
+
+    if (fd == -1) {
+        return false;
+    }
+
+    mapping_size = sectors * sector_size;
+    void *m = mmap(nullptr, mapping_size, is_writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping remains valid after the file has been closed
+    close(fd);
+
+    if (m == MAP_FAILED) {
+        mapping_size = 0;
+        return false;
+    }
+
+    mapping = shared_ptr<uint8_t>(static_cast<uint8_t*>(m), [size = mapping_size](uint8_t *p) {munmap(p, size);});
+
+    return true;
+}
+
+void MmapCache::Release()
+{
+    if (mapping) {
+        Flush();
+        mapping.reset();
+    }
+}
+
+int MmapCache::ReadSectors(data_in_t buf, uint64_t start, uint32_t count)
+{
+    if (!mapping || sectors < start + count) {
+        return 0;
+    }
+
+    UpdateAdvice(start, count);
+
+    const int length = sector_size * count;
+    memcpy(buf.data(), mapping.get() + start * sector_size, length);
+
+    served_read_byte_count += length;
+
+    return length;
+}
+
+pair<data_out_t, shared_ptr<const void>> MmapCache::BorrowSectors(uint64_t start, uint32_t count)
+{
+    if (!mapping || !count || sectors < start + count) {
+        return {};
+    }
+
+    UpdateAdvice(start, count);
+
+    served_read_byte_count += static_cast<uint64_t>(sector_size) * count;
+
+    const uint8_t *data = mapping.get() + start * sector_size;
+    return {data_out_t(data, static_cast<size_t>(sector_size) * count), shared_ptr<const void>(mapping, data)};
+}
+
+int MmapCache::WriteSectors(data_out_t buf, uint64_t start, uint32_t count)
+{
+    if (!mapping || !is_writable || sectors < start + count) {
+        return 0;
+    }
+
+    const size_t offset = start * sector_size;
+    const int length = sector_size * count;
+    memcpy(mapping.get() + offset, buf.data(), length);
+
+    served_write_byte_count += length;
+
+    if (dirty_start == dirty_end) {
+        dirty_start = offset;
+        dirty_end = offset + length;
+    }
+    else {
+        dirty_start = min(dirty_start, offset);
+        dirty_end = max(dirty_end, offset + length);
+    }
+
+    return length;
+}
+
+bool MmapCache::Flush()
+{
+    if (dirty_start == dirty_end) {
+        return true;
+    }
+
+    // msync() requires a page-aligned address
+    const size_t start = dirty_start - dirty_start % getpagesize();
+    const bool success = msync(mapping.get() + start, dirty_end - start, MS_SYNC) != -1;
+    if (success) {
+        write_back_byte_count += dirty_end - dirty_start;
+        dirty_start = 0;
+        dirty_end = 0;
+    }
+    else {
+        ++write_error_count;
+    }
+
+    return success;
+}
+
+// Sequential access (e.g. a dump) makes the kernel read ahead aggressively, random access
+// (e.g. an HFS catalog) makes it read only the pages actually accessed
+void MmapCache::UpdateAdvice(uint64_t start, uint32_t count)
+{
+    if (start == next_sector) {
+        ++sequential_commands;
+        random_commands = 0;
+    }
+    else {
+        ++random_commands;
+        sequential_commands = 0;
+    }
+
+    next_sector = start + count;
+
+    Advice a = advice;
+    if (sequential_commands >= MIN_SEQUENTIAL_COMMANDS) {
+        a = Advice::SEQUENTIAL;
+    }
+    else if (random_commands >= MIN_RANDOM_COMMANDS) {
+        a = Advice::RANDOM;
+    }
+
+    if (a != advice) {
+        advice = a;
+        madvise(mapping.get(), mapping_size, advice == Advice::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+}
+
+vector<PbStatistics> MmapCache::GetStatistics(bool is_read_only) const
+{
+    vector<PbStatistics> statistics;
+
+    PbStatistics s;
+
+    s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+    // The mapped pages are cached by the kernel
+    s.set_key(CACHE_RESIDENT_BYTES);
+    s.set_value(mapping ? GetResidentBytes(mapping.get(), mapping_size) : 0);
+    statistics.push_back(s);
+
+    s.set_key(SERVED_READ_BYTE_COUNT);
+    s.set_value(served_read_byte_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        // The modified range not synchronized yet, which may include unmodified data
+        s.set_key(CACHE_DIRTY_BYTES);
+        s.set_value(dirty_end - dirty_start);
+        statistics.push_back(s);
+
+        s.set_key(SERVED_WRITE_BYTE_COUNT);
+        s.set_value(served_write_byte_count);
+        statistics.push_back(s);
+
+        s.set_key(WRITE_BACK_BYTE_COUNT);
+        s.set_value(write_back_byte_count);
+        statistics.push_back(s);
+    }
+
+    s.set_category(PbStatisticsCategory::CATEGORY_ERROR);
+
+    s.set_key(READ_ERROR_COUNT);
+    s.set_value(read_error_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(WRITE_ERROR_COUNT);
+        s.set_value(write_error_count);
+        statistics.push_back(s);
+    }
+
+    return statistics;
+}
@@ -0,0 +1,82 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// A cache that maps the whole image file into memory. There is no buffering in addition
+// to the kernel page cache, the data are copied straight from and into the mapping.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include "cache.h"
+
+class MmapCache : public Cache
+{
+
+public:
+
+    MmapCache(const string &f, int size, uint64_t s)
+    : filename(f), sector_size(size), sectors(s)
+    {
+    }
+    ~MmapCache() override;
+
+    int ReadSectors(data_in_t, uint64_t, uint32_t) override;
+    int WriteSectors(data_out_t, uint64_t, uint32_t) override;
+    pair<data_out_t, shared_ptr<const void>> BorrowSectors(uint64_t, uint32_t) override;
+
+    bool Init() override;
+
+    bool Flush() override;
+
+    vector<PbStatistics> GetStatistics(bool) const override;
+
+private:
+
+    enum class Advice
+    {
+        NORMAL,
+        SEQUENTIAL,
+        RANDOM
+    };
+
+    void Release();
+
+    void UpdateAdvice(uint64_t, uint32_t);
+
+    string filename;
+
+    int sector_size;
+
+    uint64_t sectors;
+
+    // Borrowed data share the ownership of the mapping, which is unmapped when the last owner releases it
+    shared_ptr<uint8_t> mapping;
+
+    size_t mapping_size = 0;
+
+    bool is_writable = false;
+
+    // The range of bytes modified since the last flush
+    size_t dirty_start = 0;
+    size_t dirty_end = 0;
+
+    // The access pattern detector state, the kernel is only advised when the pattern changes
+    uint64_t next_sector = 0;
+    int sequential_commands = 0;
+    int random_commands = 0;
+    Advice advice = Advice::NORMAL;
+
+    uint64_t read_error_count = 0;
+    uint64_t write_error_count = 0;
+    uint64_t served_read_byte_count = 0;
+    uint64_t served_write_byte_count = 0;
+    uint64_t write_back_byte_count = 0;
+
+    // The number of consecutive sequential or random commands that change the advice for the kernel
+    static constexpr int MIN_SEQUENTIAL_COMMANDS = 2;
+    static constexpr int MIN_RANDOM_COMMANDS = 4;
+};
@@ -0,0 +1,267 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "overlay_cache.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "shared/memory_util.h"
+
+using namespace memory_util;
+
+OverlayCache::~OverlayCache()
+{
+    if (delta_fd != -1) {
+        close(delta_fd);
+    }
+
+    if (base_fd != -1) {
+        close(base_fd);
+    }
+}
+
+bool OverlayCache::Init()
+{
+    if (!sector_size || !sectors || delta_filename.empty() || base_filename.empty() || delta_fd != -1) {
+        return false;
+    }
+
+    // The base image is never written to, its data are cached by the kernel only once for all devices
+    base_fd = open(base_filename.c_str(), O_RDONLY);
+    if (base_fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(base_fd, &st) || static_cast<uint64_t>(st.st_size) < sectors * sector_size) {
+        return false;
+    }
+
+    is_writable = true;
+    delta_fd = open(delta_filename.c_str(), O_RDWR);
+    if (delta_fd == -1) {
+        // Read-only delta files can still be read
+        is_writable = false;
+        delta_fd = open(delta_filename.c_str(), O_RDONLY);
+    }
+
+    if (delta_fd == -1 || fstat(delta_fd, &st)) {
+        return false;
+    }
+
+    return st.st_size ? LoadDelta() : InitDelta();
+}
+
+bool OverlayCache::InitDelta()
+{
+    if (!is_writable) {
+        return false;
+    }
+
+    vector<uint8_t> header(HEADER_SIZE);
+    memcpy(header.data(), MAGIC, sizeof(MAGIC));
+    SetInt32(header, 8, VERSION);
+    SetInt32(header, 12, sector_size);
+    SetInt64(header, 16, sectors);
+    SetInt32(header, 24, block_sectors);
+
+    SizeIndex();
+
+    // Until blocks are written the index is a hole in the sparse delta file
+    return pwrite(delta_fd, header.data(), header.size(), 0) == HEADER_SIZE && !ftruncate(delta_fd, data_offset);
+}
+
+bool OverlayCache::LoadDelta()
+{
+    vector<uint8_t> header(HEADER_SIZE);
+    if (pread(delta_fd, header.data(), header.size(), 0) != HEADER_SIZE || memcmp(header.data(), MAGIC, sizeof(MAGIC))
+        || GetInt32(header, 8) != VERSION) {
+        return false;
+    }
+
+    // The delta file must have been created for a base image with the same geometry
+    if (GetInt32(header, 12) != static_cast<uint32_t>(sector_size) || GetInt64(header, 16) != sectors) {
+        return false;
+    }
+
+    block_sectors = GetInt32(header, 24);
+    if (!block_sectors) {
+        return false;
+    }
+
+    SizeIndex();
+
+    vector<uint8_t> index(block_index.size() * sizeof(uint32_t));
+    if (pread(delta_fd, index.data(), index.size(), HEADER_SIZE) != static_cast<ssize_t>(index.size())) {
+        return false;
+    }
+
+    for (size_t block = 0; block < block_index.size(); ++block) {
+        block_index[block] = GetInt32(index, static_cast<int>(block * sizeof(uint32_t)));
+        allocated_blocks = max(allocated_blocks, block_index[block]);
+    }
+
+    return true;
+}
+
+void OverlayCache::SizeIndex()
+{
+    block_index.assign((sectors + block_sectors - 1) / block_sectors, 0);
+
+    data_offset = HEADER_SIZE
+        + (block_index.size() * sizeof(uint32_t) + HEADER_SIZE - 1) / HEADER_SIZE * HEADER_SIZE;
+}
+
+off_t OverlayCache::GetDeltaOffset(uint32_t entry, uint64_t sector) const
+{
+    return data_offset + (static_cast<off_t>(entry - 1) * block_sectors + sector % block_sectors) * sector_size;
+}
+
+int OverlayCache::ReadSectors(data_in_t buf, uint64_t start, uint32_t count)
+{
+    if (delta_fd == -1 || sectors < start + count) {
+        return 0;
+    }
+
+    int offset = 0;
+
+    // Process the sectors block by block, blocks not written are read from the base image
+    while (count) {
+        uint32_t n = min(count, static_cast<uint32_t>(block_sectors - start % block_sectors));
+
+        ssize_t length;
+        if (const uint32_t entry = block_index[start / block_sectors]; entry) {
+            length = pread(delta_fd, buf.data() + offset, n * sector_size, GetDeltaOffset(entry, start));
+        }
+        else {
+            // Adjacent blocks not written are read with a single read
+            while (n < count && !block_index[(start + n) / block_sectors]) {
+                n = min(count, n + block_sectors);
+            }
+
+            length = pread(base_fd, buf.data() + offset, n * sector_size, static_cast<off_t>(start) * sector_size);
+        }
+
+        if (length != static_cast<ssize_t>(n * sector_size)) {
+            ++read_error_count;
+            return 0;
+        }
+
+        offset += length;
+        start += n;
+        count -= n;
+    }
+
+    return offset;
+}
+
+int OverlayCache::WriteSectors(data_out_t buf, uint64_t start, uint32_t count)
+{
+    if (!is_writable || sectors < start + count) {
+        return 0;
+    }
+
+    int offset = 0;
+
+    // Process the sectors block by block, the first write to a block copies it to the delta file
+    while (count) {
+        const uint32_t n = min(count, static_cast<uint32_t>(block_sectors - start % block_sectors));
+        const auto &data = buf.subspan(offset, n * sector_size);
+
+        if (const uint32_t entry = block_index[start / block_sectors]; entry) {
+            if (pwrite(delta_fd, data.data(), data.size(), GetDeltaOffset(entry, start))
+                != static_cast<ssize_t>(data.size())) {
+                ++write_error_count;
+                return 0;
+            }
+        }
+        else if (!AllocateBlock(start / block_sectors, data, start)) {
+            ++write_error_count;
+            return 0;
+        }
+
+        offset += data.size();
+        start += n;
+        count -= n;
+    }
+
+    return offset;
+}
+
+bool OverlayCache::AllocateBlock(uint64_t block, data_out_t data, uint64_t start)
+{
+    const uint64_t first = block * block_sectors;
+    vector<uint8_t> block_data((min(first + block_sectors, sectors) - first) * sector_size);
+
+    // The sectors not written by this command are copied from the base image
+    if (data.size() != block_data.size()
+        && pread(base_fd, block_data.data(), block_data.size(), static_cast<off_t>(first) * sector_size)
+            != static_cast<ssize_t>(block_data.size())) {
+        return false;
+    }
+
+    memcpy(block_data.data() + (start - first) * sector_size, data.data(), data.size());
+
+    const uint32_t entry = allocated_blocks + 1;
+    if (pwrite(delta_fd, block_data.data(), block_data.size(), GetDeltaOffset(entry, first))
+        != static_cast<ssize_t>(block_data.size())) {
+        return false;
+    }
+
+    // The index entry is written last, so that it never references a block without data
+    vector<uint8_t> index_entry(sizeof(uint32_t));
+    SetInt32(index_entry, 0, entry);
+    if (pwrite(delta_fd, index_entry.data(), index_entry.size(), HEADER_SIZE + block * sizeof(uint32_t))
+        != static_cast<ssize_t>(index_entry.size())) {
+        return false;
+    }
+
+    block_index[block] = entry;
+    allocated_blocks = entry;
+
+    return true;
+}
+
+bool OverlayCache::Flush()
+{
+    if (!is_writable || fsync(delta_fd) != -1) {
+        return true;
+    }
+
+    ++write_error_count;
+
+    return false;
+}
+
+vector<PbStatistics> OverlayCache::GetStatistics(bool is_read_only) const
+{
+    vector<PbStatistics> statistics;
+
+    PbStatistics s;
+
+    s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+    s.set_key(OVERLAY_BLOCK_COUNT);
+    s.set_value(allocated_blocks);
+    statistics.push_back(s);
+
+    s.set_category(PbStatisticsCategory::CATEGORY_ERROR);
+
+    s.set_key(READ_ERROR_COUNT);
+    s.set_value(read_error_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(WRITE_ERROR_COUNT);
+        s.set_value(write_error_count);
+        statistics.push_back(s);
+    }
+
+    return statistics;
+}
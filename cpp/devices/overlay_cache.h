@@ -0,0 +1,89 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// A copy-on-write overlay, consisting of a read-only base image, which can be shared by several devices,
+// and a sparse delta file with the data written by a single device. The delta file starts with a header
+// and a block allocation index, followed by the blocks written so far in the order of their allocation.
+// A block not in the index is read from the base image. An empty delta file is initialized on demand.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include "cache.h"
+
+class OverlayCache : public Cache
+{
+
+public:
+
+    OverlayCache(const string &d, const string &b, int size, uint64_t s)
+    : delta_filename(d), base_filename(b), sector_size(size), sectors(s)
+    {
+    }
+    ~OverlayCache() override;
+
+    int ReadSectors(data_in_t, uint64_t, uint32_t) override;
+    int WriteSectors(data_out_t, uint64_t, uint32_t) override;
+
+    bool Init() override;
+
+    bool Flush() override;
+
+    vector<PbStatistics> GetStatistics(bool) const override;
+
+    // The number of blocks stored in the delta file
+    uint32_t GetAllocatedBlocks() const
+    {
+        return allocated_blocks;
+    }
+
+    // The number of sectors per block
+    static constexpr uint32_t BLOCK_SECTORS = 128;
+
+private:
+
+    bool InitDelta();
+    bool LoadDelta();
+    void SizeIndex();
+
+    off_t GetDeltaOffset(uint32_t, uint64_t) const;
+    bool AllocateBlock(uint64_t, data_out_t, uint64_t);
+
+    string delta_filename;
+    string base_filename;
+
+    int delta_fd = -1;
+    int base_fd = -1;
+
+    int sector_size;
+
+    uint64_t sectors;
+
+    uint32_t block_sectors = BLOCK_SECTORS;
+
+    // The block allocation index, base image block numbers mapped to 1-based delta file block numbers, 0 means
+    // that the block has not been written
+    vector<uint32_t> block_index;
+
+    uint32_t allocated_blocks = 0;
+
+    // The offset of the first block in the delta file
+    off_t data_offset = 0;
+
+    bool is_writable = false;
+
+    uint64_t read_error_count = 0;
+    uint64_t write_error_count = 0;
+
+    static constexpr const char *OVERLAY_BLOCK_COUNT = "overlay_block_count";
+
+    static constexpr char MAGIC[] = "S2POVL1";
+    static constexpr uint32_t VERSION = 1;
+
+    // The header and the index start at a page boundary, the index size is a multiple of the page size
+    static constexpr int HEADER_SIZE = 4096;
+};
@@ -0,0 +1,120 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "prefetcher.h"
+
+Prefetcher::Prefetcher(const loader &l, uint64_t w) : load(l), max_window(w)
+{
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        scoped_lock<mutex> lock(prefetch_mutex);
+        stop = true;
+    }
+    prefetch_condition.notify_one();
+
+    if (prefetch_thread.joinable()) {
+        prefetch_thread.join();
+    }
+}
+
+void Prefetcher::Start()
+{
+#ifndef __APPLE__
+    prefetch_thread = jthread([this]() {Execute();});
+#else
+    prefetch_thread = thread([this] () { Execute(); } );
+#endif
+}
+
+void Prefetcher::Update(uint64_t start, uint32_t count)
+{
+    if (!max_window || !count) {
+        return;
+    }
+
+    if (sequential_commands && start == next_sector) {
+        ++sequential_commands;
+        sequential_sectors += count;
+    }
+    else {
+        // A new stream starts, pending requests for the previous stream are obsolete
+        if (sequential_commands >= MIN_SEQUENTIAL_COMMANDS) {
+            scoped_lock<mutex> lock(prefetch_mutex);
+            requests.clear();
+        }
+
+        sequential_commands = 1;
+        sequential_sectors = count;
+        window = 0;
+        prefetch_end = 0;
+    }
+
+    next_sector = start + count;
+
+    if (sequential_commands < MIN_SEQUENTIAL_COMMANDS) {
+        return;
+    }
+
+    // The longer the sequential run lasts, the further ahead the sectors are prefetched
+    window = min(max_window, max(window * 2, static_cast<uint64_t>(count)));
+
+    const uint64_t begin = max(prefetch_end, next_sector);
+    const uint64_t end = next_sector + window;
+    if (end <= begin) {
+        return;
+    }
+
+    prefetch_end = end;
+
+    {
+        scoped_lock<mutex> lock(prefetch_mutex);
+        requests.emplace_back(begin, end - begin);
+    }
+
+    if (!prefetch_thread.joinable()) {
+        Start();
+    }
+
+    prefetch_condition.notify_one();
+}
+
+bool Prefetcher::IsPrefetched(uint64_t start, uint32_t count)
+{
+    scoped_lock<mutex> lock(prefetch_mutex);
+
+    return loaded_end && start >= loaded_start && start + count <= loaded_end;
+}
+
+void Prefetcher::Execute()
+{
+    unique_lock<mutex> lock(prefetch_mutex);
+
+    while (true) {
+        prefetch_condition.wait(lock, [this] {return stop || !requests.empty();});
+        if (stop) {
+            return;
+        }
+
+        const auto [start, count] = requests.front();
+        requests.pop_front();
+
+        // The actual I/O must not block the thread calling Update()
+        lock.unlock();
+        load(start, count);
+        lock.lock();
+
+        // Adjacent ranges extend the range loaded so far
+        if (start != loaded_end) {
+            loaded_start = start;
+        }
+        loaded_end = start + count;
+    }
+}
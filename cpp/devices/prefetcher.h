@@ -0,0 +1,85 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// Detects sequential reads and loads the sectors following the current position
+// on a background thread, before the initiator requests them.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+class Prefetcher
+{
+    // Loads the specified number of sectors starting at the specified sector
+    using loader = function<void(uint64_t, uint64_t)>;
+
+public:
+
+    Prefetcher(const loader&, uint64_t);
+    ~Prefetcher();
+    Prefetcher(Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    void Update(uint64_t, uint32_t);
+
+    bool IsPrefetched(uint64_t, uint32_t);
+
+    void SetMaxWindow(uint64_t w)
+    {
+        max_window = w;
+    }
+    uint64_t GetWindow() const
+    {
+        return window;
+    }
+
+private:
+
+    void Start();
+    void Execute();
+
+    loader load;
+
+    // The maximum number of sectors to prefetch ahead of the current position, 0 disables prefetching
+    uint64_t max_window;
+
+    // The sequential stream detector state, only used by the thread calling Update()
+    uint64_t next_sector = 0;
+    uint64_t sequential_sectors = 0;
+    int sequential_commands = 0;
+    uint64_t window = 0;
+    uint64_t prefetch_end = 0;
+
+    // Pending sector ranges, guarded by the mutex
+    deque<pair<uint64_t, uint64_t>> requests;
+
+    // The most recent range of sectors that has completely been loaded, guarded by the mutex
+    uint64_t loaded_start = 0;
+    uint64_t loaded_end = 0;
+
+    bool stop = false;
+
+    mutex prefetch_mutex;
+
+    condition_variable prefetch_condition;
+
+#ifndef __APPLE__
+    jthread prefetch_thread;
+#else
+    thread prefetch_thread;
+#endif
+
+    // The number of sequential commands required before prefetching starts
+    static constexpr int MIN_SEQUENTIAL_COMMANDS = 2;
+};
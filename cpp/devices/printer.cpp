@@ -31,6 +31,7 @@
 
 #include "printer.h"
 #include <filesystem>
+#include "controllers/buffer_pool.h"
 
 using namespace filesystem;
 using namespace memory_util;
@@ -101,9 +102,10 @@ void Printer::Print()
 
     LogTrace(fmt::format("Expecting to receive {} byte(s) for printing", length));
 
-    if (length > GetController()->GetBuffer().size()) {
-        LogError(fmt::format("Transfer buffer overflow: Buffer size is {0} bytes, {1} byte(s) expected",
-            GetController()->GetBuffer().size(), length));
+    // The data to print are received with a single chunk
+    if (const int max_length = BufferPool::Instance().GetMaxTransferSize(); length > static_cast<uint32_t>(max_length)) {
+        LogError(fmt::format("Transfer buffer overflow: Maximum transfer size is {0} bytes, {1} byte(s) expected",
+            max_length, length));
 
         ++print_error_count;
 
@@ -165,6 +165,18 @@ int ScsiCd::ReadData(data_in_t buf)
     return Disk::ReadData(buf);
 }
 
+pair<data_out_t, shared_ptr<const void>> ScsiCd::ReadAhead(data_in_t buf)
+{
+    // The track has been initialized when the first chunk was read
+    assert(track_initialized);
+
+    if (const auto lba = static_cast<uint32_t>(GetNextSector()); first_lba > lba || last_lba < lba) {
+        throw ScsiException(SenseKey::ILLEGAL_REQUEST, Asc::LBA_OUT_OF_RANGE);
+    }
+
+    return Disk::ReadAhead(buf);
+}
+
 void ScsiCd::LBAtoMSF(uint32_t lba, span<uint8_t> msf)
 {
     // 75 and 75*60 get the remainder
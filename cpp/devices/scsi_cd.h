@@ -25,6 +25,7 @@ public:
     vector<uint8_t> InquiryInternal() const override;
     void ModeSelect(cdb_t, data_out_t, int, int) override;
     int ReadData(data_in_t) override;
+    pair<data_out_t, shared_ptr<const void>> ReadAhead(data_in_t) override;
 
 protected:
 
@@ -388,6 +388,9 @@ int StorageDevice::ModeSense6(cdb_t cdb, data_in_t buf) const
     if (IsProtected()) {
         buf[2] = 0x80;
     }
+    if (IsFuaSupported()) {
+        buf[2] |= 0x10;
+    }
 
     // Basic information
     size = 4;
@@ -431,6 +434,9 @@ int StorageDevice::ModeSense10(cdb_t cdb, data_in_t buf) const
     if (IsProtected()) {
         buf[3] = 0x80;
     }
+    if (IsFuaSupported()) {
+        buf[3] |= 0x10;
+    }
 
     // Basic information
     size = 8;
@@ -83,6 +83,12 @@ public:
         return blocks;
     }
 
+    // Whether the DPOFUA bit of the device-specific parameter is set for MODE SENSE
+    virtual bool IsFuaSupported() const
+    {
+        return false;
+    }
+
     bool ReserveFile() const;
     void UnreserveFile();
 
@@ -133,7 +139,8 @@ protected:
 
     virtual void ChangeBlockSize(uint32_t);
 
-    off_t GetFileSize(bool ignore = false) const;
+    virtual off_t GetFileSize(bool ignore = false) const;
+    virtual bool IsReadOnlyFile() const;
 
     void UpdateReadCount(uint64_t count)
     {
@@ -153,8 +160,6 @@ private:
     void StartStopUnit();
     void PreventAllowMediumRemoval();
 
-    bool IsReadOnlyFile() const;
-
     int ModeSense6(cdb_t, data_in_t) const override;
     int ModeSense10(cdb_t, data_in_t) const override;
 
@@ -0,0 +1,593 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "uring_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+UringCache::~UringCache()
+{
+    ReleaseRing();
+
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+bool UringCache::IsAvailable()
+{
+#ifdef __linux__
+    static const bool is_available = [] {
+        io_uring_params params = { };
+        const int f = static_cast<int>(syscall(__NR_io_uring_setup, 1, &params));
+        if (f == -1) {
+            return false;
+        }
+        close(f);
+
+        // Plain reads and writes require kernel 5.6 or newer, which is what this feature flag indicates
+        return (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+    }();
+
+    return is_available;
+#else
+    return false;
+#endif
+}
+
+bool UringCache::Init()
+{
+    if (!sector_size || !sectors || filename.empty()) {
+        return false;
+    }
+
+    ReleaseRing();
+
+    if (fd != -1) {
+        close(fd);
+    }
+
+    fd = open(filename.c_str(), O_RDWR);
+    if (fd == -1) {
+        return false;
+    }
+
+    if (!SetUpRing()) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+bool UringCache::SetUpRing()
+{
+#ifdef __linux__
+    io_uring_params params = { };
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params));
+    if (ring_fd == -1) {
+        return false;
+    }
+
+    if (!(params.features & IORING_FEAT_RW_CUR_POS) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(ring_fd);
+        ring_fd = -1;
+        return false;
+    }
+
+    ring_size = max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    void *r = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (r == MAP_FAILED) {
+        close(ring_fd);
+        ring_fd = -1;
+        return false;
+    }
+    ring = static_cast<uint8_t*>(r);
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *s = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (s == MAP_FAILED) {
+        munmap(ring, ring_size);
+        close(ring_fd);
+        ring_fd = -1;
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(s);
+
+    sq_tail = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+
+    // There are never more requests in flight than the submission queue can hold
+    requests = vector<Request>(params.sq_entries);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void UringCache::ReleaseRing()
+{
+    if (ring_fd == -1) {
+        return;
+    }
+
+#ifdef __linux__
+    // The kernel must not access any buffer anymore
+    WaitFor([this] {return !in_flight;});
+
+    munmap(sqes, sqes_size);
+    munmap(ring, ring_size);
+#endif
+
+    close(ring_fd);
+    ring_fd = -1;
+}
+
+int UringCache::ReadSectors(data_in_t buf, uint64_t start, uint32_t count)
+{
+    if (ring_fd == -1 || sectors < start + count) {
+        return 0;
+    }
+
+    const uint64_t offset = start * sector_size;
+    const int length = sector_size * count;
+    const uint64_t end = offset + length;
+
+    // Pending writes of these sectors must have completed
+    if (!WaitForWrites(offset, length)) {
+        ++read_error_count;
+        return 0;
+    }
+
+    UpdateStream(start, count);
+
+    has_read_error = false;
+    bool is_prefetched = true;
+
+    uint64_t position = offset;
+    while (position < end && !has_read_error) {
+        if (const int prefetched = FindPrefetched(position); prefetched != -1) {
+            Request &request = requests[prefetched];
+            if (!WaitFor([&request] {return request.operation != Operation::PREFETCH || request.is_complete;})) {
+                has_read_error = true;
+                break;
+            }
+
+            // A failed prefetch request has been released, the data are read on demand
+            if (request.operation != Operation::PREFETCH) {
+                continue;
+            }
+
+            const uint64_t request_end = request.offset + request.length;
+            const uint64_t n = min(end, request_end) - position;
+            memcpy(buf.data() + (position - offset), request.data.data() + (position - request.offset), n);
+            position += n;
+
+            if (position == request_end) {
+                ReleaseRequest(request);
+            }
+        }
+        else {
+            is_prefetched = false;
+
+            const int index = AllocateRequest();
+            if (index == -1) {
+                has_read_error = true;
+                break;
+            }
+
+            Request &request = requests[index];
+            request.operation = Operation::READ;
+            request.offset = position;
+            request.length = static_cast<int>(min(GetNextPrefetched(position, end), position + MAX_READ_BYTES)
+                - position);
+            ++pending_reads;
+            Queue(index, buf.data() + (position - offset));
+            position += request.length;
+        }
+    }
+
+    // The prefetch requests are submitted together with the regular reads
+    Prefetch();
+
+    if (!Reap(false) || !WaitFor([this] {return !pending_reads;}) || has_read_error) {
+        ++read_error_count;
+        return 0;
+    }
+
+    if (is_prefetched) {
+        ++prefetch_hit_count;
+    }
+
+    served_read_byte_count += length;
+
+    return length;
+}
+
+int UringCache::WriteSectors(data_out_t buf, uint64_t start, uint32_t count)
+{
+    if (ring_fd == -1 || sectors < start + count) {
+        return 0;
+    }
+
+    const uint64_t offset = start * sector_size;
+    const int length = sector_size * count;
+
+    InvalidatePrefetched(offset, offset + length);
+
+    // Writes of the same sectors must not overtake each other
+    if (!WaitForWrites(offset, length)) {
+        ++write_error_count;
+        return 0;
+    }
+
+    const int index = AllocateRequest();
+    if (index == -1) {
+        ++write_error_count;
+        return 0;
+    }
+
+    // The caller's buffer is re-used before the write has completed
+    Request &request = requests[index];
+    request.operation = Operation::WRITE;
+    request.offset = offset;
+    request.length = length;
+    request.data.assign(buf.begin(), buf.begin() + length);
+    ++pending_writes;
+    Queue(index, request.data.data());
+
+    if (!Reap(false)) {
+        ++write_error_count;
+        return 0;
+    }
+
+    served_write_byte_count += length;
+
+    return length;
+}
+
+bool UringCache::Flush()
+{
+    if (ring_fd == -1) {
+        return true;
+    }
+
+    const int index = AllocateRequest();
+    if (index == -1) {
+        return false;
+    }
+
+    // The kernel only starts the fsync request when all previously submitted requests have completed
+    Request &request = requests[index];
+    request.operation = Operation::FSYNC;
+    request.offset = 0;
+    request.length = 0;
+    ++pending_writes;
+    Queue(index, nullptr);
+
+    if (!WaitFor([this] {return !pending_writes;})) {
+        return false;
+    }
+
+    // Errors of asynchronous writes are reported by the next flush
+    const bool success = !has_write_error;
+    has_write_error = false;
+
+    return success;
+}
+
+int UringCache::AllocateRequest()
+{
+    while (true) {
+        if (const auto &it = ranges::find_if(requests, [](const Request &r) {return r.operation == Operation::NONE;});
+        it != requests.end()) {
+            return static_cast<int>(it - requests.begin());
+        }
+
+        if (!Reap(true)) {
+            return -1;
+        }
+    }
+}
+
+void UringCache::ReleaseRequest(Request &request)
+{
+    request.operation = Operation::NONE;
+    request.is_complete = false;
+    request.is_stale = false;
+}
+
+void UringCache::Queue(int index, const void *buf)
+{
+#ifdef __linux__
+    Request &request = requests[index];
+    request.is_complete = false;
+
+    // This thread is the only producer, the kernel only reads the tail
+    const unsigned tail = *sq_tail;
+    const unsigned i = tail & *sq_mask;
+
+    io_uring_sqe &sqe = sqes[i];
+    memset(&sqe, 0, sizeof(sqe));
+    switch (request.operation) {
+    case Operation::WRITE:
+        sqe.opcode = IORING_OP_WRITE;
+        break;
+
+    case Operation::FSYNC:
+        sqe.opcode = IORING_OP_FSYNC;
+        sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe.flags = IOSQE_IO_DRAIN;
+        break;
+
+    default:
+        sqe.opcode = IORING_OP_READ;
+        break;
+    }
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(buf);
+    sqe.len = request.length;
+    sqe.off = request.offset;
+    sqe.user_data = index;
+
+    sq_array[i] = i;
+    atomic_ref<unsigned>(*sq_tail).store(tail + 1, memory_order_release);
+
+    ++queued;
+    ++in_flight;
+#endif
+}
+
+bool UringCache::Enter(unsigned min_complete)
+{
+#ifdef __linux__
+    while (true) {
+        const int submitted = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, queued, min_complete,
+            min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+        if (submitted != -1) {
+            queued -= submitted;
+            return true;
+        }
+
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+// Submits the queued requests and processes the completed ones, optionally waits for at least one completion
+bool UringCache::Reap(bool wait)
+{
+#ifdef __linux__
+    unsigned head = *cq_head;
+    if (wait && head == atomic_ref<unsigned>(*cq_tail).load(memory_order_acquire)) {
+        if (!in_flight || !Enter(1)) {
+            return false;
+        }
+    }
+    else if (queued && !Enter(0)) {
+        return false;
+    }
+
+    const unsigned tail = atomic_ref<unsigned>(*cq_tail).load(memory_order_acquire);
+    for (; head != tail; ++head) {
+        const io_uring_cqe &cqe = cqes[head & *cq_mask];
+        Complete(static_cast<int>(cqe.user_data), cqe.res);
+    }
+    atomic_ref<unsigned>(*cq_head).store(head, memory_order_release);
+
+    return true;
+#else
+    return !wait;
+#endif
+}
+
+void UringCache::Complete(int index, int result)
+{
+    --in_flight;
+
+    Request &request = requests[index];
+    request.result = result;
+    request.is_complete = true;
+
+    switch (request.operation) {
+    case Operation::READ:
+        --pending_reads;
+        if (result != request.length) {
+            has_read_error = true;
+        }
+        ReleaseRequest(request);
+        break;
+
+    case Operation::WRITE:
+    case Operation::FSYNC:
+        --pending_writes;
+        if (result != request.length) {
+            ++write_error_count;
+            has_write_error = true;
+        }
+        ReleaseRequest(request);
+        break;
+
+    case Operation::PREFETCH:
+        // Prefetching errors are not reported, reading the data on demand will report them
+        if (request.is_stale || result != request.length) {
+            ReleaseRequest(request);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool UringCache::WaitFor(const function<bool()> &is_done)
+{
+    while (!is_done()) {
+        if (!Reap(true)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool UringCache::WaitForWrites(uint64_t offset, int length)
+{
+    return WaitFor([this, offset, length] {
+        return ranges::none_of(requests, [offset, length](const Request &r) {
+                return r.operation == Operation::WRITE && r.offset < offset + length && offset < r.offset + r.length;
+            });
+    });
+}
+
+void UringCache::UpdateStream(uint64_t start, uint32_t count)
+{
+    if (sequential_commands && start == next_sector) {
+        ++sequential_commands;
+    }
+    else {
+        // A new stream starts, the data prefetched for the previous stream are obsolete
+        InvalidatePrefetched(0, UINT64_MAX);
+        sequential_commands = 1;
+        prefetch_end = 0;
+    }
+
+    next_sector = start + count;
+}
+
+int UringCache::FindPrefetched(uint64_t offset) const
+{
+    const auto &it = ranges::find_if(requests, [offset](const Request &r) {
+        return r.operation == Operation::PREFETCH && !r.is_stale && offset >= r.offset
+            && offset < r.offset + r.length;
+    });
+
+    return it != requests.end() ? static_cast<int>(it - requests.begin()) : -1;
+}
+
+// The offset of the next prefetched data, limited by the specified end
+uint64_t UringCache::GetNextPrefetched(uint64_t offset, uint64_t end) const
+{
+    for (const Request &r : requests) {
+        if (r.operation == Operation::PREFETCH && !r.is_stale && r.offset > offset) {
+            end = min(end, r.offset);
+        }
+    }
+
+    return end;
+}
+
+void UringCache::InvalidatePrefetched(uint64_t start, uint64_t end)
+{
+    for (Request &r : requests) {
+        if (r.operation == Operation::PREFETCH && r.offset < end && start < r.offset + r.length) {
+            // The kernel may still be writing into the buffer of an incomplete request
+            if (r.is_complete) {
+                ReleaseRequest(r);
+            }
+            else {
+                r.is_stale = true;
+            }
+        }
+    }
+}
+
+void UringCache::Prefetch()
+{
+    if (sequential_commands < MIN_SEQUENTIAL_COMMANDS) {
+        return;
+    }
+
+    int prefetching = static_cast<int>(ranges::count_if(requests, [](const Request &r) {
+        return r.operation == Operation::PREFETCH && !r.is_stale;
+    }));
+
+    const uint64_t file_end = sectors * sector_size;
+    uint64_t begin = max(prefetch_end, next_sector * sector_size);
+    while (prefetching < MAX_PREFETCH_REQUESTS && begin < file_end) {
+        const int index = AllocateRequest();
+        if (index == -1) {
+            break;
+        }
+
+        Request &request = requests[index];
+        request.operation = Operation::PREFETCH;
+        request.offset = begin;
+        request.length = static_cast<int>(min(static_cast<uint64_t>(PREFETCH_BYTES), file_end - begin));
+        request.data.resize(request.length);
+        Queue(index, request.data.data());
+
+        begin += request.length;
+        ++prefetching;
+    }
+
+    prefetch_end = begin;
+}
+
+vector<PbStatistics> UringCache::GetStatistics(bool is_read_only) const
+{
+    vector<PbStatistics> statistics;
+
+    PbStatistics s;
+
+    s.set_category(PbStatisticsCategory::CATEGORY_INFO);
+
+    s.set_key(PREFETCH_HIT_COUNT);
+    s.set_value(prefetch_hit_count);
+    statistics.push_back(s);
+
+    // The data are cached by the kernel, only the page cache residency of the image file is known
+    s.set_key(CACHE_RESIDENT_BYTES);
+    s.set_value(GetResidentBytes(fd, sectors * sector_size));
+    statistics.push_back(s);
+
+    s.set_key(SERVED_READ_BYTE_COUNT);
+    s.set_value(served_read_byte_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(SERVED_WRITE_BYTE_COUNT);
+        s.set_value(served_write_byte_count);
+        statistics.push_back(s);
+    }
+
+    s.set_category(PbStatisticsCategory::CATEGORY_ERROR);
+
+    s.set_key(READ_ERROR_COUNT);
+    s.set_value(read_error_count);
+    statistics.push_back(s);
+
+    if (!is_read_only) {
+        s.set_key(WRITE_ERROR_COUNT);
+        s.set_value(write_error_count);
+        statistics.push_back(s);
+    }
+
+    return statistics;
+}
@@ -0,0 +1,144 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// A cache based on io_uring. The sectors of a command are read with several requests
+// in flight, writes complete asynchronously and a flush is a single fsync request
+// executed after all pending writes. Sequential reads keep prefetch requests in flight.
+// There is no thread, all requests are submitted and completed by the calling thread.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <functional>
+#include "cache.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+class UringCache : public Cache
+{
+
+public:
+
+    UringCache(const string &f, int size, uint64_t s)
+    : filename(f), sector_size(size), sectors(s)
+    {
+    }
+    ~UringCache() override;
+
+    int ReadSectors(data_in_t, uint64_t, uint32_t) override;
+    int WriteSectors(data_out_t, uint64_t, uint32_t) override;
+
+    bool Init() override;
+
+    bool Flush() override;
+
+    vector<PbStatistics> GetStatistics(bool) const override;
+
+    // Whether the kernel supports io_uring
+    static bool IsAvailable();
+
+private:
+
+    enum class Operation
+    {
+        NONE,
+        READ,
+        WRITE,
+        PREFETCH,
+        FSYNC
+    };
+
+    struct Request
+    {
+        Operation operation = Operation::NONE;
+        bool is_complete = false;
+        // Prefetched data that must not be used anymore because the sectors have been written or skipped
+        bool is_stale = false;
+        int result = 0;
+        uint64_t offset = 0;
+        int length = 0;
+        // The data of writes and prefetch reads, regular reads use the buffer of the caller
+        vector<uint8_t> data;
+    };
+
+    bool SetUpRing();
+    void ReleaseRing();
+
+    int AllocateRequest();
+    void ReleaseRequest(Request&);
+    void Queue(int, const void*);
+    bool Enter(unsigned);
+    bool Reap(bool);
+    void Complete(int, int);
+    bool WaitFor(const function<bool()>&);
+
+    bool WaitForWrites(uint64_t, int);
+    void UpdateStream(uint64_t, uint32_t);
+    int FindPrefetched(uint64_t) const;
+    uint64_t GetNextPrefetched(uint64_t, uint64_t) const;
+    void InvalidatePrefetched(uint64_t, uint64_t);
+    void Prefetch();
+
+    string filename;
+
+    int sector_size;
+
+    uint64_t sectors;
+
+    // The image file
+    int fd = -1;
+
+    // The ring and the memory shared with the kernel, both queues share a single mapping
+    int ring_fd = -1;
+    uint8_t *ring = nullptr;
+    size_t ring_size = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    // The number of requests queued but not yet submitted, and the number of requests not yet completed
+    unsigned queued = 0;
+    int in_flight = 0;
+
+    vector<Request> requests;
+
+    int pending_reads = 0;
+    int pending_writes = 0;
+    bool has_read_error = false;
+    bool has_write_error = false;
+
+    // The sequential stream detector state
+    uint64_t next_sector = 0;
+    int sequential_commands = 0;
+    uint64_t prefetch_end = 0;
+
+    uint64_t read_error_count = 0;
+    uint64_t write_error_count = 0;
+    uint64_t prefetch_hit_count = 0;
+    uint64_t served_read_byte_count = 0;
+    uint64_t served_write_byte_count = 0;
+
+    // The maximum number of requests in flight
+    static constexpr unsigned QUEUE_DEPTH = 32;
+
+    // Larger reads are split into several requests, which the kernel can process in parallel
+    static constexpr int MAX_READ_BYTES = 64 * 1024;
+
+    // Sequential reads keep up to this number of prefetch requests of the specified size in flight
+    static constexpr int MAX_PREFETCH_REQUESTS = 4;
+    static constexpr int PREFETCH_BYTES = 128 * 1024;
+
+    // The number of sequential commands required before prefetching starts
+    static constexpr int MIN_SEQUENTIAL_COMMANDS = 2;
+};
@@ -60,9 +60,8 @@ int InitiatorExecutor::Execute(span<uint8_t> cdb, span<uint8_t> buffer, int leng
     // Wait for the command to finish
     auto now = steady_clock::now();
     while ((duration_cast<seconds>(steady_clock::now() - now).count()) < timeout) {
-        bus.Acquire();
-
-        if (bus.GetREQ()) {
+        // With the in-process bus the initiator does not have to spin while the target processes the command
+        if (bus.WaitSignal(PIN_REQ, true)) {
             try {
                 if (Dispatch(cdb, buffer, length)) {
                     now = steady_clock::now();
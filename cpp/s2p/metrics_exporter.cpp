@@ -0,0 +1,244 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "metrics_exporter.h"
+#include <array>
+#include <cassert>
+#include <filesystem>
+#include <map>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "shared/s2p_util.h"
+
+using namespace filesystem;
+using namespace s2p_util;
+
+string MetricsExporter::Init(const string &endpoint, const collector &c, shared_ptr<logger> logger)
+{
+    assert(metrics_socket == -1);
+
+    sockaddr_storage address = { };
+    socklen_t length;
+    if (const int port = ParseAsUnsignedInt(endpoint); port != -1) {
+        if (port <= 0 || port > 65535) {
+            return fmt::format("Invalid metrics port: {}", port);
+        }
+
+        // Metrics are only provided locally
+        auto *server = reinterpret_cast<sockaddr_in*>(&address); // NOSONAR bit_cast is not supported by the bullseye compiler
+        server->sin_family = AF_INET;
+        server->sin_port = htons(static_cast<uint16_t>(port));
+        server->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        length = sizeof(sockaddr_in);
+    }
+    else {
+        auto *server = reinterpret_cast<sockaddr_un*>(&address); // NOSONAR bit_cast is not supported by the bullseye compiler
+        if (endpoint.empty() || endpoint.size() >= sizeof(server->sun_path)) {
+            return "Invalid metrics socket: '" + endpoint + "'";
+        }
+        server->sun_family = AF_UNIX;
+        endpoint.copy(server->sun_path, endpoint.size());
+        length = sizeof(sockaddr_un);
+
+        // Remove a socket file left over by a previous s2p instance
+        if (error_code error; is_socket(endpoint, error)) {
+            remove(endpoint, error);
+        }
+    }
+
+    metrics_socket = socket(address.ss_family, SOCK_STREAM, 0);
+    if (metrics_socket == -1) {
+        return fmt::format("Can't create metrics socket: {}", strerror(errno));
+    }
+
+    if (const int enable = 1; address.ss_family == AF_INET
+        && setsockopt(metrics_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1) {
+        Stop();
+        return fmt::format("Can't reuse socket: {}", strerror(errno));
+    }
+
+    if (::bind(metrics_socket, reinterpret_cast<const sockaddr*>(&address), length) < 0) { // NOSONAR bit_cast is not supported by the bullseye compiler
+        Stop();
+        return fmt::format("Can't bind metrics socket to '{}': {}", endpoint, strerror(errno));
+    }
+
+    if (address.ss_family == AF_UNIX) {
+        socket_path = endpoint;
+    }
+
+    if (listen(metrics_socket, 2) == -1) {
+        Stop();
+        return "Can't listen to metrics socket: " + string(strerror(errno));
+    }
+
+    s2p_logger = logger;
+
+    collect = c;
+
+    return "";
+}
+
+void MetricsExporter::Start()
+{
+    assert(metrics_socket != -1);
+
+#ifndef __APPLE__
+    exporter_thread = jthread([this]() {Execute();});
+#else
+    exporter_thread = thread([this] () { Execute(); } );
+#endif
+}
+
+void MetricsExporter::Stop()
+{
+    if (const int fd = metrics_socket.exchange(-1); fd != -1) {
+        shutdown(fd, SHUT_RD);
+        close(fd);
+
+        if (!socket_path.empty()) {
+            unlink(socket_path.c_str());
+            socket_path.clear();
+        }
+    }
+}
+
+bool MetricsExporter::IsRunning() const
+{
+    return metrics_socket != -1 && exporter_thread.joinable();
+}
+
+void MetricsExporter::Execute()
+{
+    while (metrics_socket != -1) {
+        if (chrono::steady_clock::now() - last_refresh >= REFRESH_INTERVAL) {
+            Refresh();
+        }
+
+        // The timeout ensures that the snapshot is refreshed even if there are no scrapes
+        pollfd fds = { metrics_socket, POLLIN, 0 };
+        if (poll(&fds, 1, static_cast<int>(REFRESH_INTERVAL.count())) > 0 && (fds.revents & POLLIN)) {
+            if (const int fd = accept(metrics_socket, nullptr, nullptr); fd != -1) {
+                Serve(fd);
+                close(fd);
+            }
+        }
+    }
+}
+
+void MetricsExporter::Refresh()
+{
+    // If the statistics cannot be collected right now the previous snapshot is kept and there is a new attempt
+    // with the next iteration
+    if (PbStatisticsInfo statistics_info; collect(statistics_info)) {
+        snapshot = Render(statistics_info);
+        last_refresh = chrono::steady_clock::now();
+    }
+}
+
+void MetricsExporter::Serve(int fd) const
+{
+    // Do not let a client that does not send anything block the exporter
+    const timeval timeout = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Only the request line is relevant, a client not sending a request at all gets the metrics, too
+    string request;
+    array<char, 1024> buf;
+    while (request.find("\r\n\r\n") == string::npos && request.size() < 4096) {
+        const ssize_t n = recv(fd, buf.data(), buf.size(), 0);
+        if (n <= 0) {
+            break;
+        }
+        request.append(buf.data(), n);
+    }
+
+    string response;
+    if (request.empty() || request.starts_with("GET ")) {
+        response = fmt::format("HTTP/1.0 200 OK\r\n"
+            "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+            "Content-Length: {}\r\n\r\n{}", snapshot.size(), snapshot);
+    }
+    else {
+        response = "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n";
+    }
+
+    for (size_t offset = 0; offset < response.size();) {
+        const ssize_t n = send(fd, response.data() + offset, response.size() - offset, MSG_NOSIGNAL);
+        if (n <= 0) {
+            s2p_logger->debug("Can't send metrics: {}", strerror(errno));
+            break;
+        }
+        offset += n;
+    }
+}
+
+string MetricsExporter::Render(const PbStatisticsInfo &statistics_info)
+{
+    // The samples of a metric family must not be interleaved with other families
+    map<string, pair<string, string>, less<>> families;
+
+    // The histogram buckets per family and device, sorted by their limits
+    map<string, map<string, map<uint64_t, uint64_t>>, less<>> histograms;
+
+    for (const auto &statistics : statistics_info.statistics()) {
+        const string &key = statistics.key();
+        const string &labels = GetLabels(statistics);
+
+        // Latency buckets ("<operation>_latency_le_<limit>_us") are mapped to a histogram
+        if (const auto bucket = key.find("_latency_le_"); bucket != string::npos && key.ends_with("_us")) {
+            const string &limit = key.substr(bucket + 12, key.size() - bucket - 15);
+            histograms["s2p_" + key.substr(0, bucket) + "_latency_us"][labels][stoull(limit)] = statistics.value();
+            continue;
+        }
+
+        // The latency count is the count of the histogram
+        if (key.ends_with("_latency_count")) {
+            continue;
+        }
+
+        // Block counts are gauges, all other counts are counters
+        const bool is_counter = key.ends_with("_count") && !key.ends_with("_block_count");
+        const string &name = "s2p_" + key;
+        auto& [type, samples] = families[name];
+        type = is_counter ? "counter" : "gauge";
+        samples += fmt::format("{}{}{} {}\n", name, is_counter ? "_total" : "", labels, statistics.value());
+    }
+
+    for (const auto& [name, devices] : histograms) {
+        auto& [type, samples] = families[name];
+        type = "histogram";
+        for (const auto& [labels, buckets] : devices) {
+            // The label set without the closing brace, the bucket limit is appended
+            const string &prefix = labels.empty() ? "{" : labels.substr(0, labels.size() - 1) + ",";
+            uint64_t count = 0;
+            for (const auto& [limit, n] : buckets) {
+                count += n;
+                samples += fmt::format("{}_bucket{}le=\"{}.0\"}} {}\n", name, prefix, limit, count);
+            }
+            samples += fmt::format("{}_bucket{}le=\"+Inf\"}} {}\n", name, prefix, count);
+            samples += fmt::format("{}_count{} {}\n", name, labels, count);
+        }
+    }
+
+    string text;
+    for (const auto& [name, family] : families) {
+        text += fmt::format("# TYPE {} {}\n{}", name, family.first, family.second);
+    }
+    text += "# EOF\n";
+
+    return text;
+}
+
+string MetricsExporter::GetLabels(const PbStatistics &statistics)
+{
+    return statistics.id() == -1 ? "" : fmt::format("{{id=\"{}\",lun=\"{}\"}}", statistics.id(), statistics.unit());
+}
@@ -0,0 +1,70 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+// Serves the s2p statistics in the OpenMetrics text format on a loopback port or a Unix socket.
+// The statistics are collected periodically by the exporter thread and rendered into a snapshot.
+// A scrape only returns this snapshot, i.e. scraping never waits for the bus thread.
+//
+//---------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <spdlog/spdlog.h>
+#include "generated/s2p_interface.pb.h"
+
+using namespace std;
+using namespace spdlog;
+using namespace s2p_interface;
+
+class MetricsExporter
+{
+    // Returns false if the statistics cannot be collected without waiting
+    using collector = function<bool(PbStatisticsInfo&)>;
+
+public:
+
+    // The endpoint is either a TCP port on 127.0.0.1 or the path of a Unix socket
+    string Init(const string&, const collector&, shared_ptr<logger> logger);
+    void Start();
+    void Stop();
+    bool IsRunning() const;
+
+    static string Render(const PbStatisticsInfo&);
+
+    static constexpr chrono::milliseconds REFRESH_INTERVAL = chrono::milliseconds(1000);
+
+private:
+
+    void Execute();
+    void Refresh();
+    void Serve(int) const;
+
+    static string GetLabels(const PbStatistics&);
+
+    collector collect;
+
+#ifndef __APPLE__
+    jthread exporter_thread;
+#else
+    thread exporter_thread;
+#endif
+
+    atomic_int metrics_socket = -1;
+
+    // Only set for Unix sockets, the socket file is removed when the exporter stops
+    string socket_path;
+
+    // Only accessed by the exporter thread
+    string snapshot = "# EOF\n";
+    chrono::steady_clock::time_point last_refresh;
+
+    shared_ptr<logger> s2p_logger;
+};
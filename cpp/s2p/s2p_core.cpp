@@ -20,6 +20,10 @@
 #include "command/command_context.h"
 #include "command/command_image_support.h"
 #include "command/command_response.h"
+#include "controllers/buffer_pool.h"
+#ifdef BUILD_DISK
+#include "devices/disk.h"
+#endif
 #ifdef BUILD_SCHS
 #include "devices/host_services.h"
 #endif
@@ -53,6 +57,8 @@ void S2p::CleanUp()
         service_thread.Stop();
     }
 
+    metrics_exporter.Stop();
+
     executor->DetachAll();
 
     // TODO Check why there are rare cases where bus is NULL on a remote interface shutdown
@@ -182,6 +188,17 @@ int S2p::Run(span<char*> args, bool in_process, bool log_signals)
         return EXIT_FAILURE;
     }
 
+    const string metrics = property_handler.RemoveProperty(PropertyHandler::METRICS);
+    if (!metrics.empty()) {
+        if (const string &error = metrics_exporter.Init(metrics, [this](PbStatisticsInfo &statistics_info) {
+            return CollectStatistics(statistics_info);
+        }, s2p_logger); !error.empty()) {
+            cerr << "Error: " << error << '\n';
+            CleanUp();
+            return EXIT_FAILURE;
+        }
+    }
+
     try {
         CreateDevices();
     }
@@ -222,6 +239,10 @@ int S2p::Run(span<char*> args, bool in_process, bool log_signals)
 
     service_thread.Start();
 
+    if (!metrics.empty()) {
+        metrics_exporter.Start();
+    }
+
     // Signal the in-process client that s2p is ready
     if (in_process) {
         bus->CleanUp();
@@ -276,6 +297,29 @@ bool S2p::ParseProperties(const property_map &properties, int &port, bool ignore
             s2p_logger->info("Generating s2pexec script file '" + script_file + "'");
         }
 
+        if (const string &cache_memory = property_handler.RemoveProperty(PropertyHandler::CACHE_MEMORY); !cache_memory.empty()) {
+            if (const int memory = ParseAsUnsignedInt(cache_memory); memory <= 0) {
+                throw ParserException("Invalid cache memory size: " + cache_memory);
+            }
+            else {
+#ifdef BUILD_DISK
+                Disk::SetCacheMemory(static_cast<uint64_t>(memory) * 1024 * 1024);
+#endif
+            }
+        }
+
+        if (const string &max_transfer_size = property_handler.RemoveProperty(PropertyHandler::MAX_TRANSFER_SIZE);
+            !max_transfer_size.empty()) {
+            constexpr int limit = BufferPool::MAX_TRANSFER_SIZE_LIMIT / 1024;
+            if (const int size = ParseAsUnsignedInt(max_transfer_size); size <= 0 || size > limit) {
+                throw ParserException(fmt::format("Invalid maximum transfer size: '{0}', size must be between 1 and {1}",
+                    max_transfer_size, limit));
+            }
+            else {
+                BufferPool::Instance().SetMaxTransferSize(size * 1024);
+            }
+        }
+
         const string &p = property_handler.RemoveProperty(PropertyHandler::PORT, "6868");
         port = ParseAsUnsignedInt(p);
         if (port <= 0 || port > 65535) {
@@ -479,6 +523,19 @@ void S2p::ProcessScsiCommands()
     }
 }
 
+bool S2p::CollectStatistics(PbStatisticsInfo &statistics_info)
+{
+    // The exporter must not wait while a SCSI command is being processed, it tries again later
+    unique_lock<mutex> lock(executor->GetExecutionLocker(), try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+
+    CommandResponse().GetStatisticsInfo(statistics_info, controller_factory.GetAllDevices());
+
+    return true;
+}
+
 bool S2p::ExecuteCommand(CommandContext &context)
 {
     if (const string &locale = GetParam(context.GetCommand(), "locale"); !locale.empty()) {
@@ -11,6 +11,7 @@
 #include <filesystem>
 #include "command/command_dispatcher.h"
 #include "base/property_handler.h"
+#include "metrics_exporter.h"
 #include "s2p_thread.h"
 
 using namespace filesystem;
@@ -39,6 +40,7 @@ private:
     bool WaitForNotBusy() const;
 
     bool ExecuteCommand(CommandContext&);
+    bool CollectStatistics(PbStatisticsInfo&);
 
     void SetDeviceProperties(PbDeviceDefinition&, const string&, const string&) const;
 
@@ -50,6 +52,8 @@ private:
 
     S2pThread service_thread;
 
+    MetricsExporter metrics_exporter;
+
     ControllerFactory controller_factory;
 
     shared_ptr<CommandDispatcher> dispatcher;
@@ -34,8 +34,12 @@ void S2pParser::Banner(bool usage) const
             << "                              format is VENDOR:PRODUCT:REVISION.\n"
             << "  --block-size/-b BLOCK_SIZE  Optional default block size, a multiple of 4.\n"
             << "  --caching-mode/-m MODE      Caching mode (piscsi|write-through|linux\n"
-            << "                              |linux-optimized), default currently is PiSCSI\n"
-            << "                              compatible caching.\n"
+            << "                              |linux-optimized|io-uring|mmap|direct-io|auto),\n"
+            << "                              default currently is PiSCSI compatible caching.\n"
+            << "  --cache-memory MIB          Memory in MiB shared by the PiSCSI caches of all\n"
+            << "                              drives.\n"
+            << "  --max-transfer-size KIB     Maximum size of a single data transfer in KiB,\n"
+            << "                              default is 64.\n"
             << "  --blue-scsi-mode/-B         Enable BlueSCSI filename compatibility mode.\n"
             << "  --reserved-ids/-r [IDS]     List of IDs to reserve.\n"
             << "  --image-folder/-F FOLDER    Default folder with image files.\n"
@@ -50,6 +54,8 @@ void S2pParser::Banner(bool usage) const
             << "  --script-file/-s FILE       File to write s2pexec command script to.\n"
             << "  --token-file/-P FILE        Access token file.\n"
             << "  --port/-p PORT              s2p server port, default is 6868.\n"
+            << "  --metrics PORT|SOCKET       Serve statistics in OpenMetrics format on a\n"
+            << "                              127.0.0.1 port or a Unix socket.\n"
             << "  --ignore-conf               Ignore /etc/s2p.conf configuration file.\n"
             << "  --version/-v                Display the program version.\n"
             << "  --help/-h                   Display this help.\n"
@@ -63,7 +69,8 @@ void S2pParser::Banner(bool usage) const
             << "    iso: CD image (SCSI-2 ISO 9660 image)\n"
             << "    is1: CD image (SCSI-1-CCS ISO 9660 image)\n"
             << "    tar: Tape image (SCSI-2 tar-compatible image)\n"
-            << "    tap: Tape image (SCSI-2 SIMH-compatible image)\n";
+            << "    tap: Tape image (SCSI-2 SIMH-compatible image)\n"
+            << "  Images compressed with dictzip (e.g. image.iso.dz) are read-only.\n";
     }
 }
 
@@ -72,10 +79,14 @@ property_map S2pParser::ParseArguments(span<char*> initial_args, bool &ignore_co
     const int OPT_SCSI_LEVEL = 2;
     const int OPT_LOG_LIMIT = 3;
     const int OPT_IGNORE_CONF = 4;
+    const int OPT_CACHE_MEMORY = 5;
+    const int OPT_METRICS = 6;
+    const int OPT_MAX_TRANSFER_SIZE = 7;
 
     const vector<option> options = {
         { "block-size", required_argument, nullptr, 'b' },
         { "blue-scsi-mode", no_argument, nullptr, 'B' },
+        { "cache-memory", required_argument, nullptr, OPT_CACHE_MEMORY },
         { "caching-mode", required_argument, nullptr, 'm' },
         { "image-folder", required_argument, nullptr, 'F' },
         { "help", no_argument, nullptr, 'h' },
@@ -84,6 +95,8 @@ property_map S2pParser::ParseArguments(span<char*> initial_args, bool &ignore_co
         { "log-level", required_argument, nullptr, 'L' },
         { "log-pattern", required_argument, nullptr, 'l' },
         { "log-limit", required_argument, nullptr, OPT_LOG_LIMIT },
+        { "max-transfer-size", required_argument, nullptr, OPT_MAX_TRANSFER_SIZE },
+        { "metrics", required_argument, nullptr, OPT_METRICS },
         { "name", required_argument, nullptr, 'n' },
         { "port", required_argument, nullptr, 'p' },
         { "property", required_argument, nullptr, 'c' },
@@ -101,6 +114,8 @@ property_map S2pParser::ParseArguments(span<char*> initial_args, bool &ignore_co
 
     const unordered_map<int, const char*> OPTIONS_TO_PROPERTIES = {
         { 'p', PropertyHandler::PORT },
+        { OPT_METRICS, PropertyHandler::METRICS },
+        { OPT_MAX_TRANSFER_SIZE, PropertyHandler::MAX_TRANSFER_SIZE },
         { 'r', PropertyHandler::RESERVED_IDS },
         { 's', PropertyHandler::SCRIPT_FILE },
         { 'z', PropertyHandler::LOCALE },
@@ -181,6 +196,10 @@ property_map S2pParser::ParseArguments(span<char*> initial_args, bool &ignore_co
             properties[PropertyHandler::LOG_LIMIT] = optarg;
             continue;
 
+        case OPT_CACHE_MEMORY:
+            properties[PropertyHandler::CACHE_MEMORY] = optarg;
+            continue;
+
         case OPT_SCSI_LEVEL:
             scsi_level = optarg;
             continue;
@@ -307,7 +307,7 @@ string S2pCtlDisplay::DisplayStatisticsInfo(const PbStatisticsInfo &statistics_i
         if (a.unit() > b.unit()) {
             return false;
         }
-        return a.key() < b.key();
+        return IsKeyLess(a.key(), b.key());
     });
 
     PbStatisticsCategory prev_category = PbStatisticsCategory::CATEGORY_NONE;
@@ -325,6 +325,44 @@ string S2pCtlDisplay::DisplayStatisticsInfo(const PbStatisticsInfo &statistics_i
     return s.str();
 }
 
+// Numbers in keys, e.g. the limits of the latency histogram buckets, are compared by their value
+bool S2pCtlDisplay::IsKeyLess(const string &a, const string &b)
+{
+    const auto is_digit = [](char c) {return c >= '0' && c <= '9';};
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (is_digit(a[i]) && is_digit(b[j])) {
+            const size_t start_a = i;
+            const size_t start_b = j;
+            while (i < a.size() && is_digit(a[i])) {
+                ++i;
+            }
+            while (j < b.size() && is_digit(b[j])) {
+                ++j;
+            }
+
+            // Without leading zeros the longer number is the larger one
+            if (i - start_a != j - start_b) {
+                return i - start_a < j - start_b;
+            }
+            if (const int c = a.compare(start_a, i - start_a, b, start_b, j - start_b); c) {
+                return c < 0;
+            }
+        }
+        else {
+            if (a[i] != b[j]) {
+                return a[i] < b[j];
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    return a.size() - i < b.size() - j;
+}
+
 string S2pCtlDisplay::DisplayOperationInfo(const PbOperationInfo &operation_info) const
 {
     const map<int, PbOperationMetaData, less<>> operations(operation_info.operations().cbegin(),
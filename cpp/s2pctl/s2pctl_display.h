@@ -43,4 +43,6 @@ private:
     string DisplayBlockSizes(const PbDeviceProperties&) const;
     string DisplayParameters(const PbOperationMetaData&) const;
     string DisplayPermittedValues(const PbOperationParameter&) const;
+
+    static bool IsKeyLess(const string&, const string&);
 };
@@ -34,8 +34,8 @@ void S2pCtl::Banner(bool usage) const
             << "                                 (schd|scrm|sccd|scmo|scdp|sclp|schs|sahd).\n"
             << "  --block-size/-b BLOCK_SIZE     Optional default block size, a multiple of 4.\n"
             << "  --caching-mode/-m MODE         Caching mode (piscsi|write-through|linux\n"
-            << "                                 |linux-optimized), default is PiSCSI\n"
-            << "                                 compatible caching.\n"
+            << "                                 |linux-optimized|io-uring|mmap|direct-io|auto),\n"
+            << "                                 default is PiSCSI compatible caching.\n"
             << "  --name/-n PRODUCT_DATA         Optional product data for SCSI INQUIRY command\n"
             << "                                 (VENDOR:PRODUCT:REVISION).\n"
             << "  --file/-f FILE|PARAMS          Image file path or device-specific parameters.\n"
@@ -76,7 +76,7 @@ CommandMetaData::CommandMetaData()
     AddCommand(ScsiCommand::READ_LONG_10, 10, "READ LONG(10)", { 7, 2, 0, 0, false });
     AddCommand(ScsiCommand::WRITE_LONG_10, 10, "WRITE LONG(10)", { 7, 2, 0, 0, true });
     AddCommand(ScsiCommand::WRITE_SAME_10, 10, "WRITE SAME(10)", { 7, 2, 0, 0, true });
-    AddCommand(ScsiCommand::READ_SUB_CHANNEL, 10, "READ SUB-CHANNEL", { 7, 2, 0, 0, false });
+    AddCommand(ScsiCommand::READ_SUB_CHANNEL_UNMAP, 10, "READ SUB-CHANNEL/UNMAP", { 7, 2, 0, 0, true });
     AddCommand(ScsiCommand::READ_TOC, 10, "READ TOC", { 7, 2, 0, 0, false });
     AddCommand(ScsiCommand::READ_HEADER, 10, "READ HEADER", { 7, 2, 2, 4, false });
     AddCommand(ScsiCommand::PLAY_AUDIO_10, 10, "PLAY AUDIO(10)", { 7, 2, 2, 4, false });
@@ -106,7 +106,7 @@ CommandMetaData::CommandMetaData()
     AddCommand(ScsiCommand::VERIFY_16, 16, "VERIFY(16)", { 10, 4, 2, 8, true });
     AddCommand(ScsiCommand::SYNCHRONIZE_CACHE_SPACE_16, 16, "SYNCHRONIZE CACHE(16)/SPACE(16)", { 0, 0, 0, 0, false });
     AddCommand(ScsiCommand::LOCATE_16, 16, "LOCATE(16)", { 0, 0, 0, 0, false });
-    AddCommand(ScsiCommand::ERASE_WRITE_SAME_16, 16, "ERASE(16)/WRITE SAME(16)", { 0, 0, 0, 0, false });
+    AddCommand(ScsiCommand::ERASE_WRITE_SAME_16, 16, "ERASE(16)/WRITE SAME(16)", { 0, 0, 0, 0, true });
     AddCommand(ScsiCommand::READ_BUFFER_16, 16, "READ BUFFER(16)", { 10, 4, 0, 0, false });
     AddCommand(ScsiCommand::READ_CAPACITY_READ_LONG_16, 16, "READ CAPACITY(16)/READ LONG(16)",
         { 12, 2, 0, 0, false });
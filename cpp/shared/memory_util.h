@@ -10,13 +10,47 @@
 
 #include <cassert>
 #include <cstdint>
+#include <new>
 #include <span>
+#include <vector>
 
 using namespace std;
 
 namespace memory_util
 {
 
+// The alignment of buffers for direct I/O, which bypasses the kernel page cache
+static constexpr size_t IO_ALIGNMENT = 4096;
+
+template<typename T>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U>&)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(IO_ALIGNMENT)));
+    }
+    void deallocate(T *p, size_t)
+    {
+        ::operator delete(p, align_val_t(IO_ALIGNMENT));
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U>&) const
+    {
+        return true;
+    }
+};
+
+using aligned_buffer = vector<uint8_t, AlignedAllocator<uint8_t>>;
+
 int GetInt16(const auto &buf, int offset)
 {
     assert(buf.size() > static_cast<size_t>(offset) + 1);
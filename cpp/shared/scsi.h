@@ -105,7 +105,7 @@ enum class ScsiCommand
     READ_LONG_10 = 0x3e,
     WRITE_LONG_10 = 0x3f,
     WRITE_SAME_10 = 0x41,
-    READ_SUB_CHANNEL = 0x42,
+    READ_SUB_CHANNEL_UNMAP = 0x42,
     READ_TOC = 0x43,
     READ_HEADER = 0x44,
     PLAY_AUDIO_10 = 0x45,
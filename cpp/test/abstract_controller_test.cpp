@@ -7,6 +7,7 @@
 //---------------------------------------------------------------------------
 
 #include "mocks.h"
+#include "controllers/buffer_pool.h"
 #include "shared/s2p_defs.h"
 #include "shared/s2p_exceptions.h"
 
@@ -31,11 +32,43 @@ TEST(AbstractControllerTest, SetCurrentLength)
 {
     MockAbstractController controller;
 
-    EXPECT_EQ(512U, controller.GetBuffer().size());
+    const size_t size = BufferPool::Instance().GetMaxTransferSize();
+    EXPECT_EQ(size, controller.GetBuffer().size());
     controller.SetCurrentLength(1);
-    EXPECT_LE(1U, controller.GetBuffer().size());
-    controller.SetCurrentLength(10000);
-    EXPECT_LE(10000U, controller.GetBuffer().size());
+    EXPECT_EQ(size, controller.GetBuffer().size());
+    controller.SetCurrentLength(static_cast<int>(size) + 1);
+    EXPECT_LE(size + 1, controller.GetBuffer().size());
+}
+
+TEST(AbstractControllerTest, Buffer)
+{
+    MockAbstractController controller1;
+    MockAbstractController controller2;
+
+    EXPECT_NE(controller1.GetBuffer().data(), controller2.GetBuffer().data()) << "Each controller must own its buffer";
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(controller1.GetBuffer().data()) % memory_util::IO_ALIGNMENT);
+}
+
+TEST(AbstractControllerTest, BorrowedData)
+{
+    MockAbstractController controller;
+
+    EXPECT_EQ(controller.GetBuffer().data(), controller.GetSendData());
+
+    const vector<uint8_t> data(20000);
+    auto pin = make_shared<int>();
+    controller.SetBorrowedData(data, pin);
+    EXPECT_EQ(data.data(), controller.GetSendData());
+    EXPECT_EQ(2, pin.use_count());
+
+    // Borrowed data do not require a larger buffer
+    const size_t size = controller.GetBuffer().size();
+    controller.SetCurrentLength(static_cast<int>(size) + 1);
+    EXPECT_EQ(size, controller.GetBuffer().size());
+
+    controller.Reset();
+    EXPECT_EQ(controller.GetBuffer().data(), controller.GetSendData());
+    EXPECT_EQ(1, pin.use_count());
 }
 
 TEST(AbstractControllerTest, Reset)
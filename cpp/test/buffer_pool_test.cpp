@@ -0,0 +1,49 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "controllers/buffer_pool.h"
+
+using namespace memory_util;
+
+TEST(BufferPool, Acquire)
+{
+    BufferPool &pool = BufferPool::Instance();
+
+    aligned_buffer buffer = pool.Acquire();
+    EXPECT_EQ(static_cast<size_t>(pool.GetMaxTransferSize()), buffer.size());
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(buffer.data()) % IO_ALIGNMENT);
+
+    const uint8_t *data = buffer.data();
+    pool.Release(move(buffer));
+    buffer = pool.Acquire();
+    EXPECT_EQ(data, buffer.data()) << "Released buffers must be re-used";
+
+    // A buffer that has grown is not re-used
+    buffer.resize(pool.GetMaxTransferSize() + 1);
+    pool.Release(move(buffer));
+    buffer = pool.Acquire();
+    EXPECT_EQ(static_cast<size_t>(pool.GetMaxTransferSize()), buffer.size());
+    pool.Release(move(buffer));
+}
+
+TEST(BufferPool, SetMaxTransferSize)
+{
+    BufferPool &pool = BufferPool::Instance();
+    EXPECT_EQ(BufferPool::DEFAULT_MAX_TRANSFER_SIZE, pool.GetMaxTransferSize());
+
+    pool.SetMaxTransferSize(8192);
+    EXPECT_EQ(8192, pool.GetMaxTransferSize());
+    aligned_buffer buffer = pool.Acquire();
+    EXPECT_EQ(8192U, buffer.size());
+
+    pool.SetMaxTransferSize(BufferPool::DEFAULT_MAX_TRANSFER_SIZE);
+    pool.Release(move(buffer));
+    EXPECT_EQ(static_cast<size_t>(BufferPool::DEFAULT_MAX_TRANSFER_SIZE), pool.Acquire().size())
+        << "Buffers with the previous size must not be re-used";
+}
@@ -0,0 +1,58 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "devices/caching_mode_selector.h"
+
+TEST(CachingModeSelectorTest, GetMode)
+{
+    CachingModeSelector selector(PbCachingMode::PISCSI);
+    EXPECT_EQ(PbCachingMode::PISCSI, selector.GetMode());
+
+    EXPECT_EQ(PbCachingMode::PISCSI, selector.Update(0, 0, 512)) << "Commands without sectors must be ignored";
+}
+
+TEST(CachingModeSelectorTest, Update)
+{
+    CachingModeSelector selector(PbCachingMode::PISCSI);
+
+    // Large sequential requests, the mode only changes with a completely filled window
+    for (int i = 0; i < CachingModeSelector::WINDOW_SIZE - 1; ++i) {
+        EXPECT_EQ(PbCachingMode::PISCSI, selector.Update(i * 128, 128, 512));
+    }
+    EXPECT_EQ(PbCachingMode::LINUX_OPTIMIZED, selector.Update((CachingModeSelector::WINDOW_SIZE - 1) * 128, 128, 512));
+    EXPECT_EQ(PbCachingMode::LINUX_OPTIMIZED, selector.GetMode());
+
+    // Small random requests
+    for (int i = 0; i < CachingModeSelector::WINDOW_SIZE - 1; ++i) {
+        EXPECT_EQ(PbCachingMode::LINUX_OPTIMIZED, selector.Update(i * 1000, 8, 512));
+    }
+    EXPECT_EQ(PbCachingMode::PISCSI, selector.Update(0, 8, 512));
+}
+
+TEST(CachingModeSelectorTest, Hysteresis)
+{
+    CachingModeSelector selector(PbCachingMode::PISCSI);
+
+    // Large random requests
+    for (int i = 0; i < CachingModeSelector::WINDOW_SIZE * 2; ++i) {
+        EXPECT_EQ(PbCachingMode::PISCSI, selector.Update(i * 1000, 128, 512));
+    }
+
+    // Small sequential requests
+    for (int i = 0; i < CachingModeSelector::WINDOW_SIZE * 2; ++i) {
+        EXPECT_EQ(PbCachingMode::PISCSI, selector.Update(i * 8, 8, 512));
+    }
+
+    CachingModeSelector linux_selector(PbCachingMode::LINUX_OPTIMIZED);
+
+    // Medium-sized requests do not cause a switch in any direction
+    for (int i = 0; i < CachingModeSelector::WINDOW_SIZE * 2; ++i) {
+        EXPECT_EQ(PbCachingMode::LINUX_OPTIMIZED, linux_selector.Update(i * 1000, 64, 512));
+    }
+}
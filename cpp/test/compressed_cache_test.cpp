@@ -0,0 +1,114 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "devices/compressed_cache.h"
+#include "test_shared.h"
+
+using namespace testing;
+
+static vector<byte> CreateImageData(int sectors)
+{
+    vector<byte> data(sectors * 512);
+    for (int sector = 0; sector < sectors; ++sector) {
+        data[sector * 512] = static_cast<byte>(sector);
+        data[sector * 512 + 511] = static_cast<byte>(~sector);
+    }
+
+    return data;
+}
+
+TEST(CompressedCache, Init)
+{
+    const string &filename = CreateCompressedTempFile(CreateImageData(4), 1000);
+
+    CompressedCache cache1(filename, 0, 4);
+    EXPECT_FALSE(cache1.Init());
+
+    CompressedCache cache2(filename, 512, 0);
+    EXPECT_FALSE(cache2.Init());
+
+    CompressedCache cache3("missing", 512, 4);
+    EXPECT_FALSE(cache3.Init());
+
+    CompressedCache cache4(CreateTempFile(4 * 512).string(), 512, 4);
+    EXPECT_FALSE(cache4.Init()) << "Not a compressed file";
+
+    CompressedCache cache5(filename, 512, 5);
+    EXPECT_FALSE(cache5.Init()) << "Image is too small";
+
+    CompressedCache cache6(filename, 512, 4);
+    EXPECT_TRUE(cache6.Init());
+    EXPECT_FALSE(cache6.Init());
+}
+
+TEST(CompressedCache, GetImageSize)
+{
+    EXPECT_EQ(3 * 512, CompressedCache::GetImageSize(CreateCompressedTempFile(CreateImageData(3), 1000)));
+    EXPECT_EQ(-1, CompressedCache::GetImageSize(CreateTempFile(512).string()));
+    EXPECT_EQ(-1, CompressedCache::GetImageSize("missing"));
+}
+
+TEST(CompressedCache, IsCompressed)
+{
+    EXPECT_TRUE(CompressedCache::IsCompressed("image.iso.dz"));
+    EXPECT_TRUE(CompressedCache::IsCompressed("image.HDS.DZ"));
+    EXPECT_FALSE(CompressedCache::IsCompressed("image.iso"));
+    EXPECT_FALSE(CompressedCache::IsCompressed("image.dz.iso"));
+}
+
+TEST(CompressedCache, ReadSectors)
+{
+    constexpr int SECTORS = 100;
+    const auto &data = CreateImageData(SECTORS);
+
+    // A chunk size which is not a multiple of the sector size results in sectors spanning chunks
+    CompressedCache cache(CreateCompressedTempFile(data, 1500), 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(SECTORS * 512);
+    EXPECT_EQ(0, cache.WriteSectors(buf, 0, 1)) << "Compressed images are read-only";
+    EXPECT_EQ(0, cache.ReadSectors(buf, SECTORS - 1, 2));
+
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_TRUE(ranges::equal(as_bytes(span(buf)), data));
+
+    EXPECT_EQ(2 * 512, cache.ReadSectors(buf, 2, 2));
+    EXPECT_EQ(2, buf[0]);
+    EXPECT_EQ(static_cast<uint8_t>(~2), buf[511]);
+    EXPECT_EQ(3, buf[512]);
+    EXPECT_EQ(static_cast<uint8_t>(~3), buf[1023]);
+
+    // Sequential reads are served from chunks decompressed in the background
+    for (int sector = 0; sector < SECTORS; sector += 2) {
+        EXPECT_EQ(2 * 512, cache.ReadSectors(buf, sector, 2));
+        EXPECT_EQ(sector, buf[0]);
+        EXPECT_EQ(sector + 1, buf[512]);
+    }
+}
+
+TEST(CompressedCache, GetStatistics)
+{
+    CompressedCache cache(CreateCompressedTempFile(CreateImageData(1), 1000), 512, 1);
+    EXPECT_TRUE(cache.Init());
+
+    const auto &statistics = cache.GetStatistics(true);
+    EXPECT_EQ(7U, statistics.size());
+    EXPECT_EQ(0U, statistics[0].value());
+
+    vector<uint8_t> buf(512);
+    EXPECT_EQ(512, cache.ReadSectors(buf, 0, 1));
+    EXPECT_EQ(512, cache.ReadSectors(buf, 0, 1));
+    EXPECT_EQ(1U, cache.GetStatistics(true)[0].value()) << "Only the first read decompresses";
+    EXPECT_EQ("cache_hit_read_count", cache.GetStatistics(true)[2].key());
+    EXPECT_EQ(1U, cache.GetStatistics(true)[2].value());
+    EXPECT_EQ("cache_resident_bytes", cache.GetStatistics(true)[4].key());
+    EXPECT_EQ(512U, cache.GetStatistics(true)[4].value());
+    EXPECT_EQ("served_read_byte_count", cache.GetStatistics(true)[5].key());
+    EXPECT_EQ(1024U, cache.GetStatistics(true)[5].value());
+}
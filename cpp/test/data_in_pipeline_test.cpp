@@ -0,0 +1,110 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "mocks.h"
+#include "controllers/data_in_pipeline.h"
+#include "shared/s2p_exceptions.h"
+
+class ReadAheadDevice : public MockPrimaryDevice
+{
+
+public:
+
+    ReadAheadDevice() : MockPrimaryDevice(0)
+    {
+    }
+
+    bool IsReadAheadSupported() const override
+    {
+        return true;
+    }
+
+    pair<data_out_t, shared_ptr<const void>> ReadAhead(data_in_t buf) override
+    {
+        if (error) {
+            throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::READ_ERROR);
+        }
+
+        if (pin) {
+            return {borrowed, pin};
+        }
+
+        ranges::fill(buf, static_cast<uint8_t>(++chunk));
+        return {buf, nullptr};
+    }
+
+    int chunk = 0;
+    bool error = false;
+    vector<uint8_t> borrowed = vector<uint8_t>(16, 0xff);
+    shared_ptr<const void> pin;
+};
+
+TEST(DataInPipeline, Get)
+{
+    ReadAheadDevice device;
+    DataInPipeline pipeline;
+    EXPECT_FALSE(pipeline.IsPending());
+
+    pipeline.Start(device, 512);
+    EXPECT_TRUE(pipeline.IsPending());
+    const auto [data1, pin1] = pipeline.Get();
+    EXPECT_FALSE(pipeline.IsPending());
+    EXPECT_EQ(512U, data1.size());
+    EXPECT_EQ(1, data1[0]);
+    EXPECT_EQ(1, data1[511]);
+    EXPECT_NE(nullptr, pin1) << "Data read into the pipeline buffer must be pinned";
+
+    // The chunks are read into alternate buffers
+    pipeline.Start(device, 256);
+    const auto [data2, pin2] = pipeline.Get();
+    EXPECT_EQ(256U, data2.size());
+    EXPECT_EQ(2, data2[0]);
+    EXPECT_NE(data1.data(), data2.data());
+    EXPECT_EQ(1, data1[0]) << "The previous chunk must not have been overwritten";
+}
+
+TEST(DataInPipeline, Borrowed)
+{
+    ReadAheadDevice device;
+    device.pin = make_shared<int>(0);
+    DataInPipeline pipeline;
+
+    pipeline.Start(device, 16);
+    const auto [data, pin] = pipeline.Get();
+    EXPECT_EQ(device.borrowed.data(), data.data());
+    EXPECT_EQ(device.pin, pin);
+}
+
+TEST(DataInPipeline, Error)
+{
+    ReadAheadDevice device;
+    device.error = true;
+    DataInPipeline pipeline;
+
+    pipeline.Start(device, 512);
+    EXPECT_THROW(pipeline.Get(), ScsiException);
+    EXPECT_FALSE(pipeline.IsPending());
+}
+
+TEST(DataInPipeline, Cancel)
+{
+    ReadAheadDevice device;
+    DataInPipeline pipeline;
+
+    pipeline.Cancel();
+    EXPECT_FALSE(pipeline.IsPending());
+
+    pipeline.Start(device, 512);
+    pipeline.Cancel();
+    EXPECT_FALSE(pipeline.IsPending());
+    EXPECT_EQ(1, device.chunk) << "The pending chunk must have been read";
+
+    pipeline.Start(device, 512);
+    const auto [data, _] = pipeline.Get();
+    EXPECT_EQ(2, data[0]);
+}
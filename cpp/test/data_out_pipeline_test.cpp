@@ -0,0 +1,113 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include "mocks.h"
+#include "controllers/data_out_pipeline.h"
+#include "shared/s2p_exceptions.h"
+
+class WriteBehindDevice : public MockPrimaryDevice
+{
+
+public:
+
+    WriteBehindDevice() : MockPrimaryDevice(0)
+    {
+    }
+
+    bool IsWriteBehindSupported(cdb_t) const override
+    {
+        return true;
+    }
+
+    void WriteBehind(cdb_t, data_out_t buf, bool last) override
+    {
+        if (error && chunks.size() == 1) {
+            throw ScsiException(SenseKey::MEDIUM_ERROR, Asc::WRITE_FAULT);
+        }
+
+        chunks.emplace_back(buf.begin(), buf.end());
+        last_chunk = last;
+    }
+
+    vector<vector<uint8_t>> chunks;
+    bool last_chunk = false;
+    bool error = false;
+};
+
+static void WriteChunk(DataOutPipeline &pipeline, WriteBehindDevice &device, uint8_t value, bool last)
+{
+    static const vector<int> cdb(10);
+    const auto buf = pipeline.GetBuffer(512);
+    ranges::fill(buf, value);
+    pipeline.Write(device, cdb, 512, last);
+}
+
+TEST(DataOutPipeline, Write)
+{
+    WriteBehindDevice device;
+    DataOutPipeline pipeline;
+
+    for (int i = 1; i <= DataOutPipeline::RING_SIZE * 2; ++i) {
+        WriteChunk(pipeline, device, static_cast<uint8_t>(i), i == DataOutPipeline::RING_SIZE * 2);
+    }
+    EXPECT_NO_THROW(pipeline.Drain());
+
+    ASSERT_EQ(DataOutPipeline::RING_SIZE * 2, static_cast<int>(device.chunks.size()));
+    for (int i = 0; i < DataOutPipeline::RING_SIZE * 2; ++i) {
+        EXPECT_EQ(512U, device.chunks[i].size());
+        EXPECT_EQ(i + 1, device.chunks[i][0]) << "Chunks must be written in the order they were received in";
+        EXPECT_EQ(i + 1, device.chunks[i][511]);
+    }
+    EXPECT_TRUE(device.last_chunk);
+}
+
+TEST(DataOutPipeline, GetBuffer)
+{
+    DataOutPipeline pipeline;
+    WriteBehindDevice device;
+
+    const auto buf1 = pipeline.GetBuffer(512);
+    EXPECT_EQ(512U, buf1.size());
+    EXPECT_EQ(buf1.data(), pipeline.GetBuffer(256).data()) << "Buffer must not change before it has been passed on";
+
+    WriteChunk(pipeline, device, 1, false);
+    EXPECT_NE(buf1.data(), pipeline.GetBuffer(512).data());
+    pipeline.Drain();
+}
+
+TEST(DataOutPipeline, Error)
+{
+    WriteBehindDevice device;
+    device.error = true;
+    DataOutPipeline pipeline;
+
+    WriteChunk(pipeline, device, 1, false);
+    WriteChunk(pipeline, device, 2, false);
+    WriteChunk(pipeline, device, 3, true);
+    EXPECT_THROW(pipeline.Drain(), ScsiException);
+    EXPECT_EQ(1U, device.chunks.size()) << "Chunks following the failed chunk must be discarded";
+
+    device.error = false;
+    WriteChunk(pipeline, device, 4, true);
+    EXPECT_NO_THROW(pipeline.Drain()) << "The error must only be reported once";
+    EXPECT_EQ(2U, device.chunks.size());
+}
+
+TEST(DataOutPipeline, Cancel)
+{
+    WriteBehindDevice device;
+    device.error = true;
+    DataOutPipeline pipeline;
+
+    pipeline.Cancel();
+
+    WriteChunk(pipeline, device, 1, false);
+    WriteChunk(pipeline, device, 2, true);
+    pipeline.Cancel();
+    EXPECT_NO_THROW(pipeline.Drain());
+}
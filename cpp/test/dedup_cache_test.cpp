@@ -0,0 +1,214 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "devices/dedup_cache.h"
+#include "test_shared.h"
+
+using namespace testing;
+
+// The unique name of a temporary file is used for the folder
+static string CreateStoreFolder()
+{
+    const path &folder = CreateTempFile();
+    remove(folder);
+    return folder.string();
+}
+
+static string CreateManifestName()
+{
+    return CreateTempFile(0, "hds.dedup").string();
+}
+
+TEST(BlockStore, Hash)
+{
+    EXPECT_EQ(0xe3, BlockStore::Hash( { })[0]);
+    EXPECT_EQ(0x55, BlockStore::Hash( { })[31]);
+
+    const vector<uint8_t> abc = { 'a', 'b', 'c' };
+    const auto &hash = BlockStore::Hash(abc);
+    EXPECT_EQ(0xba, hash[0]);
+    EXPECT_EQ(0x78, hash[1]);
+    EXPECT_EQ(0xad, hash[31]);
+
+    // Message with a length requiring an additional padding chunk
+    const vector<uint8_t> data(56, 'a');
+    EXPECT_EQ(0xb3, BlockStore::Hash(data)[0]);
+    EXPECT_EQ(0x8a, BlockStore::Hash(data)[31]);
+}
+
+TEST(BlockStore, ReadWriteBlock)
+{
+    const string &folder = CreateStoreFolder();
+
+    auto store = BlockStore::GetStore(folder);
+    ASSERT_NE(nullptr, store);
+    EXPECT_EQ(store, BlockStore::GetStore(folder)) << "Devices must share the store";
+    EXPECT_EQ(0U, store->GetBlockCount());
+
+    vector<uint8_t> buf(BlockStore::BLOCK_SIZE);
+    buf[0] = 1;
+    BlockStore::block_hash hash1;
+    EXPECT_TRUE(store->WriteBlock(buf, hash1));
+    BlockStore::block_hash hash2;
+    EXPECT_TRUE(store->WriteBlock(buf, hash2));
+    EXPECT_EQ(hash1, hash2);
+    EXPECT_EQ(1U, store->GetBlockCount()) << "Identical blocks must only be stored once";
+    buf[0] = 2;
+    EXPECT_TRUE(store->WriteBlock(buf, hash2));
+    EXPECT_EQ(2U, store->GetBlockCount());
+    EXPECT_TRUE(store->Flush());
+
+    EXPECT_TRUE(store->ReadBlock(hash1, buf));
+    EXPECT_EQ(1, buf[0]);
+    EXPECT_EQ(0U, store->GetCacheMissCount());
+
+    // The index is loaded again
+    store.reset();
+    store = BlockStore::GetStore(folder);
+    EXPECT_EQ(2U, store->GetBlockCount());
+    EXPECT_TRUE(store->ReadBlock(hash2, buf));
+    EXPECT_EQ(2, buf[0]);
+    EXPECT_EQ(1U, store->GetCacheMissCount());
+    EXPECT_TRUE(store->ReadBlock(hash2, buf));
+    EXPECT_EQ(1U, store->GetCacheMissCount());
+
+    BlockStore::block_hash unknown = { };
+    EXPECT_FALSE(store->ReadBlock(unknown, buf));
+}
+
+TEST(DedupCache, Init)
+{
+    const string &manifest = CreateManifestName();
+    EXPECT_EQ("", DedupCache::Create(manifest, CreateStoreFolder(), 4 * 512));
+
+    DedupCache cache1(manifest, 0, 4);
+    EXPECT_FALSE(cache1.Init());
+
+    DedupCache cache2(manifest, 512, 0);
+    EXPECT_FALSE(cache2.Init());
+
+    DedupCache cache3(manifest, 512, 5);
+    EXPECT_FALSE(cache3.Init()) << "Image is too small";
+
+    DedupCache cache4(CreateTempFile(4096).string(), 512, 4);
+    EXPECT_FALSE(cache4.Init()) << "Not a manifest";
+
+    DedupCache cache5(manifest, 512, 4);
+    EXPECT_TRUE(cache5.Init());
+}
+
+TEST(DedupCache, GetImageSize)
+{
+    const string &manifest = CreateManifestName();
+    EXPECT_EQ("", DedupCache::Create(manifest, CreateStoreFolder(), 3 * 512));
+
+    EXPECT_EQ(3 * 512, DedupCache::GetImageSize(manifest));
+    EXPECT_EQ(-1, DedupCache::GetImageSize(CreateTempFile(512).string()));
+    EXPECT_EQ(-1, DedupCache::GetImageSize("missing"));
+}
+
+TEST(DedupCache, IsManifest)
+{
+    EXPECT_TRUE(DedupCache::IsManifest("image.hds.dedup"));
+    EXPECT_FALSE(DedupCache::IsManifest("image.hds"));
+}
+
+TEST(DedupCache, ReadWriteSectors)
+{
+    constexpr int SECTORS = 20;
+    const string &folder = CreateStoreFolder();
+    const string &manifest = CreateManifestName();
+    EXPECT_NE("", DedupCache::Create(manifest, "", SECTORS * 512)) << "Missing block store";
+    EXPECT_EQ("", DedupCache::Create(manifest, folder, SECTORS * 512));
+
+    DedupCache cache(manifest, 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(SECTORS * 512);
+    EXPECT_EQ(0, cache.ReadSectors(buf, SECTORS - 1, 2));
+    EXPECT_EQ(0, cache.WriteSectors(buf, SECTORS - 1, 2));
+
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_TRUE(ranges::all_of(buf, [](uint8_t b) {return !b;}));
+
+    // Sectors covering parts of a block
+    for (int sector = 0; sector < SECTORS; ++sector) {
+        buf[sector * 512] = static_cast<uint8_t>(sector + 1);
+    }
+    EXPECT_EQ(10 * 512, cache.WriteSectors(span(buf).subspan(5 * 512), 5, 10));
+    EXPECT_TRUE(cache.Flush());
+
+    ranges::fill(buf, 0);
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    for (int sector = 0; sector < SECTORS; ++sector) {
+        EXPECT_EQ(sector >= 5 && sector < 15 ? sector + 1 : 0, buf[sector * 512]);
+    }
+
+    DedupCache reopened(manifest, 512, SECTORS);
+    EXPECT_TRUE(reopened.Init());
+    EXPECT_EQ(512, reopened.ReadSectors(buf, 14, 1));
+    EXPECT_EQ(15, buf[0]);
+}
+
+TEST(DedupCache, SharedBlocks)
+{
+    const string &folder = CreateStoreFolder();
+    const string &manifest1 = CreateManifestName();
+    const string &manifest2 = CreateManifestName();
+    EXPECT_EQ("", DedupCache::Create(manifest1, folder, 3 * BlockStore::BLOCK_SIZE));
+    EXPECT_EQ("", DedupCache::Create(manifest2, folder, 3 * BlockStore::BLOCK_SIZE));
+    EXPECT_EQ(1U, BlockStore::GetStore(folder)->GetBlockCount());
+
+    DedupCache cache1(manifest1, 512, 24);
+    EXPECT_TRUE(cache1.Init());
+    DedupCache cache2(manifest2, 512, 24);
+    EXPECT_TRUE(cache2.Init());
+
+    vector<uint8_t> buf(BlockStore::BLOCK_SIZE, 0x55);
+    EXPECT_EQ(BlockStore::BLOCK_SIZE, cache1.WriteSectors(buf, 0, 8));
+    EXPECT_EQ(BlockStore::BLOCK_SIZE, cache2.WriteSectors(buf, 16, 8));
+    EXPECT_EQ(2U, BlockStore::GetStore(folder)->GetBlockCount());
+
+    EXPECT_EQ(BlockStore::BLOCK_SIZE, cache2.ReadSectors(buf, 0, 8));
+    EXPECT_EQ(0, buf[0]) << "Data written to one image must not be visible in other images";
+}
+
+TEST(DedupCache, ImportExport)
+{
+    vector<byte> data(2 * BlockStore::BLOCK_SIZE + 512);
+    data[0] = byte { 1 };
+    data[BlockStore::BLOCK_SIZE] = byte { 1 };
+    data[2 * BlockStore::BLOCK_SIZE] = byte { 2 };
+    const string &image = CreateTempFileWithData(data);
+
+    const string &folder = CreateStoreFolder();
+    const string &manifest = CreateManifestName();
+    EXPECT_NE("", DedupCache::Import("missing", manifest, folder));
+    EXPECT_EQ("", DedupCache::Import(image, manifest, folder));
+    EXPECT_EQ(static_cast<off_t>(data.size()), DedupCache::GetImageSize(manifest));
+    EXPECT_EQ(2U, BlockStore::GetStore(folder)->GetBlockCount());
+
+    const string &exported = CreateTempFile().string();
+    remove(exported);
+    EXPECT_EQ("", DedupCache::Export(manifest, exported));
+    EXPECT_EQ(ReadTempFileToString(image), ReadTempFileToString(exported));
+    EXPECT_NE("", DedupCache::Export(manifest, exported)) << "Image file already exists";
+}
+
+TEST(DedupCache, GetStatistics)
+{
+    const string &manifest = CreateManifestName();
+    EXPECT_EQ("", DedupCache::Create(manifest, CreateStoreFolder(), 512));
+
+    DedupCache cache(manifest, 512, 1);
+    EXPECT_TRUE(cache.Init());
+
+    EXPECT_EQ(3U, cache.GetStatistics(true).size());
+    EXPECT_EQ(4U, cache.GetStatistics(false).size());
+}
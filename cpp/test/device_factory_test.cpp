@@ -51,6 +51,9 @@ TEST(DeviceFactoryTest, GetTypeForFile)
     EXPECT_EQ(factory.GetTypeForFile("test.toast"), SCCD);
     EXPECT_EQ(factory.GetTypeForFile("test.is1"), SCCD);
     EXPECT_EQ(factory.GetTypeForFile("test.suffix.iso"), SCCD);
+    EXPECT_EQ(factory.GetTypeForFile("test.iso.dz"), SCCD);
+    EXPECT_EQ(factory.GetTypeForFile("test.hds.DZ"), SCHD);
+    EXPECT_EQ(factory.GetTypeForFile("test.hda.dedup"), SCHD);
     EXPECT_EQ(factory.GetTypeForFile("daynaport"), SCDP);
     EXPECT_EQ(factory.GetTypeForFile("printer"), SCLP);
     EXPECT_EQ(factory.GetTypeForFile("services"), SCHS);
@@ -59,6 +62,7 @@ TEST(DeviceFactoryTest, GetTypeForFile)
 #endif
     EXPECT_EQ(factory.GetTypeForFile("unknown"), UNDEFINED);
     EXPECT_EQ(factory.GetTypeForFile("test.iso.suffix"), UNDEFINED);
+    EXPECT_EQ(factory.GetTypeForFile("test.dz"), UNDEFINED);
 }
 
 TEST(DeviceFactoryTest, GetExtensionMapping)
@@ -6,8 +6,11 @@
 //
 //---------------------------------------------------------------------------
 
+#include <chrono>
+#include <thread>
 #include <gtest/gtest.h>
 #include "devices/disk_cache.h"
+#include "shared/memory_util.h"
 #include "test_shared.h"
 
 using namespace testing;
@@ -17,8 +20,11 @@ TEST(DiskCache, Init)
     DiskCache cache1("", 512, 0);
     EXPECT_FALSE(cache1.Init());
 
-    DiskCache cache5("test", 512, 1);
-    EXPECT_TRUE(cache5.Init());
+    DiskCache cache2("no_such_file", 512, 1);
+    EXPECT_FALSE(cache2.Init()) << "Missing image file";
+
+    DiskCache cache3(CreateTempFile(512), 512, 1);
+    EXPECT_TRUE(cache3.Init());
 }
 
 TEST(DiskCache, ReadWriteSectors)
@@ -38,10 +44,417 @@ TEST(DiskCache, ReadWriteSectors)
     EXPECT_EQ(123, buf[1]);
 }
 
+TEST(DiskCache, ReadWriteMultipleSectors)
+{
+    // 3 tracks, the last track is incomplete
+    constexpr int SECTORS = 600;
+    DiskCache cache(CreateTempFile(SECTORS * 512), 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(SECTORS * 512);
+    EXPECT_EQ(0, cache.ReadSectors(buf, SECTORS - 1, 2));
+    EXPECT_EQ(0, cache.WriteSectors(buf, SECTORS - 1, 2));
+
+    // Cross the track boundaries
+    for (size_t i = 0; i < 300 * 512; ++i) {
+        buf[i] = static_cast<uint8_t>(i % 251);
+    }
+    const vector<uint8_t> expected = buf;
+    EXPECT_EQ(300 * 512, cache.WriteSectors(buf, 250, 300));
+    ranges::fill(buf, 0);
+
+    EXPECT_EQ(300 * 512, cache.ReadSectors(buf, 250, 300));
+    EXPECT_EQ(expected, buf);
+
+    EXPECT_TRUE(cache.Flush());
+
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(0, buf[249 * 512]);
+    EXPECT_EQ(1, buf[250 * 512 + 1]);
+    EXPECT_EQ(0, buf[550 * 512]);
+}
+
+TEST(DiskCache, Flush)
+{
+    const string &filename = CreateTempFile(32 * 512);
+    DiskCache cache(filename, 512, 32);
+    EXPECT_TRUE(cache.Init());
+
+    // Modified sectors with small and large gaps
+    vector<uint8_t> buf(512);
+    for (const int sector : { 0, 2, 20, 31 }) {
+        buf[0] = static_cast<uint8_t>(sector + 1);
+        EXPECT_EQ(512, cache.WriteSectors(buf, sector, 1));
+    }
+    EXPECT_TRUE(cache.Flush());
+
+    const string &data = ReadTempFileToString(filename);
+    EXPECT_EQ(32U * 512, data.size());
+    for (int sector = 0; sector < 32; ++sector) {
+        const int expected = sector == 0 || sector == 2 || sector == 20 || sector == 31 ? sector + 1 : 0;
+        EXPECT_EQ(expected, data[sector * 512]) << "Wrong data for sector " << sector;
+    }
+}
+
+TEST(DiskCache, Eviction)
+{
+    constexpr int SECTORS = 4 * 256;
+    DiskCache cache(CreateTempFile(SECTORS * 512), 512, SECTORS, 2);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(512);
+    buf[0] = 1;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 0, 1));
+    buf[0] = 2;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 256, 1));
+
+    // Track 1 has most recently been used, track 0 has to be evicted
+    EXPECT_EQ(512, cache.ReadSectors(buf, 256, 1));
+    EXPECT_EQ(512, cache.ReadSectors(buf, 512, 1));
+    EXPECT_EQ(512, cache.ReadSectors(buf, 768, 1));
+
+    // Both tracks have been written back, track 0 has to be reloaded
+    EXPECT_EQ(512, cache.ReadSectors(buf, 0, 1));
+    EXPECT_EQ(1, buf[0]);
+    EXPECT_EQ(512, cache.ReadSectors(buf, 256, 1));
+    EXPECT_EQ(2, buf[0]);
+
+    const auto &statistics = cache.GetStatistics(false);
+    EXPECT_EQ(6U, statistics[0].value()) << "Wrong number of read cache misses";
+    EXPECT_EQ(2U, statistics[1].value()) << "Wrong number of write cache misses";
+}
+
+TEST(DiskCache, BorrowSectors)
+{
+    constexpr int SECTORS = 3 * 256;
+    DiskCache cache(CreateTempFile(SECTORS * 512), 512, SECTORS, 2);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(512);
+    buf[0] = 1;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 255, 1));
+
+    EXPECT_FALSE(cache.BorrowSectors(SECTORS - 1, 2).second);
+    EXPECT_FALSE(cache.BorrowSectors(0, 0).second);
+    EXPECT_FALSE(cache.BorrowSectors(255, 2).second) << "Sectors of different tracks cannot be borrowed";
+
+    const auto& [data, pin] = cache.BorrowSectors(254, 2);
+    EXPECT_TRUE(pin);
+    EXPECT_EQ(2U * 512, data.size());
+    EXPECT_EQ(1, data[512]);
+
+    // Evicting the track with the borrowed data must not recycle its buffer
+    EXPECT_EQ(512, cache.ReadSectors(buf, 256, 1));
+    EXPECT_EQ(512, cache.ReadSectors(buf, 512, 1));
+    EXPECT_EQ(1, data[512]);
+
+    EXPECT_EQ(512, cache.ReadSectors(buf, 255, 1));
+    EXPECT_EQ(1, buf[0]);
+}
+
+TEST(DiskCache, TrackSectors)
+{
+    constexpr int SECTORS = 40;
+    DiskCache cache(CreateTempFile(SECTORS * 512), 512, SECTORS, 2, 16);
+    EXPECT_TRUE(cache.Init());
+    EXPECT_EQ(16U * 512, cache.GetTrackSize());
+
+    vector<uint8_t> buf(SECTORS * 512);
+    buf[15 * 512] = 1;
+    buf[16 * 512] = 2;
+    buf[39 * 512] = 3;
+    EXPECT_EQ(SECTORS * 512, cache.WriteSectors(buf, 0, SECTORS));
+    ranges::fill(buf, 0);
+
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(1, buf[15 * 512]);
+    EXPECT_EQ(2, buf[16 * 512]);
+    EXPECT_EQ(3, buf[39 * 512]);
+
+    // 3 tracks with 2 cached tracks, each track is loaded twice
+    EXPECT_EQ(6U, cache.GetStatistics(false)[0].value()) << "Wrong number of read cache misses";
+}
+
+TEST(DiskCache, SetMaxTracks)
+{
+    constexpr int SECTORS = 4 * 256;
+    DiskCache cache(CreateTempFile(SECTORS * 512), 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+    EXPECT_EQ(16, cache.GetMaxTracks());
+
+    vector<uint8_t> buf(SECTORS * 512);
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(4U, cache.GetStatistics(false)[0].value());
+
+    buf[0] = 1;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 0, 1));
+
+    // Only track 1 remains, modified track 0 has to be saved
+    EXPECT_EQ(512, cache.ReadSectors(buf, 256, 1));
+    EXPECT_TRUE(cache.SetMaxTracks(1));
+    EXPECT_EQ(1, cache.GetMaxTracks());
+    EXPECT_EQ(1U, cache.GetStatistics(false)[1].value());
+
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(1, buf[0]);
+    EXPECT_EQ(8U, cache.GetStatistics(false)[0].value());
+}
+
+TEST(DiskCache, LookupCost)
+{
+    constexpr int SECTOR_SIZE = 256;
+    constexpr int LOOKUPS = 200'000;
+
+    const string &filename = CreateTempFile(256 * 256 * SECTOR_SIZE);
+
+    vector<uint8_t> buf(SECTOR_SIZE);
+
+    // Measure the average cost of a cache hit for different cache sizes
+    array<double, 2> ns = { };
+    for (int i = 0; i < 2; ++i) {
+        const int tracks = i ? 256 : 16;
+        DiskCache cache(filename, SECTOR_SIZE, tracks * 256, tracks);
+        EXPECT_TRUE(cache.Init());
+
+        for (int track = 0; track < tracks; ++track) {
+            EXPECT_EQ(SECTOR_SIZE, cache.ReadSectors(buf, track << 8, 1));
+        }
+
+        const auto start = chrono::steady_clock::now();
+        for (int lookup = 0; lookup < LOOKUPS; ++lookup) {
+            cache.ReadSectors(buf, ((lookup * 7919) % tracks) << 8, 1);
+        }
+        ns[i] = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - start).count()) / LOOKUPS;
+
+        // All lookups must have been cache hits
+        EXPECT_EQ(static_cast<uint64_t>(tracks), cache.GetStatistics(true)[0].value());
+    }
+
+    // The lookup cost must not grow with the number of cached tracks like with a linear search
+    EXPECT_LT(ns[1], ns[0] * 8) << "Average lookup time: " << ns[0] << " ns for 16 tracks, " << ns[1]
+        << " ns for 256 tracks";
+}
+
+TEST(DiskCache, Prefetch)
+{
+    constexpr int TRACKS = 16;
+    vector<byte> data(TRACKS * 16 * 512);
+    for (int track = 0; track < TRACKS; ++track) {
+        data[track * 16 * 512] = static_cast<byte>(track + 1);
+    }
+    DiskCache cache(CreateTempFileWithData(data), 512, TRACKS * 16, TRACKS, 16);
+    EXPECT_TRUE(cache.Init());
+
+    // Read the tracks sequentially, the prefetcher loads up to 4 tracks ahead on its own thread
+    vector<uint8_t> buf(16 * 512);
+    for (int track = 0; track < TRACKS; ++track) {
+        EXPECT_EQ(16 * 512, cache.ReadSectors(buf, track * 16, 16));
+        EXPECT_EQ(track + 1, buf[0]);
+
+        this_thread::sleep_for(20ms);
+    }
+
+    const auto &statistics = cache.GetStatistics(true);
+    EXPECT_EQ("cache_miss_read_count", statistics[0].key());
+    EXPECT_LT(statistics[0].value(), static_cast<uint64_t>(TRACKS));
+    EXPECT_EQ("prefetch_hit_count", statistics[1].key());
+    EXPECT_EQ(TRACKS, statistics[0].value() + statistics[1].value());
+}
+
+TEST(DiskCache, WriteBack)
+{
+    constexpr int SECTORS = 4 * 16;
+    const string &filename = CreateTempFile(SECTORS * 512);
+    DiskCache cache(filename, 512, SECTORS, 4, 16);
+    // Only the age triggers the write-back
+    cache.SetWriteBack(10, 0);
+    EXPECT_TRUE(cache.Init());
+
+    // Modify sectors in the adjacent tracks 0 and 1 and in track 3
+    vector<uint8_t> buf(512);
+    buf[0] = 1;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 15, 1));
+    buf[0] = 2;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 16, 1));
+    buf[0] = 3;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 63, 1));
+
+    for (int i = 0; i < 1000 && cache.GetStatistics(false)[1].value() < 2; ++i) {
+        this_thread::sleep_for(1ms);
+    }
+
+    // Adjacent tracks are written with a single write
+    EXPECT_EQ(2U, cache.GetStatistics(false)[1].value()) << "Wrong number of write-backs";
+    const string &data = ReadTempFileToString(filename);
+    EXPECT_EQ(1, data[15 * 512]);
+    EXPECT_EQ(2, data[16 * 512]);
+    EXPECT_EQ(3, data[63 * 512]);
+
+    // The tracks are unmodified now, so eviction and flushing do not write anything
+    EXPECT_EQ(512, cache.ReadSectors(buf, 32, 1));
+    EXPECT_TRUE(cache.Flush());
+    EXPECT_EQ(2U, cache.GetStatistics(false)[1].value());
+}
+
+TEST(DiskCache, WriteBackThreshold)
+{
+    constexpr int SECTORS = 4 * 16;
+    const string &filename = CreateTempFile(SECTORS * 512);
+    DiskCache cache(filename, 512, SECTORS, 4, 16);
+    cache.SetWriteBack(0, 2 * 512);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(512);
+    buf[0] = 1;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 0, 1));
+
+    // Below the threshold there is no write-back
+    this_thread::sleep_for(20ms);
+    EXPECT_EQ(0U, cache.GetStatistics(false)[1].value());
+
+    EXPECT_EQ(512, cache.WriteSectors(buf, 2, 1));
+    for (int i = 0; i < 1000 && !cache.GetStatistics(false)[1].value(); ++i) {
+        this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(1U, cache.GetStatistics(false)[1].value());
+    EXPECT_EQ(1, ReadTempFileToString(filename)[2 * 512]);
+}
+
+TEST(DiskCache, DirectIo)
+{
+    constexpr int SECTORS = 2 * 256;
+    const string &filename = CreateTempFile(SECTORS * 512);
+    DiskCache cache(filename, 512, SECTORS);
+    cache.SetDirectIo(true);
+    EXPECT_TRUE(cache.Init());
+
+    memory_util::aligned_buffer buf(SECTORS * 512);
+    buf[1] = 123;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 5, 1));
+    EXPECT_TRUE(cache.Flush());
+    EXPECT_EQ(123, ReadTempFileToString(filename)[5 * 512 + 1]);
+
+    // Track 0 is cached, the modified data must be returned
+    buf[1] = 0;
+    buf[2] = 124;
+    EXPECT_EQ(512, cache.WriteSectors(buf, 6, 1));
+    ranges::fill(buf, 0);
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(123, buf[5 * 512 + 1]);
+    EXPECT_EQ(124, buf[6 * 512 + 2]);
+
+    // Nothing is cached, the data are read straight into the buffer
+    DiskCache uncached(filename, 512, SECTORS);
+    uncached.SetDirectIo(true);
+    EXPECT_TRUE(uncached.Init());
+    ranges::fill(buf, 0);
+    EXPECT_EQ(SECTORS * 512, uncached.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(123, buf[5 * 512 + 1]);
+}
+
+TEST(DiskCache, ZeroSectors)
+{
+    constexpr int SECTORS = 2 * 256;
+    const string &filename = CreateTempFile(SECTORS * 512);
+    DiskCache cache(filename, 512, SECTORS, 4);
+    EXPECT_TRUE(cache.Init());
+
+    EXPECT_FALSE(cache.ZeroSectors(SECTORS - 1, 2, true));
+
+    vector<uint8_t> buf(SECTORS * 512, 0xff);
+    EXPECT_EQ(SECTORS * 512, cache.WriteSectors(buf, 0, SECTORS));
+
+    // The modified sectors of a partially zeroed track must be preserved, a completely zeroed track is discarded
+    if (!cache.ZeroSectors(255, 257, true)) {
+        GTEST_SKIP() << "The filesystem does not support deallocating";
+    }
+
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(0xff, buf[254 * 512]);
+    EXPECT_EQ(0, buf[255 * 512]);
+    EXPECT_EQ(0, buf[SECTORS * 512 - 1]);
+
+    EXPECT_TRUE(cache.Flush());
+    const string &data = ReadTempFileToString(filename);
+    EXPECT_EQ('\xff', data[254 * 512]);
+    EXPECT_EQ(0, data[255 * 512]);
+    EXPECT_EQ(0, data[SECTORS * 512 - 1]);
+}
+
+TEST(DiskCache, IsZero)
+{
+    vector<uint8_t> buf(4096);
+    EXPECT_TRUE(Cache::IsZero(buf));
+    EXPECT_TRUE(Cache::IsZero(span(buf.data(), 0)));
+    buf[4095] = 1;
+    EXPECT_FALSE(Cache::IsZero(buf));
+    buf[4095] = 0;
+    buf[0] = 1;
+    EXPECT_FALSE(Cache::IsZero(buf));
+}
+
 TEST(DiskCache, GetStatistics)
 {
     DiskCache cache("", 512, 0);
 
-    EXPECT_EQ(2U, cache.GetStatistics(true).size());
-    EXPECT_EQ(4U, cache.GetStatistics(false).size());
+    EXPECT_EQ(7U, cache.GetStatistics(true).size());
+    EXPECT_EQ(13U, cache.GetStatistics(false).size());
+}
+
+TEST(DiskCache, GetEffectivenessStatistics)
+{
+    DiskCache cache(CreateTempFile(2 * 256 * 512), 512, 2 * 256, 1);
+    EXPECT_TRUE(cache.Init());
+
+    const auto &get_value = [&cache](const string &key) {
+        for (const auto &s : cache.GetStatistics(false)) {
+            if (s.key() == key) {
+                return s.value();
+            }
+        }
+        return UINT64_MAX;
+    };
+
+    vector<uint8_t> buf(2 * 512);
+    EXPECT_EQ(512, cache.ReadSectors(buf, 0, 1));
+    EXPECT_EQ(0U, get_value("cache_hit_read_count"));
+    EXPECT_EQ(512, cache.ReadSectors(buf, 1, 1));
+    EXPECT_EQ(1U, get_value("cache_hit_read_count"));
+    EXPECT_EQ(1024U, get_value("served_read_byte_count"));
+    EXPECT_EQ(256U * 512, get_value("cache_resident_bytes"));
+
+    // Only sectors with changed data are modified
+    buf[0] = 1;
+    buf[512] = 1;
+    EXPECT_EQ(2 * 512, cache.WriteSectors(buf, 0, 2));
+    EXPECT_EQ(1U, get_value("cache_hit_write_count"));
+    EXPECT_EQ(1024U, get_value("served_write_byte_count"));
+    EXPECT_EQ(1024U, get_value("cache_dirty_bytes"));
+    EXPECT_EQ(0U, get_value("cache_eviction_count"));
+
+    // The modified track is written back when it is replaced
+    EXPECT_EQ(512, cache.ReadSectors(buf, 256, 1));
+    EXPECT_EQ(1U, get_value("cache_eviction_count"));
+    EXPECT_EQ(0U, get_value("cache_dirty_bytes"));
+    EXPECT_EQ(1024U, get_value("write_back_byte_count"));
+}
+
+TEST(DiskCache, GetLatencyStatistics)
+{
+    DiskCache cache(CreateTempFile(512), 512, 1);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(512);
+    EXPECT_EQ(512, cache.ReadSectors(buf, 0, 1));
+    EXPECT_EQ(512, cache.WriteSectors(buf, 0, 1));
+    EXPECT_TRUE(cache.Flush());
+
+    const auto &statistics = cache.GetStatistics(false);
+    EXPECT_TRUE(ranges::any_of(statistics, [](const PbStatistics &s) {
+        return s.key() == "load_latency_count" && s.value() == 1;
+    }));
+    EXPECT_TRUE(ranges::any_of(statistics, [](const PbStatistics &s) {
+        return s.key() == "save_latency_count" && s.value() == 1;
+    }));
 }
@@ -7,7 +7,10 @@
 //---------------------------------------------------------------------------
 
 #include "mocks.h"
+#include "devices/dedup_cache.h"
 #include "devices/disk.h"
+#include "devices/group_commit.h"
+#include "devices/uring_cache.h"
 #include "shared/s2p_exceptions.h"
 
 using namespace memory_util;
@@ -49,6 +52,99 @@ TEST(DiskTest, ValidateFile)
     EXPECT_NO_THROW(disk.ValidateFile());
 }
 
+TEST(DiskTest, CacheParams)
+{
+    NiceMock<MockDisk> disk;
+    disk.SetCachingMode(PbCachingMode::PISCSI);
+    disk.SetBlockCount(1);
+    disk.SetFilename(CreateImageFile(disk, 512));
+
+    disk.SetParams( { { "cache_tracks", "0" } });
+    EXPECT_THROW(disk.ValidateFile(), IoException)<< "Invalid number of cache tracks";
+
+    disk.SetParams( { { "track_sectors", "3" } });
+    EXPECT_THROW(disk.ValidateFile(), IoException)<< "Number of sectors per track is not a power of 2";
+
+    disk.SetParams( { { "flush_age", "-1" } });
+    EXPECT_THROW(disk.ValidateFile(), IoException)<< "Invalid write-back age";
+
+    disk.SetParams( { { "flush_threshold", "x" } });
+    EXPECT_THROW(disk.ValidateFile(), IoException)<< "Invalid write-back threshold";
+
+    disk.SetParams( { { "cache_tracks", "32" }, { "track_sectors", "64" } });
+    EXPECT_NO_THROW(disk.ValidateFile());
+
+    disk.SetParams( { { "flush_age", "0" }, { "flush_threshold", "0" } });
+    EXPECT_NO_THROW(disk.ValidateFile());
+
+    Disk::SetCacheMemory(1024 * 1024);
+    disk.SetParams( { });
+    EXPECT_NO_THROW(disk.ValidateFile());
+    Disk::SetCacheMemory(0);
+}
+
+TEST(DiskTest, GetDefaultParams)
+{
+    MockDisk disk;
+
+    const auto &params = disk.GetDefaultParams();
+    EXPECT_EQ(5U, params.size());
+    EXPECT_EQ("16", params.at("cache_tracks"));
+    EXPECT_EQ("256", params.at("track_sectors"));
+    EXPECT_EQ("1000", params.at("flush_age"));
+    EXPECT_EQ("1024", params.at("flush_threshold"));
+    EXPECT_EQ("", params.at("base"));
+}
+
+TEST(DiskTest, Overlay)
+{
+    NiceMock<MockDisk> disk;
+    disk.SetCachingMode(PbCachingMode::PISCSI);
+    const path &base = CreateTempFile(4096);
+    const path &delta = CreateTempFile();
+    disk.SetFilename(delta.string());
+
+    disk.SetParams( { { "base", "missing" } });
+    EXPECT_THROW(disk.GetFileSize(), IoException);
+    EXPECT_EQ(0, disk.GetFileSize(true));
+
+    // A relative path is relative to the folder of the delta file
+    disk.SetParams( { { "base", base.filename().string() } });
+    EXPECT_EQ(4096, disk.GetFileSize());
+
+    disk.SetParams( { { "base", delta.string() } });
+    disk.SetBlockCount(1);
+    EXPECT_THROW(disk.ValidateFile(), IoException)<< "Base image and delta file are identical";
+
+    disk.SetParams( { { "base", base.string() } });
+    disk.SetBlockCount(8);
+    EXPECT_NO_THROW(disk.ValidateFile());
+    EXPECT_EQ(PbCachingMode::PISCSI, disk.GetCachingMode());
+    EXPECT_LT(0, file_size(delta)) << "Delta file was not initialized";
+    EXPECT_EQ(4096, file_size(base));
+}
+
+TEST(DiskTest, Dedup)
+{
+    NiceMock<MockDisk> disk;
+    disk.SetCachingMode(PbCachingMode::PISCSI);
+    const string &manifest = CreateTempFile(0, "hds.dedup").string();
+    const path &folder = CreateTempFile();
+    remove(folder);
+    disk.SetFilename(manifest);
+
+    EXPECT_THROW(disk.GetFileSize(), IoException);
+    EXPECT_EQ(0, disk.GetFileSize(true));
+
+    EXPECT_EQ("", DedupCache::Create(manifest, folder.string(), 8 * 512));
+    EXPECT_EQ(8 * 512, disk.GetFileSize());
+    EXPECT_LT(8 * 512, file_size(manifest));
+
+    disk.SetBlockCount(8);
+    EXPECT_NO_THROW(disk.ValidateFile());
+    EXPECT_FALSE(disk.IsReadOnly());
+}
+
 TEST(DiskTest, Rezero)
 {
     auto [controller, disk] = CreateDisk();
@@ -190,6 +286,7 @@ TEST(DiskTest, ReadCapacity16)
     EXPECT_EQ(0x4320, GetInt16(buf, 6));
     EXPECT_EQ(0x0000, GetInt16(buf, 8));
     EXPECT_EQ(0x0400, GetInt16(buf, 10));
+    EXPECT_EQ(0xc0, buf[14]) << "LBPME and LBPRZ must be set";
 }
 
 TEST(DiskTest, ReadFormatCapacities)
@@ -366,10 +463,193 @@ TEST(DiskTest, Write10)
     EXPECT_EQ(512, controller->GetRemainingLength());
     EXPECT_NO_THROW(disk->WriteData(controller->GetCdb(), controller->GetBuffer(), 0, 512));
 
+    // FUA
+    vector<int> cdb(10);
+    cdb[0] = static_cast<int>(ScsiCommand::WRITE_10);
+    cdb[1] = 0x08;
+    cdb[8] = 1;
+    const uint64_t sync_count = GroupCommit::Instance().GetSyncCount();
+    controller->SetCdbByte(1, 0x08);
+    controller->SetCdbByte(8, 1);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::WRITE_10));
+    EXPECT_NO_THROW(disk->WriteData(cdb, controller->GetBuffer(), 0, 512));
+    EXPECT_EQ(sync_count + 1, GroupCommit::Instance().GetSyncCount()) << "FUA write must sync the image file";
+
     controller->SetCdbByte(8, 2);
     Dispatch(disk, ScsiCommand::WRITE_10, SenseKey::ILLEGAL_REQUEST, Asc::LBA_OUT_OF_RANGE);
 }
 
+TEST(DiskTest, WriteSame10)
+{
+    auto [controller, disk] = CreateDisk();
+
+    Dispatch(disk, ScsiCommand::WRITE_SAME_10, SenseKey::NOT_READY, Asc::MEDIUM_NOT_PRESENT,
+        "WRITE SAME(10) must fail because drive is not ready");
+
+    disk->SetCachingMode(PbCachingMode::PISCSI);
+    const string &filename = CreateImageFile(*disk, 4 * 512);
+    disk->SetBlockCount(4);
+    disk->ValidateFile();
+    disk->SetProtected(false);
+
+    controller->SetCdbByte(1, 0x02);
+    Dispatch(disk, ScsiCommand::WRITE_SAME_10, SenseKey::ILLEGAL_REQUEST, Asc::INVALID_FIELD_IN_CDB,
+        "LBDATA is not supported");
+
+    controller->SetCdbByte(5, 3);
+    controller->SetCdbByte(8, 2);
+    Dispatch(disk, ScsiCommand::WRITE_SAME_10, SenseKey::ILLEGAL_REQUEST, Asc::LBA_OUT_OF_RANGE);
+
+    controller->SetCdbByte(5, 1);
+    controller->SetCdbByte(8, 2);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::WRITE_SAME_10));
+    EXPECT_EQ(512, controller->GetRemainingLength());
+
+    auto &buf = controller->GetBuffer();
+    buf[0] = 0x12;
+    buf[511] = 0x34;
+    controller->SetCdbByte(0, static_cast<int>(ScsiCommand::WRITE_SAME_10));
+    controller->SetCdbByte(5, 1);
+    controller->SetCdbByte(8, 2);
+    EXPECT_NO_THROW(disk->WriteData(controller->GetCdb(), buf, 0, 512));
+    disk->Disk::FlushCache();
+    string data = ReadTempFileToString(filename);
+    EXPECT_EQ(0, data[0]);
+    EXPECT_EQ(0x12, data[512]);
+    EXPECT_EQ(0x34, data[1023]);
+    EXPECT_EQ(0x12, data[1024]);
+    EXPECT_EQ(0x34, data[1535]);
+    EXPECT_EQ(0, data[1536]);
+
+    // 0 sectors means all sectors up to the last one, zeros are not written
+    ranges::fill(buf, 0);
+    controller->SetCdbByte(1, 0x08);
+    controller->SetCdbByte(5, 2);
+    controller->SetCdbByte(8, 0);
+    EXPECT_NO_THROW(disk->WriteData(controller->GetCdb(), buf, 0, 512));
+    disk->Disk::FlushCache();
+    data = ReadTempFileToString(filename);
+    EXPECT_EQ(4U * 512, data.size());
+    EXPECT_EQ(0x12, data[512]);
+    EXPECT_EQ(0, data[1024]);
+    EXPECT_EQ(0, data[1535]);
+}
+
+TEST(DiskTest, WriteSame16)
+{
+    auto [controller, disk] = CreateDisk();
+
+    disk->SetCachingMode(PbCachingMode::LINUX);
+    const string &filename = CreateImageFile(*disk, 2 * 512);
+    disk->SetBlockCount(2);
+    disk->ValidateFile();
+    disk->SetProtected(false);
+
+    controller->SetCdbByte(13, 3);
+    Dispatch(disk, ScsiCommand::ERASE_WRITE_SAME_16, SenseKey::ILLEGAL_REQUEST, Asc::LBA_OUT_OF_RANGE);
+
+    controller->SetCdbByte(13, 2);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::ERASE_WRITE_SAME_16));
+    EXPECT_EQ(512, controller->GetRemainingLength());
+
+    auto &buf = controller->GetBuffer();
+    ranges::fill(buf, 0xff);
+    controller->SetCdbByte(0, static_cast<int>(ScsiCommand::ERASE_WRITE_SAME_16));
+    controller->SetCdbByte(13, 2);
+    EXPECT_NO_THROW(disk->WriteData(controller->GetCdb(), buf, 0, 512));
+    disk->Disk::FlushCache();
+    EXPECT_EQ(string(2 * 512, '\xff'), ReadTempFileToString(filename));
+
+    // NDOB, without a cache supporting zeroing the zeros are written
+    EXPECT_CALL(*controller, Status);
+    controller->SetCdbByte(1, 0x09);
+    controller->SetCdbByte(9, 1);
+    controller->SetCdbByte(13, 1);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::ERASE_WRITE_SAME_16));
+    disk->Disk::FlushCache();
+    const string &data = ReadTempFileToString(filename);
+    EXPECT_EQ('\xff', data[511]);
+    EXPECT_EQ(0, data[512]);
+    EXPECT_EQ(0, data[1023]);
+}
+
+TEST(DiskTest, Unmap)
+{
+    auto [controller, disk] = CreateDisk();
+
+    Dispatch(disk, ScsiCommand::READ_SUB_CHANNEL_UNMAP, SenseKey::NOT_READY, Asc::MEDIUM_NOT_PRESENT,
+        "UNMAP must fail because drive is not ready");
+
+    disk->SetCachingMode(PbCachingMode::PISCSI);
+    const string &filename = CreateImageFile(*disk, 4 * 512);
+    disk->SetBlockCount(4);
+    disk->ValidateFile();
+    disk->SetProtected(false);
+
+    controller->SetCdbByte(1, 0x01);
+    Dispatch(disk, ScsiCommand::READ_SUB_CHANNEL_UNMAP, SenseKey::ILLEGAL_REQUEST, Asc::INVALID_FIELD_IN_CDB,
+        "ANCHOR is not supported");
+
+    EXPECT_CALL(*controller, Status);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::READ_SUB_CHANNEL_UNMAP));
+
+    controller->SetCdbByte(8, 40);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::READ_SUB_CHANNEL_UNMAP));
+    EXPECT_EQ(40, controller->GetRemainingLength());
+
+    // Fill all sectors
+    const vector<uint8_t> sector(512, 0xff);
+    controller->SetCdbByte(0, static_cast<int>(ScsiCommand::WRITE_SAME_10));
+    EXPECT_NO_THROW(disk->WriteData(controller->GetCdb(), sector, 0, 512));
+
+    vector<uint8_t> buf(40);
+    controller->SetCdbByte(0, static_cast<int>(ScsiCommand::READ_SUB_CHANNEL_UNMAP));
+    EXPECT_THROW(disk->WriteData(controller->GetCdb(), buf, 0, 7), ScsiException) << "Parameter list is too short";
+
+    SetInt16(buf, 2, 32);
+    SetInt64(buf, 8, 1);
+    SetInt32(buf, 16, 2);
+    SetInt64(buf, 24, 3);
+    SetInt32(buf, 32, 2);
+    EXPECT_THROW(disk->WriteData(controller->GetCdb(), buf, 0, 40), ScsiException)
+        << "No sector must be unmapped if any descriptor is invalid";
+    disk->Disk::FlushCache();
+    EXPECT_EQ(string(4 * 512, '\xff'), ReadTempFileToString(filename));
+
+    SetInt32(buf, 32, 1);
+    EXPECT_NO_THROW(disk->WriteData(controller->GetCdb(), buf, 0, 40));
+    disk->Disk::FlushCache();
+    EXPECT_EQ(string(512, '\xff') + string(3 * 512, 0), ReadTempFileToString(filename));
+}
+
+TEST(DiskTest, WriteBehind)
+{
+    auto [controller, disk] = CreateDisk();
+
+    vector<int> cdb(10);
+    cdb[0] = static_cast<int>(ScsiCommand::WRITE_10);
+    EXPECT_FALSE(disk->IsWriteBehindSupported(cdb)) << "There is no cache yet";
+
+    disk->SetReady(true);
+    disk->SetBlockCount(2);
+    disk->SetFilename(CreateImageFile(*disk, 1024));
+    disk->ValidateFile();
+    EXPECT_TRUE(disk->IsWriteBehindSupported(cdb));
+    cdb[0] = static_cast<int>(ScsiCommand::WRITE_SAME_10);
+    EXPECT_FALSE(disk->IsWriteBehindSupported(cdb)) << "Only plain writes are supported";
+
+    controller->SetCdbByte(8, 2);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::WRITE_10));
+    EXPECT_EQ(1024, controller->GetRemainingLength());
+    cdb[0] = static_cast<int>(ScsiCommand::WRITE_10);
+    vector<uint8_t> buf(512);
+    // With the LINUX caching mode each sector is a separate chunk
+    EXPECT_NO_THROW(disk->WriteBehind(cdb, buf, false));
+    EXPECT_EQ(1U, disk->GetNextSector());
+    EXPECT_NO_THROW(disk->WriteBehind(cdb, buf, true));
+    EXPECT_EQ(2U, disk->GetNextSector());
+}
+
 TEST(DiskTest, Write16)
 {
     auto [controller, disk] = CreateDisk();
@@ -683,6 +963,7 @@ TEST(DiskTest, ModeSense6)
     controller->SetCdbByte(2, 0x08);
     EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::MODE_SENSE_6));
     ValidateCachingPage(*controller, 12);
+    EXPECT_EQ(0x10, controller->GetBuffer()[2]) << "DPOFUA must be set";
 }
 
 TEST(DiskTest, ModeSense10)
@@ -700,6 +981,7 @@ TEST(DiskTest, ModeSense10)
     controller->SetCdbByte(2, 0x08);
     EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::MODE_SENSE_10));
     ValidateCachingPage(*controller, 16);
+    EXPECT_EQ(0x10, controller->GetBuffer()[3]) << "DPOFUA must be set";
 }
 
 TEST(DiskTest, ReadData)
@@ -724,15 +1006,23 @@ TEST(DiskTest, SynchronizeCache)
 {
     auto [controller, disk] = CreateDisk();
 
-    EXPECT_CALL(*disk, FlushCache);
     EXPECT_CALL(*controller, Status);
     EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::SYNCHRONIZE_CACHE_10));
     EXPECT_EQ(StatusCode::GOOD, controller->GetStatus());
 
-    EXPECT_CALL(*disk, FlushCache);
     EXPECT_CALL(*controller, Status);
     EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::SYNCHRONIZE_CACHE_SPACE_16));
     EXPECT_EQ(StatusCode::GOOD, controller->GetStatus());
+
+    // The image file is synced
+    disk->SetBlockCount(1);
+    disk->SetFilename(CreateImageFile(*disk, 512));
+    disk->ValidateFile();
+    disk->SetReady(true);
+    const uint64_t sync_count = GroupCommit::Instance().GetSyncCount();
+    EXPECT_CALL(*controller, Status);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::SYNCHRONIZE_CACHE_10));
+    EXPECT_EQ(sync_count + 1, GroupCommit::Instance().GetSyncCount());
 }
 
 TEST(DiskTest, ReadDefectData)
@@ -757,7 +1047,7 @@ TEST(DiskTest, ChangeBlockSize)
 
 TEST(DiskTest, CachingMode)
 {
-    MockDisk disk;
+    NiceMock<MockDisk> disk;
 
     disk.SetCachingMode(PbCachingMode::PISCSI);
     EXPECT_EQ(PbCachingMode::PISCSI, disk.GetCachingMode());
@@ -770,6 +1060,59 @@ TEST(DiskTest, CachingMode)
 
     disk.SetCachingMode(PbCachingMode::WRITE_THROUGH);
     EXPECT_EQ(PbCachingMode::WRITE_THROUGH, disk.GetCachingMode());
+
+    disk.SetCachingMode(PbCachingMode::IO_URING);
+    EXPECT_EQ(PbCachingMode::IO_URING, disk.GetCachingMode());
+
+    // Without kernel support there is a fallback
+    disk.SetBlockCount(1);
+    disk.SetFilename(CreateImageFile(disk, 512));
+    EXPECT_NO_THROW(disk.ValidateFile());
+    EXPECT_EQ(UringCache::IsAvailable() ? PbCachingMode::IO_URING : PbCachingMode::LINUX_OPTIMIZED,
+        disk.GetCachingMode());
+
+    disk.SetCachingMode(PbCachingMode::MMAP);
+    EXPECT_NO_THROW(disk.ValidateFile());
+    EXPECT_EQ(PbCachingMode::MMAP, disk.GetCachingMode());
+
+    disk.SetCachingMode(PbCachingMode::DIRECT_IO);
+    EXPECT_NO_THROW(disk.ValidateFile());
+    EXPECT_EQ(PbCachingMode::DIRECT_IO, disk.GetCachingMode());
+}
+
+TEST(DiskTest, AutoCachingMode)
+{
+    auto [controller, disk] = CreateDisk();
+
+    disk->SetCachingMode(PbCachingMode::AUTO);
+    EXPECT_EQ(PbCachingMode::AUTO, disk->GetCachingMode());
+
+    disk->SetReady(true);
+    disk->SetBlockCount(CachingModeSelector::WINDOW_SIZE * 128);
+    disk->SetFilename(CreateImageFile(*disk, CachingModeSelector::WINDOW_SIZE * 128 * 512));
+    disk->ValidateFile();
+    EXPECT_EQ(PbCachingMode::AUTO, disk->GetCachingMode());
+
+    // Large sequential requests, the transfers are not relevant
+    for (int i = 0; i < CachingModeSelector::WINDOW_SIZE; ++i) {
+        disk->UpdateCachingMode(i * 128, 128);
+    }
+    EXPECT_EQ(PbCachingMode::AUTO, disk->GetCachingMode());
+
+    controller->SetCdbByte(8, 1);
+    EXPECT_CALL(*controller, DataIn);
+    EXPECT_NO_THROW(Dispatch(disk, ScsiCommand::READ_10));
+
+    const auto &statistics = disk->GetStatistics();
+    const auto &mode = ranges::find_if(statistics, [](const auto &s) {return s.key() == "auto_caching_mode";});
+    ASSERT_NE(statistics.end(), mode);
+    EXPECT_EQ(static_cast<uint64_t>(PbCachingMode::LINUX_OPTIMIZED), mode->value());
+    const auto &count = ranges::find_if(statistics, [](const auto &s) {return s.key() == "caching_mode_switch_count";});
+    ASSERT_NE(statistics.end(), count);
+    EXPECT_EQ(1U, count->value());
+
+    disk->SetCachingMode(PbCachingMode::PISCSI);
+    EXPECT_EQ(PbCachingMode::PISCSI, disk->GetCachingMode());
 }
 
 TEST(DiskTest, GetStatistics)
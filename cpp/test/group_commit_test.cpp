@@ -0,0 +1,63 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "devices/group_commit.h"
+#include "test_shared.h"
+
+using namespace testing;
+
+TEST(GroupCommitTest, Sync)
+{
+    GroupCommit &group_commit = GroupCommit::Instance();
+
+    EXPECT_FALSE(group_commit.Sync(-1));
+
+    const int fd = open(CreateTempFile(512).c_str(), O_RDWR);
+    ASSERT_NE(-1, fd);
+
+    const uint64_t sync_count = group_commit.GetSyncCount();
+    EXPECT_TRUE(group_commit.Sync(fd));
+    EXPECT_EQ(sync_count + 1, group_commit.GetSyncCount());
+
+    close(fd);
+    EXPECT_FALSE(group_commit.Sync(fd)) << "File descriptor is not valid anymore";
+}
+
+TEST(GroupCommitTest, ConcurrentSync)
+{
+    GroupCommit &group_commit = GroupCommit::Instance();
+
+    const int fd = open(CreateTempFile(512).c_str(), O_RDWR);
+    ASSERT_NE(-1, fd);
+
+    constexpr int THREADS = 8;
+
+    const uint64_t sync_count = group_commit.GetSyncCount();
+
+    vector<thread> threads;
+    atomic_int success_count = 0;
+    for (int i = 0; i < THREADS; ++i) {
+        threads.emplace_back([&group_commit, &success_count, fd] {
+            if (group_commit.Sync(fd)) {
+                ++success_count;
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(THREADS, success_count);
+    EXPECT_GE(sync_count + THREADS, group_commit.GetSyncCount()) << "Requests for the same file must be merged";
+    EXPECT_LT(sync_count, group_commit.GetSyncCount());
+
+    close(fd);
+}
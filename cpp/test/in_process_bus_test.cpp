@@ -6,6 +6,7 @@
 //
 //---------------------------------------------------------------------------
 
+#include <thread>
 #include "mocks.h"
 
 TEST(InProcessBusTest, IsTarget)
@@ -158,11 +159,37 @@ TEST(InProcessBusTest, WaitSignal)
     EXPECT_FALSE(bus.WaitSignal(PIN_ACK, true));
 }
 
+TEST(InProcessBusTest, WaitSignalFromOtherThread)
+{
+    MockInProcessBus bus;
+
+    // The waiting thread must be woken up by the signal change
+    thread t([&bus] {
+        this_thread::sleep_for(10ms);
+        bus.SetSignal(PIN_REQ, true);
+    });
+    const auto start = chrono::steady_clock::now();
+    EXPECT_TRUE(bus.WaitSignal(PIN_REQ, true));
+    EXPECT_LT(chrono::steady_clock::now() - start, 1s);
+    t.join();
+}
+
 TEST(InProcessBusTest, WaitForSelection)
 {
     MockInProcessBus bus;
 
+    EXPECT_FALSE(bus.WaitForSelection()) << "There was no selection";
+
+    bus.SetSEL(true);
+    EXPECT_TRUE(bus.WaitForSelection());
+    bus.SetSEL(false);
+
+    thread t([&bus] {
+        this_thread::sleep_for(10ms);
+        bus.SetSEL(true);
+    });
     EXPECT_TRUE(bus.WaitForSelection());
+    t.join();
 }
 
 TEST(DelegatingProcessBusTest, Reset)
@@ -0,0 +1,91 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "devices/latency_histogram.h"
+
+using namespace testing;
+
+TEST(LatencyHistogramTest, GetBucket)
+{
+    EXPECT_EQ(0, LatencyHistogram::GetBucket(0));
+    EXPECT_EQ(3, LatencyHistogram::GetBucket(3));
+    EXPECT_EQ(4, LatencyHistogram::GetBucket(4));
+    EXPECT_EQ(7, LatencyHistogram::GetBucket(7));
+    EXPECT_EQ(8, LatencyHistogram::GetBucket(8));
+    EXPECT_EQ(8, LatencyHistogram::GetBucket(9));
+    EXPECT_EQ(9, LatencyHistogram::GetBucket(10));
+    EXPECT_EQ(11, LatencyHistogram::GetBucket(15));
+    EXPECT_EQ(12, LatencyHistogram::GetBucket(16));
+    EXPECT_EQ(LatencyHistogram::BUCKET_COUNT - 1, LatencyHistogram::GetBucket(UINT64_MAX));
+}
+
+TEST(LatencyHistogramTest, GetBucketLimit)
+{
+    EXPECT_EQ(0U, LatencyHistogram::GetBucketLimit(0));
+    EXPECT_EQ(3U, LatencyHistogram::GetBucketLimit(3));
+    EXPECT_EQ(7U, LatencyHistogram::GetBucketLimit(7));
+    EXPECT_EQ(9U, LatencyHistogram::GetBucketLimit(8));
+    EXPECT_EQ(15U, LatencyHistogram::GetBucketLimit(11));
+    EXPECT_EQ(UINT64_MAX, LatencyHistogram::GetBucketLimit(LatencyHistogram::BUCKET_COUNT - 1));
+
+    for (int bucket = 0; bucket < LatencyHistogram::BUCKET_COUNT; ++bucket) {
+        EXPECT_EQ(bucket, LatencyHistogram::GetBucket(LatencyHistogram::GetBucketLimit(bucket)));
+        if (bucket) {
+            EXPECT_EQ(bucket, LatencyHistogram::GetBucket(LatencyHistogram::GetBucketLimit(bucket - 1) + 1));
+        }
+    }
+}
+
+TEST(LatencyHistogramTest, Record)
+{
+    LatencyHistogram histogram;
+    EXPECT_EQ(0U, histogram.GetCount());
+    EXPECT_EQ(0U, histogram.GetMax());
+    EXPECT_EQ(0U, histogram.GetPercentile(50));
+
+    for (uint64_t latency = 1; latency <= 100; ++latency) {
+        histogram.Record(latency);
+    }
+    EXPECT_EQ(100U, histogram.GetCount());
+    EXPECT_EQ(100U, histogram.GetMax());
+    EXPECT_EQ(55U, histogram.GetPercentile(50));
+    EXPECT_EQ(100U, histogram.GetPercentile(99));
+    EXPECT_EQ(100U, histogram.GetPercentile(100));
+
+    histogram.Record(chrono::steady_clock::now());
+    EXPECT_EQ(101U, histogram.GetCount());
+}
+
+TEST(LatencyHistogramTest, AddStatistics)
+{
+    LatencyHistogram histogram;
+
+    vector<PbStatistics> statistics;
+    histogram.AddStatistics(statistics, "read");
+    EXPECT_TRUE(statistics.empty());
+
+    histogram.Record(5);
+    histogram.Record(5);
+    histogram.Record(1000);
+    histogram.AddStatistics(statistics, "read");
+    ASSERT_EQ(6U, statistics.size());
+    EXPECT_EQ("read_latency_count", statistics[0].key());
+    EXPECT_EQ(3U, statistics[0].value());
+    EXPECT_EQ("read_latency_p50_us", statistics[1].key());
+    EXPECT_EQ(5U, statistics[1].value());
+    EXPECT_EQ("read_latency_p99_us", statistics[2].key());
+    EXPECT_EQ(1000U, statistics[2].value());
+    EXPECT_EQ("read_latency_max_us", statistics[3].key());
+    EXPECT_EQ(1000U, statistics[3].value());
+    EXPECT_EQ("read_latency_le_5_us", statistics[4].key());
+    EXPECT_EQ(2U, statistics[4].value());
+    EXPECT_EQ("read_latency_le_1023_us", statistics[5].key());
+    EXPECT_EQ(1U, statistics[5].value());
+    EXPECT_EQ(PbStatisticsCategory::CATEGORY_INFO, statistics[5].category());
+}
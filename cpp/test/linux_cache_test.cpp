@@ -6,6 +6,7 @@
 //
 //---------------------------------------------------------------------------
 
+#include <thread>
 #include <gtest/gtest.h>
 #include "devices/linux_cache.h"
 #include "test_shared.h"
@@ -50,6 +51,37 @@ TEST(LinuxCache, ReadWriteSectors)
     EXPECT_EQ(123, buf[1]);
 }
 
+TEST(LinuxCache, ReadBeyondEndOfFile)
+{
+    vector<uint8_t> buf(512);
+    LinuxCache cache(CreateTempFile(buf.size()), static_cast<int>(buf.size()), 2, false);
+    EXPECT_TRUE(cache.Init());
+
+    EXPECT_EQ(0, cache.ReadSectors(buf, 1, 1));
+
+    const auto &statistics = cache.GetStatistics(true);
+    EXPECT_EQ("read_error_count", statistics[3].key());
+    EXPECT_EQ(1U, statistics[3].value());
+}
+
+TEST(LinuxCache, SequentialWrites)
+{
+    constexpr int SECTORS = 16384;
+    LinuxCache cache(CreateTempFile(SECTORS * 512), 512, SECTORS, false);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(128 * 512);
+    for (int sector = 0; sector < SECTORS; sector += 128) {
+        buf[0] = static_cast<uint8_t>(sector);
+        EXPECT_EQ(128 * 512, cache.WriteSectors(buf, sector, 128));
+    }
+
+    // The data written are still available after the kernel was advised not to cache them
+    EXPECT_EQ(128 * 512, cache.ReadSectors(buf, SECTORS - 256, 128));
+    EXPECT_EQ(static_cast<uint8_t>(SECTORS - 256), buf[0]);
+    EXPECT_TRUE(cache.Flush());
+}
+
 TEST(LinuxCache, ReadWriteLong)
 {
     vector<uint8_t> buf(512);
@@ -73,10 +105,28 @@ TEST(LinuxCache, Flush)
     EXPECT_TRUE(cache.Flush());
 }
 
+TEST(LinuxCache, Prefetch)
+{
+    constexpr int SECTORS = 64;
+    LinuxCache cache(CreateTempFile(SECTORS * 512), 512, SECTORS, false);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(4 * 512);
+    for (int sector = 0; sector < SECTORS; sector += 4) {
+        EXPECT_EQ(4 * 512, cache.ReadSectors(buf, sector, 4));
+
+        this_thread::sleep_for(20ms);
+    }
+
+    const auto &statistics = cache.GetStatistics(true);
+    EXPECT_EQ("prefetch_hit_count", statistics[0].key());
+    EXPECT_NE(0U, statistics[0].value());
+}
+
 TEST(LinuxCache, GetStatistics)
 {
     LinuxCache cache("", 0, 0, false);
 
-    EXPECT_EQ(1U, cache.GetStatistics(true).size());
-    EXPECT_EQ(2U, cache.GetStatistics(false).size());
+    EXPECT_EQ(4U, cache.GetStatistics(true).size());
+    EXPECT_EQ(6U, cache.GetStatistics(false).size());
 }
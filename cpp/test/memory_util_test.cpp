@@ -73,3 +73,12 @@ TEST(MemoryUtilTest, SetInt64)
     EXPECT_EQ(0x43, buf[6]);
     EXPECT_EQ(0x21, buf[7]);
 }
+
+TEST(MemoryUtilTest, AlignedBuffer)
+{
+    aligned_buffer buf(1);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(buf.data()) % IO_ALIGNMENT);
+
+    buf.resize(100000);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(buf.data()) % IO_ALIGNMENT);
+}
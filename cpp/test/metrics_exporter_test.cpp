@@ -0,0 +1,126 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "s2p/metrics_exporter.h"
+#include "test_shared.h"
+
+using namespace testing;
+
+static void AddStatistics(PbStatisticsInfo &statistics_info, int id, const string &key, uint64_t value)
+{
+    auto *s = statistics_info.add_statistics();
+    s->set_id(id);
+    s->set_unit(id == -1 ? -1 : 0);
+    s->set_key(key);
+    s->set_value(value);
+}
+
+static string Scrape(const string &socket_path)
+{
+    sockaddr_un address = { };
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, socket_path.size());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    EXPECT_NE(-1, fd);
+    EXPECT_EQ(0, connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address))) // NOSONAR bit_cast is not supported by the bullseye compiler
+    << "Exporter should be running";
+    const string request = "GET /metrics HTTP/1.0\r\n\r\n";
+    EXPECT_EQ(static_cast<ssize_t>(request.size()), write(fd, request.data(), request.size()));
+
+    string response;
+    array<char, 256> buf;
+    ssize_t n;
+    while ((n = read(fd, buf.data(), buf.size())) > 0) {
+        response.append(buf.data(), n);
+    }
+    close(fd);
+
+    return response;
+}
+
+TEST(MetricsExporterTest, Init)
+{
+    MetricsExporter exporter;
+
+    EXPECT_FALSE(exporter.Init("65536", nullptr, default_logger()).empty()) << "Illegal port number";
+    EXPECT_FALSE(exporter.Init("0", nullptr, default_logger()).empty()) << "Illegal port number";
+    EXPECT_FALSE(exporter.Init("", nullptr, default_logger()).empty()) << "Missing socket path";
+    EXPECT_FALSE(exporter.Init("/missing/s2p.sock", nullptr, default_logger()).empty()) << "Missing folder";
+    EXPECT_FALSE(exporter.Init(string(200, 'a'), nullptr, default_logger()).empty()) << "Socket path is too long";
+    EXPECT_TRUE(exporter.Init("9998", nullptr, default_logger()).empty())
+        << "Port 9998 is expected not to be in use for this test";
+    EXPECT_FALSE(exporter.IsRunning());
+    exporter.Stop();
+}
+
+TEST(MetricsExporterTest, Render)
+{
+    PbStatisticsInfo statistics_info;
+    EXPECT_EQ("# EOF\n", MetricsExporter::Render(statistics_info));
+
+    AddStatistics(statistics_info, 0, "read_error_count", 1);
+    AddStatistics(statistics_info, 1, "read_error_count", 2);
+    AddStatistics(statistics_info, 0, "cache_resident_bytes", 512);
+    AddStatistics(statistics_info, 0, "store_block_count", 3);
+    AddStatistics(statistics_info, -1, "file_print_count", 4);
+    AddStatistics(statistics_info, 0, "read_latency_count", 3);
+    AddStatistics(statistics_info, 0, "read_latency_p50_us", 5);
+    AddStatistics(statistics_info, 0, "read_latency_le_5_us", 2);
+    AddStatistics(statistics_info, 0, "read_latency_le_1023_us", 1);
+
+    EXPECT_EQ(R"(# TYPE s2p_cache_resident_bytes gauge
+s2p_cache_resident_bytes{id="0",lun="0"} 512
+# TYPE s2p_file_print_count counter
+s2p_file_print_count_total 4
+# TYPE s2p_read_error_count counter
+s2p_read_error_count_total{id="0",lun="0"} 1
+s2p_read_error_count_total{id="1",lun="0"} 2
+# TYPE s2p_read_latency_p50_us gauge
+s2p_read_latency_p50_us{id="0",lun="0"} 5
+# TYPE s2p_read_latency_us histogram
+s2p_read_latency_us_bucket{id="0",lun="0",le="5.0"} 2
+s2p_read_latency_us_bucket{id="0",lun="0",le="1023.0"} 3
+s2p_read_latency_us_bucket{id="0",lun="0",le="+Inf"} 3
+s2p_read_latency_us_count{id="0",lun="0"} 3
+# TYPE s2p_store_block_count gauge
+s2p_store_block_count{id="0",lun="0"} 3
+# EOF
+)", MetricsExporter::Render(statistics_info));
+}
+
+TEST(MetricsExporterTest, Execute)
+{
+    // The unique name of a temporary file is used for the socket
+    const path &socket_path = CreateTempFile();
+    remove(socket_path);
+
+    int collect_count = 0;
+    MetricsExporter exporter;
+    EXPECT_TRUE(exporter.Init(socket_path.string(), [&collect_count](PbStatisticsInfo &statistics_info) {
+        AddStatistics(statistics_info, 0, "read_error_count", ++collect_count);
+        return true;
+    }, default_logger()).empty());
+
+    exporter.Start();
+    EXPECT_TRUE(exporter.IsRunning());
+
+    const string &response = Scrape(socket_path.string());
+    EXPECT_TRUE(response.starts_with("HTTP/1.0 200 OK\r\n"));
+    EXPECT_NE(string::npos, response.find("Content-Type: application/openmetrics-text; version=1.0.0"));
+    EXPECT_NE(string::npos, response.find("s2p_read_error_count_total{id=\"0\",lun=\"0\"} "));
+    EXPECT_TRUE(response.ends_with("# EOF\n"));
+
+    exporter.Stop();
+    EXPECT_FALSE(exporter.IsRunning());
+    EXPECT_FALSE(exists(socket_path)) << "Socket file must be removed";
+}
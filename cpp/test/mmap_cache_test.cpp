@@ -0,0 +1,111 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "devices/mmap_cache.h"
+#include "test_shared.h"
+
+using namespace testing;
+
+TEST(MmapCache, Init)
+{
+    MmapCache cache1("", 0, 0);
+    EXPECT_FALSE(cache1.Init());
+
+    MmapCache cache2("", 512, 0);
+    EXPECT_FALSE(cache2.Init());
+
+    MmapCache cache3("", 512, 1);
+    EXPECT_FALSE(cache3.Init());
+
+    MmapCache cache4("test", 512, 1);
+    EXPECT_FALSE(cache4.Init());
+
+    MmapCache cache5(CreateTempFile(512), 512, 1);
+    EXPECT_TRUE(cache5.Init());
+}
+
+TEST(MmapCache, ReadWriteSectors)
+{
+    constexpr int SECTORS = 16;
+    const string &filename = CreateTempFile(SECTORS * 512);
+    MmapCache cache(filename, 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(2 * 512);
+    EXPECT_EQ(0, cache.ReadSectors(buf, SECTORS - 1, 2));
+    EXPECT_EQ(0, cache.WriteSectors(buf, SECTORS - 1, 2));
+
+    buf[1] = 123;
+    buf[513] = 124;
+    EXPECT_EQ(2 * 512, cache.WriteSectors(buf, 5, 2));
+    ranges::fill(buf, 0);
+
+    EXPECT_EQ(2 * 512, cache.ReadSectors(buf, 5, 2));
+    EXPECT_EQ(123, buf[1]);
+    EXPECT_EQ(124, buf[513]);
+
+    EXPECT_TRUE(cache.Flush());
+    const string &data = ReadTempFileToString(filename);
+    EXPECT_EQ(123, data[5 * 512 + 1]);
+    EXPECT_EQ(124, data[6 * 512 + 1]);
+}
+
+TEST(MmapCache, BorrowSectors)
+{
+    constexpr int SECTORS = 16;
+    auto cache = make_unique<MmapCache>(CreateTempFile(SECTORS * 512), 512, SECTORS);
+    EXPECT_FALSE(cache->BorrowSectors(0, 1).second);
+    EXPECT_TRUE(cache->Init());
+
+    EXPECT_FALSE(cache->BorrowSectors(SECTORS - 1, 2).second);
+    EXPECT_FALSE(cache->BorrowSectors(0, 0).second);
+
+    vector<uint8_t> buf(512);
+    buf[1] = 123;
+    EXPECT_EQ(512, cache->WriteSectors(buf, 5, 1));
+
+    const auto& [data, pin] = cache->BorrowSectors(4, 2);
+    EXPECT_TRUE(pin);
+    EXPECT_EQ(2U * 512, data.size());
+    EXPECT_EQ(123, data[513]);
+
+    // The mapping remains valid as long as the data are borrowed
+    cache.reset();
+    EXPECT_EQ(123, data[513]);
+}
+
+TEST(MmapCache, ReadOnly)
+{
+    const path &filename = CreateTempFile(512);
+    permissions(filename, perms::owner_read);
+
+    MmapCache cache(filename, 512, 1);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(512);
+    EXPECT_EQ(512, cache.ReadSectors(buf, 0, 1));
+    if (getuid()) {
+        EXPECT_EQ(0, cache.WriteSectors(buf, 0, 1));
+    }
+}
+
+TEST(MmapCache, Flush)
+{
+    MmapCache cache(CreateTempFile(512), 512, 1);
+    EXPECT_TRUE(cache.Flush());
+}
+
+TEST(MmapCache, GetStatistics)
+{
+    MmapCache cache("", 0, 0);
+
+    EXPECT_EQ(3U, cache.GetStatistics(true).size());
+    EXPECT_EQ(7U, cache.GetStatistics(false).size());
+}
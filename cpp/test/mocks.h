@@ -120,6 +120,7 @@ class MockAbstractController : public AbstractController // NOSONAR Having many
     FRIEND_TEST(DiskTest, Read16);
     FRIEND_TEST(DiskTest, Write6);
     FRIEND_TEST(DiskTest, Write10);
+    FRIEND_TEST(DiskTest, WriteBehind);
     FRIEND_TEST(DiskTest, Write16);
     FRIEND_TEST(DiskTest, Verify10);
     FRIEND_TEST(DiskTest, Verify16);
@@ -356,6 +357,11 @@ class MockDisk : public Disk
 {
     FRIEND_TEST(DiskTest, Dispatch);
     FRIEND_TEST(DiskTest, ValidateFile);
+    FRIEND_TEST(DiskTest, CacheParams);
+    FRIEND_TEST(DiskTest, CachingMode);
+    FRIEND_TEST(DiskTest, AutoCachingMode);
+    FRIEND_TEST(DiskTest, Overlay);
+    FRIEND_TEST(DiskTest, Dedup);
     FRIEND_TEST(DiskTest, Rezero);
     FRIEND_TEST(DiskTest, FormatUnit);
     FRIEND_TEST(DiskTest, ReassignBlocks);
@@ -366,6 +372,7 @@ class MockDisk : public Disk
     FRIEND_TEST(DiskTest, Read16);
     FRIEND_TEST(DiskTest, Write6);
     FRIEND_TEST(DiskTest, Write10);
+    FRIEND_TEST(DiskTest, WriteBehind);
     FRIEND_TEST(DiskTest, Write16);
     FRIEND_TEST(DiskTest, Verify10);
     FRIEND_TEST(DiskTest, Verify16);
@@ -376,6 +383,9 @@ class MockDisk : public Disk
     FRIEND_TEST(DiskTest, ReadLong16);
     FRIEND_TEST(DiskTest, WriteLong10);
     FRIEND_TEST(DiskTest, WriteLong16);
+    FRIEND_TEST(DiskTest, WriteSame10);
+    FRIEND_TEST(DiskTest, WriteSame16);
+    FRIEND_TEST(DiskTest, Unmap);
     FRIEND_TEST(DiskTest, ReserveRelease);
     FRIEND_TEST(DiskTest, SendDiagnostic);
     FRIEND_TEST(DiskTest, Eject);
@@ -0,0 +1,124 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "devices/overlay_cache.h"
+#include "test_shared.h"
+
+using namespace testing;
+
+TEST(OverlayCache, Init)
+{
+    const string &base = CreateTempFile(4 * 512);
+
+    OverlayCache cache1(CreateTempFile(), base, 0, 4);
+    EXPECT_FALSE(cache1.Init());
+
+    OverlayCache cache2(CreateTempFile(), base, 512, 0);
+    EXPECT_FALSE(cache2.Init());
+
+    OverlayCache cache3(CreateTempFile(), "", 512, 4);
+    EXPECT_FALSE(cache3.Init());
+
+    OverlayCache cache4(CreateTempFile(), "missing", 512, 4);
+    EXPECT_FALSE(cache4.Init());
+
+    OverlayCache cache5(CreateTempFile(), base, 512, 5);
+    EXPECT_FALSE(cache5.Init()) << "Base image is too small";
+
+    OverlayCache cache6(CreateTempFile(512), base, 512, 4);
+    EXPECT_FALSE(cache6.Init()) << "Not a delta file";
+
+    const string &delta = CreateTempFile();
+    OverlayCache cache7(delta, base, 512, 4);
+    EXPECT_TRUE(cache7.Init());
+    EXPECT_EQ(0U, cache7.GetAllocatedBlocks());
+
+    OverlayCache cache8(delta, base, 512, 3);
+    EXPECT_FALSE(cache8.Init()) << "Delta file belongs to an image with a different geometry";
+}
+
+TEST(OverlayCache, ReadWriteSectors)
+{
+    constexpr int SECTORS = 3 * OverlayCache::BLOCK_SECTORS;
+    vector<byte> base_data(SECTORS * 512);
+    for (int sector = 0; sector < SECTORS; ++sector) {
+        base_data[sector * 512] = static_cast<byte>(sector);
+    }
+    const string &base = CreateTempFileWithData(base_data);
+    const string &delta = CreateTempFile();
+
+    OverlayCache cache(delta, base, 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(SECTORS * 512);
+    EXPECT_EQ(0, cache.ReadSectors(buf, SECTORS - 1, 2));
+    EXPECT_EQ(0, cache.WriteSectors(buf, SECTORS - 1, 2));
+
+    // Sectors not written are read from the base image
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(5, buf[5 * 512]);
+
+    // Only the block written to is copied to the delta file
+    buf[0] = 0xff;
+    buf[512] = 0xfe;
+    EXPECT_EQ(2 * 512, cache.WriteSectors(buf, OverlayCache::BLOCK_SECTORS + 1, 2));
+    EXPECT_EQ(1U, cache.GetAllocatedBlocks());
+    EXPECT_EQ(512, cache.WriteSectors(buf, OverlayCache::BLOCK_SECTORS + 4, 1));
+    EXPECT_EQ(1U, cache.GetAllocatedBlocks());
+    EXPECT_TRUE(cache.Flush());
+
+    ranges::fill(buf, 0);
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(OverlayCache::BLOCK_SECTORS, buf[OverlayCache::BLOCK_SECTORS * 512]);
+    EXPECT_EQ(0xff, buf[(OverlayCache::BLOCK_SECTORS + 1) * 512]);
+    EXPECT_EQ(0xfe, buf[(OverlayCache::BLOCK_SECTORS + 2) * 512]);
+    EXPECT_EQ(static_cast<uint8_t>(OverlayCache::BLOCK_SECTORS + 3), buf[(OverlayCache::BLOCK_SECTORS + 3) * 512]);
+    EXPECT_EQ(0xff, buf[(OverlayCache::BLOCK_SECTORS + 4) * 512]);
+    EXPECT_EQ(static_cast<uint8_t>(2 * OverlayCache::BLOCK_SECTORS), buf[2 * OverlayCache::BLOCK_SECTORS * 512]);
+
+    // The base image is never modified
+    EXPECT_EQ(static_cast<char>(OverlayCache::BLOCK_SECTORS + 1),
+        ReadTempFileToString(base)[(OverlayCache::BLOCK_SECTORS + 1) * 512]);
+
+    // The delta file can be used again
+    OverlayCache reopened(delta, base, 512, SECTORS);
+    EXPECT_TRUE(reopened.Init());
+    EXPECT_EQ(1U, reopened.GetAllocatedBlocks());
+    EXPECT_EQ(512, reopened.ReadSectors(buf, OverlayCache::BLOCK_SECTORS + 2, 1));
+    EXPECT_EQ(0xfe, buf[0]);
+    EXPECT_EQ(512, reopened.ReadSectors(buf, 2, 1));
+    EXPECT_EQ(2, buf[0]);
+}
+
+TEST(OverlayCache, SharedBase)
+{
+    constexpr int SECTORS = OverlayCache::BLOCK_SECTORS;
+    const string &base = CreateTempFile(SECTORS * 512);
+
+    OverlayCache cache1(CreateTempFile(), base, 512, SECTORS);
+    EXPECT_TRUE(cache1.Init());
+    OverlayCache cache2(CreateTempFile(), base, 512, SECTORS);
+    EXPECT_TRUE(cache2.Init());
+
+    vector<uint8_t> buf(512);
+    buf[0] = 1;
+    EXPECT_EQ(512, cache1.WriteSectors(buf, 0, 1));
+
+    EXPECT_EQ(512, cache2.ReadSectors(buf, 0, 1));
+    EXPECT_EQ(0, buf[0]) << "Data written to one overlay must not be visible in other overlays";
+}
+
+TEST(OverlayCache, GetStatistics)
+{
+    OverlayCache cache(CreateTempFile(), CreateTempFile(512), 512, 1);
+    EXPECT_TRUE(cache.Init());
+
+    EXPECT_EQ(2U, cache.GetStatistics(true).size());
+    EXPECT_EQ(3U, cache.GetStatistics(false).size());
+}
@@ -0,0 +1,77 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include "devices/prefetcher.h"
+
+using namespace testing;
+
+static void WaitForPrefetch(Prefetcher &prefetcher, uint64_t start, uint32_t count)
+{
+    for (int i = 0; i < 1000 && !prefetcher.IsPrefetched(start, count); ++i) {
+        this_thread::sleep_for(1ms);
+    }
+}
+
+TEST(Prefetcher, Update)
+{
+    atomic<uint64_t> loaded_start = 0;
+    atomic<uint64_t> loaded_count = 0;
+    Prefetcher prefetcher([&loaded_start, &loaded_count](uint64_t start, uint64_t count) {
+        loaded_start = start;
+        loaded_count += count;
+    }, 16);
+
+    // A single command is not a sequential stream
+    prefetcher.Update(0, 2);
+    EXPECT_EQ(0U, prefetcher.GetWindow());
+    EXPECT_FALSE(prefetcher.IsPrefetched(2, 2));
+
+    prefetcher.Update(2, 2);
+    EXPECT_EQ(2U, prefetcher.GetWindow());
+    WaitForPrefetch(prefetcher, 4, 2);
+    EXPECT_TRUE(prefetcher.IsPrefetched(4, 2));
+    EXPECT_EQ(4U, loaded_start);
+    EXPECT_EQ(2U, loaded_count);
+
+    // The window grows with the length of the sequential run, up to the maximum
+    prefetcher.Update(4, 2);
+    EXPECT_EQ(4U, prefetcher.GetWindow());
+    prefetcher.Update(6, 2);
+    EXPECT_EQ(8U, prefetcher.GetWindow());
+    prefetcher.Update(8, 2);
+    EXPECT_EQ(16U, prefetcher.GetWindow());
+    prefetcher.Update(10, 2);
+    EXPECT_EQ(16U, prefetcher.GetWindow());
+    WaitForPrefetch(prefetcher, 12, 16);
+    EXPECT_TRUE(prefetcher.IsPrefetched(4, 24));
+    EXPECT_EQ(24U, loaded_count) << "Sectors must only be prefetched once";
+
+    // A non-sequential command ends the stream
+    prefetcher.Update(100, 2);
+    EXPECT_EQ(0U, prefetcher.GetWindow());
+    EXPECT_FALSE(prefetcher.IsPrefetched(102, 2));
+}
+
+TEST(Prefetcher, SetMaxWindow)
+{
+    atomic<uint64_t> loaded_count = 0;
+    Prefetcher prefetcher([&loaded_count](uint64_t, uint64_t count) {loaded_count += count;}, 0);
+
+    prefetcher.Update(0, 1);
+    prefetcher.Update(1, 1);
+    EXPECT_EQ(0U, prefetcher.GetWindow());
+
+    prefetcher.SetMaxWindow(1);
+    prefetcher.Update(2, 1);
+    prefetcher.Update(3, 1);
+    EXPECT_EQ(1U, prefetcher.GetWindow());
+    WaitForPrefetch(prefetcher, 4, 1);
+    EXPECT_EQ(1U, loaded_count);
+}
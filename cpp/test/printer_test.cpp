@@ -97,8 +97,10 @@ TEST(PrinterTest, Print)
     EXPECT_CALL(*controller, DataOut);
     EXPECT_NO_THROW(Dispatch(PRINTER, ScsiCommand::PRINT));
 
-    controller->SetCdbByte(3, 0xff);
-    controller->SetCdbByte(4, 0xff);
+    // One byte more than the maximum transfer size
+    controller->SetCdbByte(2, 0x01);
+    controller->SetCdbByte(3, 0x00);
+    controller->SetCdbByte(4, 0x01);
     Dispatch(PRINTER, ScsiCommand::PRINT, SenseKey::ILLEGAL_REQUEST, Asc::INVALID_FIELD_IN_CDB,
         "Buffer overflow was not reported");
 }
@@ -53,6 +53,11 @@ TEST(ProtobufUtil, ParseCachingMode)
     EXPECT_EQ(WRITE_THROUGH, ParseCachingMode("write-through"));
     EXPECT_EQ(LINUX_OPTIMIZED, ParseCachingMode("linux_optimized"));
     EXPECT_EQ(LINUX_OPTIMIZED, ParseCachingMode("linux-optimized"));
+    EXPECT_EQ(IO_URING, ParseCachingMode("io_uring"));
+    EXPECT_EQ(IO_URING, ParseCachingMode("io-uring"));
+    EXPECT_EQ(MMAP, ParseCachingMode("mmap"));
+    EXPECT_EQ(DIRECT_IO, ParseCachingMode("direct-io"));
+    EXPECT_EQ(AUTO, ParseCachingMode("auto"));
 
     EXPECT_THROW(ParseCachingMode(""), ParserException);
     EXPECT_THROW(ParseCachingMode("xyz"), ParserException);
@@ -82,6 +82,21 @@ TEST(S2pParserTest, ParseArguments_SCSI2Pi)
     EXPECT_EQ(1UL, properties.size());
     EXPECT_EQ("log_limit", properties[PropertyHandler::LOG_LIMIT]);
 
+    SetUpArgs(args, "--cache-memory", "cache_memory");
+    properties = parser.ParseArguments(args, ignore_conf);
+    EXPECT_EQ(1UL, properties.size());
+    EXPECT_EQ("cache_memory", properties[PropertyHandler::CACHE_MEMORY]);
+
+    SetUpArgs(args, "--max-transfer-size", "max_transfer_size");
+    properties = parser.ParseArguments(args, ignore_conf);
+    EXPECT_EQ(1UL, properties.size());
+    EXPECT_EQ("max_transfer_size", properties[PropertyHandler::MAX_TRANSFER_SIZE]);
+
+    SetUpArgs(args, "--metrics", "metrics");
+    properties = parser.ParseArguments(args, ignore_conf);
+    EXPECT_EQ(1UL, properties.size());
+    EXPECT_EQ("metrics", properties[PropertyHandler::METRICS]);
+
     SetUpArgs(args, "-P", "token_file");
     properties = parser.ParseArguments(args, ignore_conf);
     EXPECT_EQ(1UL, properties.size());
@@ -257,6 +257,20 @@ TEST(S2pCtlDisplayTest, DisplayStatisticsInfo)
     EXPECT_NE(string::npos, s.find("info"));
     EXPECT_NE(string::npos, s.find("warning"));
     EXPECT_NE(string::npos, s.find("error"));
+
+    // Histogram buckets are sorted by their limit
+    auto *st4 = info.add_statistics();
+    st4->set_category(PbStatisticsCategory::CATEGORY_INFO);
+    st4->set_key("read_latency_le_15_us");
+    auto *st5 = info.add_statistics();
+    st5->set_category(PbStatisticsCategory::CATEGORY_INFO);
+    st5->set_key("read_latency_le_7_us");
+    auto *st6 = info.add_statistics();
+    st6->set_category(PbStatisticsCategory::CATEGORY_INFO);
+    st6->set_key("read_latency_le_127_us");
+    s = display.DisplayStatisticsInfo(info);
+    EXPECT_LT(s.find("read_latency_le_7_us"), s.find("read_latency_le_15_us"));
+    EXPECT_LT(s.find("read_latency_le_15_us"), s.find("read_latency_le_127_us"));
 }
 
 TEST(S2pCtlDisplayTest, DisplayImageFile)
@@ -27,7 +27,7 @@ TEST(ScsiCdTest, DeviceDefaults)
 
     EXPECT_EQ(SCCD, cd.GetType());
     EXPECT_TRUE(cd.SupportsImageFile());
-    EXPECT_FALSE(cd.SupportsParams());
+    EXPECT_TRUE(cd.SupportsParams());
     EXPECT_FALSE(cd.IsProtectable());
     EXPECT_FALSE(cd.IsProtected());
     EXPECT_TRUE(cd.IsReadOnly());
@@ -93,6 +93,16 @@ TEST(ScsiCdTest, Open)
     EXPECT_EQ(2U, cd.GetBlockCount());
 }
 
+TEST(ScsiCdTest, OpenCompressed)
+{
+    MockScsiCd cd(0);
+
+    cd.SetFilename(CreateCompressedTempFile(vector<byte>(3 * 2048), 4096, "iso.dz"));
+    cd.Open();
+    EXPECT_EQ(3U, cd.GetBlockCount());
+    EXPECT_TRUE(cd.IsReadOnly());
+}
+
 TEST(ScsiCdTest, ReadToc)
 {
     MockAbstractController controller;
@@ -56,7 +56,7 @@ TEST(ScsiHdTest, SCHD_DeviceDefaults)
     EXPECT_NE(nullptr, hd);
     EXPECT_EQ(SCHD, hd->GetType());
     EXPECT_TRUE(hd->SupportsImageFile());
-    EXPECT_FALSE(hd->SupportsParams());
+    EXPECT_TRUE(hd->SupportsParams());
     EXPECT_TRUE(hd->IsProtectable());
     EXPECT_FALSE(hd->IsProtected());
     EXPECT_FALSE(hd->IsReadOnly());
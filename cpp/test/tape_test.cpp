@@ -10,7 +10,7 @@
 
 using namespace memory_util;
 
-static void CheckPosition(const AbstractController &controller, shared_ptr<PrimaryDevice> tape, uint32_t position)
+static void CheckPosition(AbstractController &controller, shared_ptr<PrimaryDevice> tape, uint32_t position)
 {
     fill_n(controller.GetBuffer().begin(), 12, 0xff);
     Dispatch(tape, ScsiCommand::READ_POSITION);
@@ -9,6 +9,7 @@
 #include <fstream>
 #include <iostream>
 #include <unistd.h>
+#include <zlib.h>
 #include "mocks.h"
 #include "base/device_factory.h"
 #include "shared/command_meta_data.h"
@@ -100,7 +101,7 @@ void testing::TestShared::TestRemovableDrive(PbDeviceType type, const string &fi
     EXPECT_NE(nullptr, device);
     EXPECT_EQ(type, device->GetType());
     EXPECT_TRUE(device->SupportsImageFile());
-    EXPECT_FALSE(device->SupportsParams());
+    EXPECT_TRUE(device->SupportsParams());
     EXPECT_TRUE(device->IsProtectable());
     EXPECT_FALSE(device->IsProtected());
     EXPECT_FALSE(device->IsReadOnly());
@@ -183,6 +184,56 @@ string testing::CreateTempFileWithData(span<const byte> data, const string &exte
     return filename.string();
 }
 
+// Creates a dictzip file, i.e. a gzip file with the data compressed in independent chunks and a chunk index
+string testing::CreateCompressedTempFile(span<const byte> data, uint16_t chunk_length, const string &extension)
+{
+    z_stream stream = { };
+    EXPECT_EQ(Z_OK, deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY));
+
+    vector<uint8_t> compressed(compressBound(static_cast<uLong>(data.size())) + data.size() / chunk_length * 16 + 64);
+    vector<uint16_t> chunk_sizes;
+    stream.next_out = compressed.data();
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    for (size_t offset = 0; offset < data.size(); offset += chunk_length) {
+        const size_t length = min(data.size() - offset, static_cast<size_t>(chunk_length));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<byte*>(data.data() + offset)); // NOSONAR zlib API
+        stream.avail_in = static_cast<uInt>(length);
+        const uLong total = stream.total_out;
+        deflate(&stream, offset + length < data.size() ? Z_FULL_FLUSH : Z_FINISH);
+        chunk_sizes.push_back(static_cast<uint16_t>(stream.total_out - total));
+    }
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    vector<uint8_t> file = { 0x1f, 0x8b, Z_DEFLATED, 0x04 | 0x08, 0, 0, 0, 0, 0, 3 };
+    const auto add_int16 = [&file](int value) {
+        file.push_back(static_cast<uint8_t>(value));
+        file.push_back(static_cast<uint8_t>(value >> 8));
+    };
+    const auto add_int32 = [&add_int16](uint32_t value) {
+        add_int16(value & 0xffff);
+        add_int16(value >> 16);
+    };
+    add_int16(static_cast<int>(10 + chunk_sizes.size() * 2));
+    file.push_back('R');
+    file.push_back('A');
+    add_int16(static_cast<int>(6 + chunk_sizes.size() * 2));
+    add_int16(1);
+    add_int16(chunk_length);
+    add_int16(static_cast<int>(chunk_sizes.size()));
+    for (const uint16_t size : chunk_sizes) {
+        add_int16(size);
+    }
+    const string name = "image";
+    file.insert(file.end(), name.begin(), name.end());
+    file.push_back(0);
+    file.insert(file.end(), compressed.begin(), compressed.end());
+    add_int32(static_cast<uint32_t>(crc32(0, reinterpret_cast<const Bytef*>(data.data()), static_cast<uInt>(data.size()))));
+    add_int32(static_cast<uint32_t>(data.size()));
+
+    return CreateTempFileWithData(as_bytes(span(file)), extension);
+}
+
 string testing::ReadTempFileToString(const string &filename)
 {
     ifstream in(path(filename), ios::binary);
@@ -35,6 +35,7 @@ string CreateTempName();
 pair<int, path> OpenTempFile(const string& = "");
 path CreateTempFile(size_t = 0, const string& = "");
 string CreateTempFileWithData(span<const byte>, const string& = "");
+string CreateCompressedTempFile(span<const byte>, uint16_t, const string& = "dz");
 string ReadTempFileToString(const string&);
 
 void SetUpProperties(string_view, string_view = "", const property_map& = { });
@@ -59,7 +60,7 @@ public:
     static void CleanUp()
     {
         for (const string &filename : temp_files) {
-            remove(path(filename));
+            remove_all(path(filename));
         }
     }
 
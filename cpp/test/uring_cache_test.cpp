@@ -0,0 +1,127 @@
+//---------------------------------------------------------------------------
+//
+// SCSI2Pi, SCSI device emulator and SCSI tools for the Raspberry Pi
+//
+// Copyright (C) 2025 Uwe Seimet
+//
+//---------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "devices/uring_cache.h"
+#include "test_shared.h"
+
+using namespace testing;
+
+TEST(UringCache, Init)
+{
+    UringCache cache1("", 0, 0);
+    EXPECT_FALSE(cache1.Init());
+
+    UringCache cache2("", 512, 0);
+    EXPECT_FALSE(cache2.Init());
+
+    UringCache cache3("", 512, 1);
+    EXPECT_FALSE(cache3.Init());
+
+    UringCache cache4("test", 512, 1);
+    EXPECT_FALSE(cache4.Init());
+
+    UringCache cache5(CreateTempFile(512), 512, 1);
+    EXPECT_EQ(UringCache::IsAvailable(), cache5.Init());
+}
+
+TEST(UringCache, ReadWriteSectors)
+{
+    if (!UringCache::IsAvailable()) {
+        return;
+    }
+
+    // More data than a single read request covers
+    constexpr int SECTORS = 512;
+    const string &filename = CreateTempFile(SECTORS * 512);
+    UringCache cache(filename, 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> buf(SECTORS * 512);
+    EXPECT_EQ(0, cache.ReadSectors(buf, 1, SECTORS));
+    EXPECT_EQ(0, cache.WriteSectors(buf, 1, SECTORS));
+
+    for (size_t i = 0; i < buf.size(); i += 512) {
+        buf[i] = static_cast<uint8_t>(i / 512);
+    }
+    EXPECT_EQ(SECTORS * 512, cache.WriteSectors(buf, 0, SECTORS));
+
+    // Overwriting sectors with a pending write must not reorder the writes
+    vector<uint8_t> sector(512);
+    sector[0] = 0xff;
+    EXPECT_EQ(512, cache.WriteSectors(sector, 1, 1));
+
+    ranges::fill(buf, 0);
+    EXPECT_EQ(SECTORS * 512, cache.ReadSectors(buf, 0, SECTORS));
+    EXPECT_EQ(0, buf[0]);
+    EXPECT_EQ(0xff, buf[512]);
+    EXPECT_EQ(2, buf[2 * 512]);
+    EXPECT_EQ(255, buf[255 * 512]);
+    EXPECT_EQ(0, buf[256 * 512]);
+
+    EXPECT_TRUE(cache.Flush());
+    EXPECT_EQ(0xff, static_cast<uint8_t>(ReadTempFileToString(filename)[512]));
+}
+
+TEST(UringCache, Flush)
+{
+    UringCache cache1(CreateTempFile(512), 512, 1);
+    EXPECT_TRUE(cache1.Flush());
+
+    if (!UringCache::IsAvailable()) {
+        return;
+    }
+
+    UringCache cache2(CreateTempFile(512), 512, 1);
+    EXPECT_TRUE(cache2.Init());
+    EXPECT_TRUE(cache2.Flush());
+}
+
+TEST(UringCache, Prefetch)
+{
+    if (!UringCache::IsAvailable()) {
+        return;
+    }
+
+    constexpr int SECTORS = 1024;
+    const string &filename = CreateTempFile(SECTORS * 512);
+    UringCache cache(filename, 512, SECTORS);
+    EXPECT_TRUE(cache.Init());
+
+    vector<uint8_t> data(SECTORS * 512);
+    for (size_t i = 0; i < data.size(); i += 512) {
+        data[i] = static_cast<uint8_t>(i / 512);
+    }
+    EXPECT_EQ(SECTORS * 512, cache.WriteSectors(data, 0, SECTORS));
+
+    vector<uint8_t> buf(8 * 512);
+    for (int sector = 0; sector < SECTORS; sector += 8) {
+        EXPECT_EQ(8 * 512, cache.ReadSectors(buf, sector, 8));
+        EXPECT_EQ(data[sector * 512], buf[0]);
+        EXPECT_EQ(data[(sector + 7) * 512], buf[7 * 512]);
+
+        // Writing invalidates the prefetched data
+        if (sector == 512) {
+            buf[0] = 0xaa;
+            EXPECT_EQ(512, cache.WriteSectors(buf, sector + 16, 1));
+            data[(sector + 16) * 512] = 0xaa;
+        }
+    }
+
+    const auto &statistics = cache.GetStatistics(true);
+    EXPECT_EQ("prefetch_hit_count", statistics[0].key());
+    EXPECT_NE(0U, statistics[0].value());
+}
+
+TEST(UringCache, GetStatistics)
+{
+    UringCache cache("", 0, 0);
+
+    EXPECT_EQ(4U, cache.GetStatistics(true).size());
+    EXPECT_EQ(6U, cache.GetStatistics(false).size());
+}